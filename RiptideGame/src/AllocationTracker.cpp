@@ -0,0 +1,114 @@
+#include "AllocationTracker.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+std::atomic<bool>     g_FrameOpen{false};
+std::atomic<uint64_t> g_NumAllocations{0};
+std::atomic<uint64_t> g_NumBytes{0};
+thread_local bool     t_Ignored = false;
+
+} // namespace
+
+bool AllocationTracker::IsAvailable()
+{
+#if RIPTIDE_TRACK_ALLOCATIONS
+    return true;
+#else
+    return false;
+#endif
+}
+
+void AllocationTracker::BeginFrame()
+{
+    g_NumAllocations.store(0, std::memory_order_relaxed);
+    g_NumBytes.store(0, std::memory_order_relaxed);
+    g_FrameOpen.store(true, std::memory_order_release);
+}
+
+AllocationTracker::Counts AllocationTracker::EndFrame()
+{
+    g_FrameOpen.store(false, std::memory_order_release);
+
+    Counts counts;
+    counts.NumAllocations = g_NumAllocations.load(std::memory_order_relaxed);
+    counts.NumBytes       = g_NumBytes.load(std::memory_order_relaxed);
+    return counts;
+}
+
+void AllocationTracker::IgnoreCurrentThread()
+{
+    t_Ignored = true;
+}
+
+#if RIPTIDE_TRACK_ALLOCATIONS
+
+// replaces the global operator new for the whole program, the deletes must match it
+static void* TrackedAllocate(std::size_t Size)
+{
+    if (g_FrameOpen.load(std::memory_order_relaxed) && !t_Ignored)
+    {
+        g_NumAllocations.fetch_add(1, std::memory_order_relaxed);
+        g_NumBytes.fetch_add(Size, std::memory_order_relaxed);
+    }
+    return std::malloc(Size > 0 ? Size : 1);
+}
+
+void* operator new(std::size_t Size)
+{
+    if (void* pMemory = TrackedAllocate(Size))
+        return pMemory;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t Size)
+{
+    if (void* pMemory = TrackedAllocate(Size))
+        return pMemory;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t Size, const std::nothrow_t&) noexcept
+{
+    return TrackedAllocate(Size);
+}
+
+void* operator new[](std::size_t Size, const std::nothrow_t&) noexcept
+{
+    return TrackedAllocate(Size);
+}
+
+void operator delete(void* pMemory) noexcept
+{
+    std::free(pMemory);
+}
+
+void operator delete[](void* pMemory) noexcept
+{
+    std::free(pMemory);
+}
+
+void operator delete(void* pMemory, std::size_t) noexcept
+{
+    std::free(pMemory);
+}
+
+void operator delete[](void* pMemory, std::size_t) noexcept
+{
+    std::free(pMemory);
+}
+
+void operator delete(void* pMemory, const std::nothrow_t&) noexcept
+{
+    std::free(pMemory);
+}
+
+void operator delete[](void* pMemory, const std::nothrow_t&) noexcept
+{
+    std::free(pMemory);
+}
+
+#endif
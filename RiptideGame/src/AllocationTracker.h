@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+
+// Debug hook that counts global heap allocations while a frame is open, so a frame loop can check
+// that steady-state frames stay off the heap. Counting needs the replacement global operator new
+// that is only compiled in with RIPTIDE_TRACK_ALLOCATIONS; without it nothing is counted. Over-aligned
+// allocations are not counted. Threads that allocate independently of the frames, like decoders
+// and the simulation, exclude themselves.
+namespace AllocationTracker
+{
+
+struct Counts
+{
+    uint64_t NumAllocations = 0;
+    uint64_t NumBytes       = 0;
+};
+
+// whether the counting operator new is compiled in
+bool IsAvailable();
+
+// counts the allocations of all threads that are not ignored until EndFrame()
+void   BeginFrame();
+Counts EndFrame();
+
+// for threads whose allocations are not part of any frame
+void IgnoreCurrentThread();
+
+} // namespace AllocationTracker
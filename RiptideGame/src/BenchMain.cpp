@@ -0,0 +1,813 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "RenderDevice.h"
+#include "DeviceContext.h"
+#if D3D11_SUPPORTED
+#    include "EngineFactoryD3D11.h"
+#endif
+#if D3D12_SUPPORTED
+#    include "EngineFactoryD3D12.h"
+#endif
+#if VULKAN_SUPPORTED
+#    include "EngineFactoryVk.h"
+#endif
+#include "OpenVRInterface.h"
+#include "SimulatedVRRuntime.h"
+#include "SimulationThread.h"
+#include "AllocationTracker.h"
+
+using namespace Diligent;
+
+// Headless frame loop benchmark: runs OpenVRInterface::RenderFrame() against SimulatedVRRuntime
+// for a fixed number of frames and prints frame-time statistics.
+
+struct BenchSettings
+{
+#if VULKAN_SUPPORTED
+    RENDER_DEVICE_TYPE DeviceType = RENDER_DEVICE_TYPE_VULKAN;
+#elif D3D11_SUPPORTED
+    RENDER_DEVICE_TYPE DeviceType = RENDER_DEVICE_TYPE_D3D11;
+#else
+    RENDER_DEVICE_TYPE DeviceType = RENDER_DEVICE_TYPE_UNDEFINED;
+#endif
+    bool     SoftwareAdapter = false;
+    uint32_t NumFrames       = 1000;
+    uint32_t NumWarmupFrames = 60;
+    uint32_t NumProps        = 0;
+    uint32_t NumThreads      = 0;
+    double   SimulationRate  = 0;
+    bool     Profile         = false;
+
+    // fail unless every measured frame stayed off the heap, needs RIPTIDE_TRACK_ALLOCATIONS
+    bool ExpectNoAllocations = false;
+
+    const char* TracePath = nullptr;
+
+    // props are drawn with this mesh instead of the cube, it is written first with SphereMeshSegments
+    const char* MeshPath           = nullptr;
+    uint32_t    SphereMeshSegments = 0;
+
+    // spheres of a few sizes are written to ChurnMeshPrefix<i>.rmesh; every MeshChurnFrames frames one
+    // is loaded and the oldest unloaded, so the geometry arena fragments and is defragmented
+    const char* ChurnMeshPrefix = nullptr;
+    uint32_t    MeshChurnFrames = 0;
+
+    // NumTextures generated images of TextureSize pixels are written to TexturePrefix<i>.dds and streamed
+    const char* TexturePrefix = nullptr;
+    uint32_t    NumTextures   = 0;
+    uint32_t    TextureSize   = 1024;
+
+    SimulatedHMDDesc    HMD;
+    OpenVRInterfaceDesc Renderer;
+};
+
+static void PrintUsage()
+{
+    printf("Usage: RiptideBench [options]\n"
+           "  --mode vk|d3d11|d3d12   graphics backend\n"
+           "  --sw                    use a software adapter (WARP, lavapipe)\n"
+           "  --frames N              number of measured frames (default 1000)\n"
+           "  --warmup N              number of frames to run before measuring (default 60)\n"
+           "  --size WxH              recommended render target size per eye\n"
+           "  --refresh HZ            simulated display refresh rate\n"
+           "  --vsync                 throttle WaitGetPoses to the simulated refresh rate\n"
+           "  --trackers N            simulate N generic trackers in addition to the controllers\n"
+           "  --poses FILE            play back recorded poses instead of synthetic ones\n"
+           "  --props N               add a grid of N static cubes to the scene\n"
+           "  --mesh FILE             draw the props with the mesh in FILE (.rmesh) instead of cubes\n"
+           "  --sphere-mesh FILE N    write a sphere with N segments to FILE and draw the props with it\n"
+           "  --mesh-churn PREFIX N   write spheres to PREFIX<i>.rmesh, load one and unload another every N frames and defragment\n"
+           "  --textures PREFIX N SIZE write N SIZExSIZE images to PREFIX<i>.dds and stream them, half of them in use at a time\n"
+           "  --texture-budget MB     resident texture memory above which unused textures lose mips (default 256)\n"
+           "  --lod-error PIXELS      switch to a coarser level of detail while its error stays below PIXELS (default 1)\n"
+           "  --no-lods               draw every mesh at full detail\n"
+           "  --no-instancing         draw every cube with its own draw call\n"
+           "  --no-indirect           with instancing, issue one draw call per mesh instead of indirect multi-draws\n"
+           "  --gpu-culling           with indirect draws, cull and select levels of detail in compute passes\n"
+           "  --discard-constants     without instancing, map the constant buffer with DISCARD for every draw\n"
+           "  --simulate HZ           animate the props on a simulation thread ticking at HZ\n"
+           "  --threads N             without instancing, record the draws on N threads with deferred contexts\n"
+           "  --no-sort               without instancing, submit the draws in scene order instead of sorting them by state and depth\n"
+           "  --sort-threads N        without instancing, sort large draw lists on N more threads\n"
+           "  --no-late-latch         use the WaitGetPoses() poses instead of re-querying them before submission\n"
+           "  --multipass             render each eye in its own pass instead of single-pass instanced stereo\n"
+           "  --dynamic-res MIN       scale the resolution between MIN and 1 to keep the GPU within the frame budget\n"
+           "  --pacing                start each frame's work as late as the deadline allows (use with --vsync)\n"
+           "  --reproject             submit the last frame warped to the newest poses when a frame would be late\n"
+           "  --msaa N                render with N samples per pixel and resolve into the submitted textures\n"
+           "  --pack-eyes             with --multipass, place both eyes side by side in one texture\n"
+           "  --foveation INSET SCALE render a full resolution inset of relative size INSET and the periphery at SCALE\n"
+           "  --pipeline-cache FILE   load and store compiled shaders and pipeline states in FILE_<backend>.bin\n"
+           "  --profile               print per-stage CPU/GPU timings\n"
+           "  --expect-no-allocations fail if a measured frame allocated from the heap (needs RIPTIDE_TRACK_ALLOCATIONS)\n"
+           "  --trace FILE            write the profiled frames as Chrome trace JSON (implies --profile)\n");
+}
+
+static BenchSettings ParseCommandLine(int argc, char** argv)
+{
+    BenchSettings Settings;
+    // run as fast as possible unless asked otherwise
+    Settings.HMD.ThrottleToVSync = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        auto NextArg = [&]() {
+            if (i + 1 >= argc)
+                throw std::runtime_error(std::string("Missing value for ") + arg);
+            return argv[++i];
+        };
+
+        if (strcmp(arg, "--mode") == 0)
+        {
+            const char* mode = NextArg();
+            if (strcmp(mode, "vk") == 0)
+                Settings.DeviceType = RENDER_DEVICE_TYPE_VULKAN;
+            else if (strcmp(mode, "d3d11") == 0)
+                Settings.DeviceType = RENDER_DEVICE_TYPE_D3D11;
+            else if (strcmp(mode, "d3d12") == 0)
+                Settings.DeviceType = RENDER_DEVICE_TYPE_D3D12;
+            else
+                throw std::runtime_error(std::string("Unknown mode ") + mode);
+        }
+        else if (strcmp(arg, "--sw") == 0)
+            Settings.SoftwareAdapter = true;
+        else if (strcmp(arg, "--frames") == 0)
+            Settings.NumFrames = static_cast<uint32_t>(atoi(NextArg()));
+        else if (strcmp(arg, "--warmup") == 0)
+            Settings.NumWarmupFrames = static_cast<uint32_t>(atoi(NextArg()));
+        else if (strcmp(arg, "--size") == 0)
+        {
+            if (sscanf(NextArg(), "%ux%u", &Settings.HMD.RenderWidth, &Settings.HMD.RenderHeight) != 2)
+                throw std::runtime_error("--size expects WxH");
+        }
+        else if (strcmp(arg, "--refresh") == 0)
+            Settings.HMD.RefreshRate = static_cast<float>(atof(NextArg()));
+        else if (strcmp(arg, "--vsync") == 0)
+            Settings.HMD.ThrottleToVSync = true;
+        else if (strcmp(arg, "--trackers") == 0)
+            Settings.HMD.NumTrackers = static_cast<uint32_t>(atoi(NextArg()));
+        else if (strcmp(arg, "--poses") == 0)
+            Settings.HMD.PoseRecordingPath = NextArg();
+        else if (strcmp(arg, "--props") == 0)
+            Settings.NumProps = static_cast<uint32_t>(atoi(NextArg()));
+        else if (strcmp(arg, "--mesh") == 0)
+            Settings.MeshPath = NextArg();
+        else if (strcmp(arg, "--sphere-mesh") == 0)
+        {
+            Settings.MeshPath           = NextArg();
+            Settings.SphereMeshSegments = static_cast<uint32_t>(atoi(NextArg()));
+        }
+        else if (strcmp(arg, "--mesh-churn") == 0)
+        {
+            Settings.ChurnMeshPrefix = NextArg();
+            Settings.MeshChurnFrames = static_cast<uint32_t>(atoi(NextArg()));
+        }
+        else if (strcmp(arg, "--textures") == 0)
+        {
+            Settings.TexturePrefix                     = NextArg();
+            Settings.NumTextures                       = static_cast<uint32_t>(atoi(NextArg()));
+            Settings.TextureSize                       = static_cast<uint32_t>(atoi(NextArg()));
+            Settings.Renderer.TextureStreaming.Enabled = true;
+        }
+        else if (strcmp(arg, "--texture-budget") == 0)
+            Settings.Renderer.TextureStreaming.MemoryBudget = static_cast<uint64_t>(atoi(NextArg())) << 20;
+        else if (strcmp(arg, "--lod-error") == 0)
+            Settings.Renderer.MeshLods.MaxPixelError = static_cast<float>(atof(NextArg()));
+        else if (strcmp(arg, "--no-lods") == 0)
+            Settings.Renderer.MeshLods.Enabled = false;
+        else if (strcmp(arg, "--no-instancing") == 0)
+            Settings.Renderer.Instancing = false;
+        else if (strcmp(arg, "--no-indirect") == 0)
+            Settings.Renderer.IndirectDraws = false;
+        else if (strcmp(arg, "--gpu-culling") == 0)
+            Settings.Renderer.GpuCulling = true;
+        else if (strcmp(arg, "--discard-constants") == 0)
+            Settings.Renderer.RingBufferConstants = false;
+        else if (strcmp(arg, "--simulate") == 0)
+            Settings.SimulationRate = atof(NextArg());
+        else if (strcmp(arg, "--threads") == 0)
+            Settings.NumThreads = static_cast<uint32_t>(atoi(NextArg()));
+        else if (strcmp(arg, "--no-sort") == 0)
+            Settings.Renderer.SortDraws = false;
+        else if (strcmp(arg, "--sort-threads") == 0)
+            Settings.Renderer.NumSortThreads = static_cast<Uint32>(atoi(NextArg()));
+        else if (strcmp(arg, "--no-late-latch") == 0)
+            Settings.Renderer.LateLatchPoses = false;
+        else if (strcmp(arg, "--dynamic-res") == 0)
+        {
+            Settings.Renderer.DynamicResolution.Enabled  = true;
+            Settings.Renderer.DynamicResolution.MinScale = static_cast<float>(atof(NextArg()));
+        }
+        else if (strcmp(arg, "--pacing") == 0)
+            Settings.Renderer.FramePacing.Enabled = true;
+        else if (strcmp(arg, "--reproject") == 0)
+            Settings.Renderer.Reprojection.Enabled = true;
+        else if (strcmp(arg, "--msaa") == 0)
+            Settings.Renderer.EyeTargets.SampleCount = static_cast<uint32_t>(atoi(NextArg()));
+        else if (strcmp(arg, "--pack-eyes") == 0)
+            Settings.Renderer.EyeTargets.PackEyes = true;
+        else if (strcmp(arg, "--foveation") == 0)
+        {
+            Settings.Renderer.Foveation.Enabled        = true;
+            Settings.Renderer.Foveation.InsetSize      = static_cast<float>(atof(NextArg()));
+            Settings.Renderer.Foveation.PeripheryScale = static_cast<float>(atof(NextArg()));
+        }
+        else if (strcmp(arg, "--multipass") == 0)
+            Settings.Renderer.Stereo = StereoMode::MultiPass;
+        else if (strcmp(arg, "--pipeline-cache") == 0)
+            Settings.Renderer.PipelineCache.FilePath = NextArg();
+        else if (strcmp(arg, "--profile") == 0)
+            Settings.Profile = true;
+        else if (strcmp(arg, "--expect-no-allocations") == 0)
+            Settings.ExpectNoAllocations = true;
+        else if (strcmp(arg, "--trace") == 0)
+        {
+            Settings.TracePath = NextArg();
+            Settings.Profile   = true;
+        }
+        else
+        {
+            PrintUsage();
+            throw std::runtime_error(std::string("Unknown argument ") + arg);
+        }
+    }
+
+    if (Settings.NumFrames == 0)
+        throw std::runtime_error("--frames must be positive");
+    if (Settings.TexturePrefix != nullptr && (Settings.NumTextures == 0 || Settings.TextureSize == 0))
+        throw std::runtime_error("--textures needs a positive count and size");
+    if (Settings.ChurnMeshPrefix != nullptr && Settings.MeshChurnFrames == 0)
+        throw std::runtime_error("--mesh-churn needs a positive frame count");
+    if (Settings.ExpectNoAllocations && !AllocationTracker::IsAvailable())
+        throw std::runtime_error("--expect-no-allocations needs a build with RIPTIDE_TRACK_ALLOCATIONS");
+
+    return Settings;
+}
+
+static Uint32 FindAdapter(IEngineFactory* pFactory, Version MinVersion, bool Software)
+{
+    if (!Software)
+        return DEFAULT_ADAPTER_ID;
+
+    Uint32 numAdapters = 0;
+    pFactory->EnumerateAdapters(MinVersion, numAdapters, nullptr);
+    std::vector<GraphicsAdapterInfo> adapters(numAdapters);
+    if (numAdapters > 0)
+        pFactory->EnumerateAdapters(MinVersion, numAdapters, adapters.data());
+
+    for (Uint32 i = 0; i < numAdapters; ++i)
+    {
+        if (adapters[i].Type == ADAPTER_TYPE_SOFTWARE)
+            return i;
+    }
+    throw std::runtime_error("No software adapter found");
+}
+
+// Contexts receives the immediate context followed by Settings.NumThreads deferred contexts
+static void CreateHeadlessDevice(const BenchSettings& Settings, IRenderDevice** ppDevice, std::vector<RefCntAutoPtr<IDeviceContext>>& Contexts)
+{
+    std::vector<IDeviceContext*> ppContexts(1 + Settings.NumThreads);
+
+    switch (Settings.DeviceType)
+    {
+#if D3D11_SUPPORTED
+        case RENDER_DEVICE_TYPE_D3D11:
+        {
+#    if ENGINE_DLL
+            auto GetEngineFactoryD3D11 = LoadGraphicsEngineD3D11();
+            if (!GetEngineFactoryD3D11)
+                throw std::runtime_error("Failed to load D3D11 engine factory");
+#    endif
+            IEngineFactoryD3D11* pFactory = GetEngineFactoryD3D11();
+
+            EngineD3D11CreateInfo EngineCI;
+            EngineCI.GraphicsAPIVersion            = {11, 0};
+            EngineCI.AdapterId                     = FindAdapter(pFactory, EngineCI.GraphicsAPIVersion, Settings.SoftwareAdapter);
+            EngineCI.Features.TimestampQueries     = DEVICE_FEATURE_STATE_OPTIONAL;
+            EngineCI.Features.InstanceDataStepRate = DEVICE_FEATURE_STATE_OPTIONAL;
+            EngineCI.NumDeferredContexts           = Settings.NumThreads;
+            pFactory->CreateDeviceAndContextsD3D11(EngineCI, ppDevice, ppContexts.data());
+            break;
+        }
+#endif
+
+#if D3D12_SUPPORTED
+        case RENDER_DEVICE_TYPE_D3D12:
+        {
+#    if ENGINE_DLL
+            auto GetEngineFactoryD3D12 = LoadGraphicsEngineD3D12();
+            if (!GetEngineFactoryD3D12)
+                throw std::runtime_error("Failed to load D3D12 engine factory");
+#    endif
+            IEngineFactoryD3D12* pFactory = GetEngineFactoryD3D12();
+
+            EngineD3D12CreateInfo EngineCI;
+            EngineCI.AdapterId                     = FindAdapter(pFactory, Version{11, 0}, Settings.SoftwareAdapter);
+            EngineCI.Features.TimestampQueries     = DEVICE_FEATURE_STATE_OPTIONAL;
+            EngineCI.Features.InstanceDataStepRate = DEVICE_FEATURE_STATE_OPTIONAL;
+            EngineCI.NumDeferredContexts           = Settings.NumThreads;
+            pFactory->CreateDeviceAndContextsD3D12(EngineCI, ppDevice, ppContexts.data());
+            break;
+        }
+#endif
+
+#if VULKAN_SUPPORTED
+        case RENDER_DEVICE_TYPE_VULKAN:
+        {
+#    if EXPLICITLY_LOAD_ENGINE_VK_DLL
+            auto GetEngineFactoryVk = LoadGraphicsEngineVk();
+            if (!GetEngineFactoryVk)
+                throw std::runtime_error("Failed to load Vulkan engine factory");
+#    endif
+            IEngineFactoryVk* pFactory = GetEngineFactoryVk();
+
+            EngineVkCreateInfo EngineCI;
+            EngineCI.AdapterId                     = FindAdapter(pFactory, Version{}, Settings.SoftwareAdapter);
+            EngineCI.Features.TimestampQueries     = DEVICE_FEATURE_STATE_OPTIONAL;
+            EngineCI.Features.InstanceDataStepRate = DEVICE_FEATURE_STATE_OPTIONAL;
+            EngineCI.NumDeferredContexts           = Settings.NumThreads;
+
+            // each frame maps the constants of all its draws at once from the fixed-size dynamic heap, up to
+            // 256 bytes per draw, and up to three frames are in flight; the default size is kept for the rest
+            const Uint64 frameConstantBytes = Uint64{256} * (Settings.NumProps + 256);
+            EngineCI.DynamicHeapSize        = static_cast<Uint32>(std::min<Uint64>(EngineCI.DynamicHeapSize + 3 * frameConstantBytes, UINT32_MAX));
+            pFactory->CreateDeviceAndContextsVk(EngineCI, ppDevice, ppContexts.data());
+            break;
+        }
+#endif
+
+        default:
+            throw std::runtime_error("Requested backend is not supported by this build");
+    }
+
+    // the contexts are returned with one reference each
+    Contexts.resize(ppContexts.size());
+    for (size_t i = 0; i < ppContexts.size(); ++i)
+        Contexts[i].Attach(ppContexts[i]);
+
+    if (*ppDevice == nullptr || ppContexts[0] == nullptr)
+        throw std::runtime_error("Failed to create render device and context");
+    if (Settings.NumThreads > 0 && ppContexts.back() == nullptr)
+        throw std::runtime_error("Failed to create deferred contexts");
+}
+
+// props on a square grid in front of and around the seated user, every eighth one is transparent
+static std::vector<SceneProp> MakePropGrid(uint32_t count, uint32_t meshId)
+{
+    std::vector<SceneProp> props(count);
+
+    const uint32_t side    = static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<double>(count))));
+    const float    spacing = 0.5f;
+    for (uint32_t i = 0; i < count; ++i)
+    {
+        const float x = (static_cast<float>(i % side) - 0.5f * side) * spacing;
+        const float z = (static_cast<float>(i / side) + 1.0f) * spacing;
+
+        props[i].World           = float4x4::Scale(0.1f) * float4x4::Translation(x, 0.8f, z);
+        props[i].NormalTransform = ComputeNormalTransform(props[i].World);
+        props[i].Color           = float4(0.2f + 0.6f * (i % 7) / 6.f, 0.8f, 0.2f + 0.6f * (i % 5) / 4.f, i % 8 == 7 ? 0.5f : 1.0f);
+        props[i].MeshId          = meshId;
+    }
+    return props;
+}
+
+// spins every prop around its own vertical axis, the normal transforms are computed here as well
+static void AnimatePropGrid(const std::vector<SceneProp>& grid, double time, SceneSnapshot& scene)
+{
+    scene.Props.resize(grid.size());
+    for (size_t i = 0; i < grid.size(); ++i)
+    {
+        SceneProp& prop = scene.Props[i];
+
+        prop.World           = float4x4::RotationY(static_cast<float>(time) + 0.1f * static_cast<float>(i)) * grid[i].World;
+        prop.NormalTransform = ComputeNormalTransform(prop.World);
+        prop.Color           = grid[i].Color;
+        prop.MeshId          = grid[i].MeshId;
+    }
+}
+
+// uncompressed RGBA8 DDS with the full mip chain, a checkerboard tinted by Seed; the mips are box
+// filtered here since the loader does not generate them for DDS files
+static void WriteTextureFile(const std::string& Path, uint32_t Size, uint32_t Seed)
+{
+    uint32_t numMips = 1;
+    while ((Size >> numMips) > 0)
+        ++numMips;
+
+    // magic, DDS_HEADER with its DDS_PIXELFORMAT at dword 19
+    uint32_t header[32] = {};
+    header[0]           = 0x20534444; // "DDS "
+    header[1]           = 124;
+    header[2]           = 0x1 | 0x2 | 0x4 | 0x8 | 0x1000 | 0x20000; // caps, height, width, pitch, pixel format, mip count
+    header[3]           = Size;
+    header[4]           = Size;
+    header[5]           = Size * 4;
+    header[7]           = numMips;
+    header[19]          = 32;
+    header[20]          = 0x1 | 0x40; // alpha pixels, RGB
+    header[22]          = 32;
+    header[23]          = 0x000000ff;
+    header[24]          = 0x0000ff00;
+    header[25]          = 0x00ff0000;
+    header[26]          = 0xff000000;
+    header[27]          = 0x8 | 0x1000 | 0x400000; // complex, texture, mipmap
+
+    std::ofstream file(Path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+    std::vector<uint8_t> mip(size_t{Size} * Size * 4);
+    for (uint32_t y = 0; y < Size; ++y)
+    {
+        for (uint32_t x = 0; x < Size; ++x)
+        {
+            const bool light = ((x / 32) ^ (y / 32)) & 1;
+            uint8_t*   texel = &mip[(size_t{y} * Size + x) * 4];
+            texel[0]         = static_cast<uint8_t>(light ? 255 : 40 + (Seed * 37) % 160);
+            texel[1]         = static_cast<uint8_t>(light ? 255 : 40 + (Seed * 71) % 160);
+            texel[2]         = static_cast<uint8_t>(light ? 255 : 40 + (Seed * 113) % 160);
+            texel[3]         = 255;
+        }
+    }
+
+    for (uint32_t level = 0, size = Size; level < numMips; ++level, size /= 2)
+    {
+        file.write(reinterpret_cast<const char*>(mip.data()), static_cast<std::streamsize>(size_t{size} * size * 4));
+        if (size == 1)
+            break;
+
+        const uint32_t       half = size / 2;
+        std::vector<uint8_t> next(size_t{half} * half * 4);
+        for (uint32_t y = 0; y < half; ++y)
+        {
+            const uint8_t* row0 = &mip[size_t{2 * y} * size * 4];
+            const uint8_t* row1 = row0 + size_t{size} * 4;
+            for (uint32_t x = 0; x < half; ++x)
+            {
+                for (uint32_t c = 0; c < 4; ++c)
+                {
+                    const uint32_t sum = row0[8 * x + c] + row0[8 * x + 4 + c] + row1[8 * x + c] + row1[8 * x + 4 + c];
+                    next[(size_t{y} * half + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+        mip.swap(next);
+    }
+
+    if (!file)
+        throw std::runtime_error("Failed to write texture " + Path);
+}
+
+static double Percentile(const std::vector<double>& sorted, double p)
+{
+    const size_t idx = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(idx, sorted.size() - 1)];
+}
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        const BenchSettings Settings = ParseCommandLine(argc, argv);
+
+        RefCntAutoPtr<IRenderDevice>               pDevice;
+        std::vector<RefCntAutoPtr<IDeviceContext>> contexts;
+        CreateHeadlessDevice(Settings, &pDevice, contexts);
+        IDeviceContext* pContext = contexts[0];
+
+        std::vector<IDeviceContext*> deferredContexts;
+        for (size_t i = 1; i < contexts.size(); ++i)
+            deferredContexts.push_back(contexts[i]);
+
+        OpenVRInterfaceDesc rendererDesc = Settings.Renderer;
+        rendererDesc.ppDeferredContexts  = deferredContexts.data();
+        rendererDesc.NumDeferredContexts = static_cast<Uint32>(deferredContexts.size());
+
+        SimulatedVRRuntime vrRuntime(Settings.HMD);
+
+        using Clock = std::chrono::steady_clock;
+
+        // startup until the scene can be drawn, the pipeline states are created while loading frames are submitted
+        const auto      startupStart = Clock::now();
+        OpenVRInterface vrInterface(pDevice, pContext, &vrRuntime, rendererDesc);
+        vrInterface.Initialize();
+        uint32_t loadingFrames = 0;
+        for (; vrInterface.IsLoading(); ++loadingFrames)
+            vrInterface.RenderFrame(SceneSnapshot{});
+        const double startupMs = std::chrono::duration<double, std::milli>(Clock::now() - startupStart).count();
+
+        // the mesh is mapped and uploaded from the file like any asset, also when it was just written
+        uint32_t propMeshId = 0;
+        double   meshLoadMs = 0;
+        if (Settings.SphereMeshSegments > 0)
+        {
+            QuantizedMesh sphere = QuantizeMesh(CreateSphereMeshData(Settings.SphereMeshSegments));
+            GenerateLods(sphere);
+            WriteMeshFile(Settings.MeshPath, sphere);
+        }
+        if (Settings.MeshPath != nullptr)
+        {
+            const auto meshLoadStart = Clock::now();
+            propMeshId               = vrInterface.LoadMesh(Settings.MeshPath);
+            meshLoadMs               = std::chrono::duration<double, std::milli>(Clock::now() - meshLoadStart).count();
+        }
+
+        // without a simulation thread the scene is one snapshot of static props
+        const std::vector<SceneProp> grid = MakePropGrid(Settings.NumProps, propMeshId);
+
+        // prop i uses texture i % N. The view sweeps over the grid: half of the props are in use at a
+        // time, and the half moves on by one prop every textureSweepFrames frames, so the textures that
+        // fall out of it go stale, are evicted above the budget and are streamed in again later
+        std::vector<TextureStreamer::Handle> textures;
+        TextureStreamer*                     pTextures = vrInterface.GetTextureStreamer();
+        for (uint32_t tex = 0; tex < Settings.NumTextures; ++tex)
+        {
+            const std::string path = Settings.TexturePrefix + std::to_string(tex) + ".dds";
+            WriteTextureFile(path, Settings.TextureSize, tex);
+            textures.push_back(pTextures->Request(path.c_str()));
+        }
+        const uint32_t numTextureUsers    = std::max(Settings.NumProps, Settings.NumTextures);
+        const uint32_t textureSweepFrames = 10;
+        auto           MarkTexturesUsed   = [&](uint32_t frame) {
+            const uint32_t first = frame / textureSweepFrames;
+            for (uint32_t i = 0; i < (numTextureUsers + 1) / 2; ++i)
+                pTextures->MarkUsed(textures[(first + i) % numTextureUsers % textures.size()]);
+        };
+
+        // no prop refers to the churned meshes, they only come and go in the arena. Sizes differ, so a
+        // new mesh rarely fits the hole the unloaded one leaves
+        std::vector<std::string> churnPaths;
+        std::vector<uint32_t>    churnMeshes;
+        uint32_t                 numChurnedMeshes = 0;
+        uint32_t                 maxFreeRanges    = 0;
+        if (Settings.ChurnMeshPrefix != nullptr)
+        {
+            for (uint32_t segments : {12u, 24u, 48u})
+            {
+                QuantizedMesh sphere = QuantizeMesh(CreateSphereMeshData(segments));
+                GenerateLods(sphere);
+                churnPaths.push_back(Settings.ChurnMeshPrefix + std::to_string(churnPaths.size()) + ".rmesh");
+                WriteMeshFile(churnPaths.back().c_str(), sphere);
+            }
+        }
+        const uint32_t numLoadedChurnMeshes = 2;
+        auto           ChurnMeshes          = [&](uint32_t frame) {
+            if (frame % Settings.MeshChurnFrames != 0)
+                return;
+            if (churnMeshes.size() == numLoadedChurnMeshes)
+            {
+                vrInterface.UnloadMesh(churnMeshes.front());
+                churnMeshes.erase(churnMeshes.begin());
+            }
+            churnMeshes.push_back(vrInterface.LoadMesh(churnPaths[numChurnedMeshes % churnPaths.size()].c_str()));
+            ++numChurnedMeshes;
+
+            maxFreeRanges = std::max(maxFreeRanges, vrInterface.GetGeometryStats().NumFreeRanges);
+            vrInterface.DefragmentGeometry();
+        };
+
+        SceneSnapshot staticScene;
+        staticScene.TickIndex   = 1;
+        staticScene.StaticProps = std::make_shared<const std::vector<SceneProp>>(grid);
+
+        std::unique_ptr<SimulationThread> simulation;
+        if (Settings.SimulationRate > 0)
+        {
+            simulation = std::make_unique<SimulationThread>(Settings.SimulationRate, [&grid](double time, double, SceneSnapshot& scene) {
+                AnimatePropGrid(grid, time, scene);
+            });
+            simulation->Start();
+        }
+        auto LatestScene = [&]() -> const SceneSnapshot& { return simulation ? simulation->AcquireLatest() : staticScene; };
+
+        for (uint32_t frame = 0; frame < Settings.NumWarmupFrames; ++frame)
+        {
+            if (!churnPaths.empty())
+                ChurnMeshes(frame);
+            vrInterface.BeginFrame();
+            if (!textures.empty())
+                MarkTexturesUsed(frame);
+            vrInterface.RenderFrame(LatestScene());
+        }
+        pContext->WaitForIdle();
+
+        // only measured frames go into the per-stage statistics
+        vrInterface.GetProfiler().SetEnabled(Settings.Profile);
+
+        std::vector<double> frameTimesMs;
+        frameTimesMs.reserve(Settings.NumFrames);
+
+        CommandEncoder::Stats encoderStats;
+        uint64_t              visibleObjects = 0;
+        uint64_t              culledObjects  = 0;
+        uint64_t              fullTriangles  = 0;
+        uint64_t              lodTriangles   = 0;
+        double                resolutionSum  = 0;
+        uint64_t              fullPixels     = 0;
+        uint64_t              shadedPixels   = 0;
+        uint64_t              queuePackets   = 0;
+        uint64_t              queuePipelines = 0;
+        double                queueSortMs    = 0;
+        uint64_t              allocations    = 0;
+        uint64_t              allocatedBytes = 0;
+        uint32_t              allocFrames    = 0;
+        uint64_t              maxAllocations = 0;
+        double                startDelayMs   = 0;
+        double                latencyMs      = 0;
+        uint64_t              uploadedBytes  = 0;
+        uint64_t              maxUploaded    = 0;
+        uint64_t              evictedMips    = 0;
+
+        // the pacing counters run since the first frame
+        const FramePacer::Stats  pacingBefore      = vrInterface.GetPacingStats();
+        const Reprojector::Stats reprojectedBefore = vrInterface.GetReprojectionStats();
+
+        const uint64_t missedVSyncsBefore = vrRuntime.GetMissedVSyncCount();
+        const uint64_t submittedBefore    = vrRuntime.GetSubmittedFrameCount();
+        const auto     runStart           = Clock::now();
+        for (uint32_t frame = 0; frame < Settings.NumFrames; ++frame)
+        {
+            // between frames, so loading is not part of the frame time
+            if (!churnPaths.empty())
+                ChurnMeshes(Settings.NumWarmupFrames + frame);
+
+            // the scene is acquired after the pacing delay, like in the game
+            const auto frameStart = Clock::now();
+            vrInterface.BeginFrame();
+            if (!textures.empty())
+                MarkTexturesUsed(Settings.NumWarmupFrames + frame);
+            vrInterface.RenderFrame(LatestScene());
+            frameTimesMs.push_back(std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count());
+            encoderStats += vrInterface.GetEncoderStats();
+            visibleObjects += vrInterface.GetCullStats().NumVisible;
+            culledObjects += vrInterface.GetCullStats().NumCulled;
+            fullTriangles += vrInterface.GetLodStats().NumFullTriangles;
+            lodTriangles += vrInterface.GetLodStats().NumTriangles;
+            resolutionSum += vrInterface.GetResolutionScale();
+            queuePackets += vrInterface.GetDrawQueueStats().NumPackets;
+            queuePipelines += vrInterface.GetDrawQueueStats().NumPipelineChanges;
+            queueSortMs += vrInterface.GetDrawQueueStats().SortMs;
+            startDelayMs += vrInterface.GetPacingStats().StartDelayMs;
+            latencyMs += vrInterface.GetPacingStats().LatencyMs;
+            fullPixels += vrInterface.GetFoveationStats().FullPixels;
+            shadedPixels += vrInterface.GetFoveationStats().ShadedPixels;
+            if (pTextures != nullptr)
+            {
+                uploadedBytes += pTextures->GetStats().UploadedBytes;
+                maxUploaded = std::max(maxUploaded, pTextures->GetStats().UploadedBytes);
+                evictedMips += pTextures->GetStats().NumEvictedMips;
+            }
+
+            const AllocationTracker::Counts& frameAllocations = vrInterface.GetFrameAllocations();
+            allocations += frameAllocations.NumAllocations;
+            allocatedBytes += frameAllocations.NumBytes;
+            allocFrames += frameAllocations.NumAllocations > 0 ? 1 : 0;
+            maxAllocations = std::max(maxAllocations, frameAllocations.NumAllocations);
+        }
+        // include the GPU tail so throughput is not overstated
+        pContext->WaitForIdle();
+        const double runTimeMs = std::chrono::duration<double, std::milli>(Clock::now() - runStart).count();
+
+        if (simulation)
+            simulation->Stop();
+
+        std::vector<double> sorted = frameTimesMs;
+        std::sort(sorted.begin(), sorted.end());
+
+        double totalMs = 0;
+        for (double t : frameTimesMs)
+            totalMs += t;
+
+        const uint64_t submittedFrames = vrRuntime.GetSubmittedFrameCount() - submittedBefore;
+
+        printf("RiptideBench: %u frames, %ux%u per eye, %s, %u props%s, %u record threads, adapter: %s\n", Settings.NumFrames,
+               Settings.HMD.RenderWidth, Settings.HMD.RenderHeight,
+               Settings.Renderer.Stereo == StereoMode::MultiPass ? "multi-pass" : "single-pass stereo",
+               Settings.NumProps, Settings.Renderer.Instancing ? " (instanced)" : "",
+               Settings.Renderer.Instancing ? 0u : Settings.NumThreads, pDevice->GetAdapterInfo().Description);
+        printf("  RenderFrame ms: mean %.3f  min %.3f  p50 %.3f  p95 %.3f  p99 %.3f  max %.3f\n",
+               totalMs / sorted.size(), sorted.front(), Percentile(sorted, 0.50), Percentile(sorted, 0.95),
+               Percentile(sorted, 0.99), sorted.back());
+        const PipelineCache::Stats cacheStats = vrInterface.GetPipelineCache().GetStats();
+        printf("  startup: %.1f ms (%s), pipelines %.1f ms, %u loading frames\n", startupMs,
+               vrInterface.GetPipelineCache().WasLoaded() ? "warm" : "cold", vrInterface.GetPipelineCreationMs(), loadingFrames);
+        printf("  pipeline cache: %u/%u shaders, %u/%u pipelines found\n", cacheStats.ShaderHits,
+               cacheStats.ShaderHits + cacheStats.ShaderMisses, cacheStats.PipelineHits, cacheStats.PipelineHits + cacheStats.PipelineMisses);
+        if (Settings.MeshPath != nullptr)
+        {
+            const GpuMesh& mesh = vrInterface.GetMesh(propMeshId);
+            printf("  mesh: %s, %u vertices, %u triangles in %zu levels, %.1f KB vertex data, loaded in %.2f ms\n", Settings.MeshPath,
+                   mesh.NumVertices, mesh.Lods[0].NumIndices / 3, mesh.Lods.size(), mesh.NumVertices * sizeof(QuantizedVertex) / 1024.0, meshLoadMs);
+        }
+        const GeometryArena::Stats geometryStats = vrInterface.GetGeometryStats();
+        printf("  geometry arena: %u meshes, %.1f of %.1f MB used, %u free ranges, %u repacks\n", geometryStats.NumAllocations,
+               geometryStats.UsedBytes / (1024.0 * 1024.0), geometryStats.CapacityBytes / (1024.0 * 1024.0), geometryStats.NumFreeRanges, geometryStats.NumRepacks);
+        if (!churnPaths.empty())
+            printf("  mesh churn: %u meshes loaded, up to %u free ranges before defragmenting\n", numChurnedMeshes, maxFreeRanges);
+        printf("  eye targets: %.1f MB, %ux MSAA\n", vrInterface.GetEyeTargetMemory() / (1024.0 * 1024.0), Settings.Renderer.EyeTargets.SampleCount);
+        printf("  throughput: %.1f fps (%.1f ms total)\n", 1000.0 * Settings.NumFrames / runTimeMs, runTimeMs);
+        printf("  submitted frames: %llu, missed vsyncs: %llu\n",
+               static_cast<unsigned long long>(submittedFrames),
+               static_cast<unsigned long long>(vrRuntime.GetMissedVSyncCount() - missedVSyncsBefore));
+        const FramePacer::Stats& pacingStats = vrInterface.GetPacingStats();
+        printf("  pacing%s: %.2f ms start delay, %.2f ms pose-to-photons latency per frame, %llu dropped, %llu reprojected frames\n",
+               Settings.Renderer.FramePacing.Enabled ? "" : " (off)", startDelayMs / Settings.NumFrames, latencyMs / Settings.NumFrames,
+               static_cast<unsigned long long>(pacingStats.NumDroppedFrames - pacingBefore.NumDroppedFrames),
+               static_cast<unsigned long long>(pacingStats.NumReprojectedFrames - pacingBefore.NumReprojectedFrames));
+        if (Settings.Renderer.Reprojection.Enabled)
+        {
+            printf("  app reprojection%s: %llu frames\n", vrInterface.IsReprojectionPositional() ? "" : " (rotation only)",
+                   static_cast<unsigned long long>(vrInterface.GetReprojectionStats().NumReprojectedFrames - reprojectedBefore.NumReprojectedFrames));
+        }
+        if (simulation)
+        {
+            printf("  simulation: %llu ticks at %.1f Hz, %llu late\n",
+                   static_cast<unsigned long long>(simulation->GetTickCount()), Settings.SimulationRate,
+                   static_cast<unsigned long long>(simulation->GetLateTickCount()));
+        }
+
+        const double frames = static_cast<double>(Settings.NumFrames);
+        printf("  per frame: %.1f draws (%.1f indirect records), %.1f state changes submitted, %.1f filtered\n", encoderStats.NumDraws / frames,
+               encoderStats.NumIndirectRecords / frames, encoderStats.GetTotalSubmitted() / frames, encoderStats.GetTotalFiltered() / frames);
+        for (Uint32 type = 0; type < CommandEncoder::STATE_COUNT; ++type)
+        {
+            printf("    %-16s %10.1f submitted %10.1f filtered\n", CommandEncoder::GetStateName(static_cast<CommandEncoder::STATE_TYPE>(type)),
+                   encoderStats.Submitted[type] / frames, encoderStats.Filtered[type] / frames);
+        }
+        printf("  per frame: %.1f visible, %.1f culled objects\n", visibleObjects / frames, culledObjects / frames);
+        if (!Settings.Renderer.Instancing)
+        {
+            printf("  draw queue: %.1f packets, %.1f pipeline changes, %.3f ms sort per frame%s\n", queuePackets / frames, queuePipelines / frames,
+                   queueSortMs / frames, Settings.Renderer.SortDraws ? "" : " (unsorted)");
+        }
+        const FrameArena::Stats& arenaStats = vrInterface.GetFrameArenaStats();
+        printf("  frame arena: %.1f of %.1f KB peak, %u overflows\n", arenaStats.PeakUsed / 1024.0, arenaStats.Capacity / 1024.0, arenaStats.NumOverflows);
+        if (AllocationTracker::IsAvailable())
+        {
+            printf("  heap allocations: %.1f (%.1f KB) per frame, %u frames allocated, at most %llu\n", allocations / frames,
+                   allocatedBytes / frames / 1024.0, allocFrames, static_cast<unsigned long long>(maxAllocations));
+        }
+        if (fullTriangles > 0)
+        {
+            printf("  per frame and view: %.0f triangles at full detail, %.0f with levels of detail (%.1f%%)\n", fullTriangles / frames,
+                   lodTriangles / frames, 100.0 * static_cast<double>(lodTriangles) / static_cast<double>(fullTriangles));
+        }
+        if (pTextures != nullptr)
+        {
+            const TextureStreamer::Stats& textureStats = pTextures->GetStats();
+            printf("  textures: %u requested, %u fully resident, %u failed, %.1f of %.1f MB resident\n", textureStats.NumTextures,
+                   textureStats.NumFullyResident, textureStats.NumFailed, textureStats.ResidentBytes / (1024.0 * 1024.0),
+                   Settings.Renderer.TextureStreaming.MemoryBudget / (1024.0 * 1024.0));
+            printf("  texture streaming: %.2f MB uploaded per frame (at most %.2f MB, budget %.2f MB), %.2f mips evicted per frame\n",
+                   uploadedBytes / frames / (1024.0 * 1024.0), maxUploaded / (1024.0 * 1024.0),
+                   Settings.Renderer.TextureStreaming.UploadBudget / (1024.0 * 1024.0), evictedMips / frames);
+        }
+        if (Settings.Renderer.DynamicResolution.Enabled)
+            printf("  resolution scale: mean %.3f, last %.3f\n", resolutionSum / frames, vrInterface.GetResolutionScale());
+        if (Settings.Renderer.Foveation.Enabled && fullPixels > 0)
+        {
+            printf("  foveation: %.0f of %.0f scene pixels shaded per frame, %.1f%% fewer\n", shadedPixels / frames, fullPixels / frames,
+                   100.0 * (1.0 - static_cast<double>(shadedPixels) / static_cast<double>(fullPixels)));
+        }
+
+        if (Settings.Profile)
+        {
+            // the GPU is idle after WaitForIdle() above
+            vrInterface.GetProfiler().ResolvePendingGpuFrames();
+            vrInterface.GetProfiler().PrintReport(stdout);
+
+            if (Settings.TracePath != nullptr && !vrInterface.GetProfiler().WriteChromeTrace(Settings.TracePath))
+            {
+                fprintf(stderr, "Error: failed to write trace to %s\n", Settings.TracePath);
+                return 1;
+            }
+        }
+
+        if (submittedFrames != Settings.NumFrames)
+        {
+            fprintf(stderr, "Error: expected %u submitted frames\n", Settings.NumFrames);
+            return 1;
+        }
+        if (Settings.ExpectNoAllocations && allocFrames > 0)
+        {
+            fprintf(stderr, "Error: %u of %u frames allocated from the heap\n", allocFrames, Settings.NumFrames);
+            return 1;
+        }
+    }
+    catch (const std::exception& e)
+    {
+        fprintf(stderr, "Error: %s\n", e.what());
+        return -1;
+    }
+
+    return 0;
+}
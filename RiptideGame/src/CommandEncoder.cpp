@@ -0,0 +1,125 @@
+#include "CommandEncoder.h"
+
+Uint32 CommandEncoder::Stats::GetTotalSubmitted() const
+{
+    Uint32 total = 0;
+    for (Uint32 count : Submitted)
+        total += count;
+    return total;
+}
+
+Uint32 CommandEncoder::Stats::GetTotalFiltered() const
+{
+    Uint32 total = 0;
+    for (Uint32 count : Filtered)
+        total += count;
+    return total;
+}
+
+CommandEncoder::Stats& CommandEncoder::Stats::operator+=(const Stats& Other)
+{
+    for (Uint32 i = 0; i < STATE_COUNT; ++i)
+    {
+        Submitted[i] += Other.Submitted[i];
+        Filtered[i] += Other.Filtered[i];
+    }
+    NumDraws += Other.NumDraws;
+    NumIndirectRecords += Other.NumIndirectRecords;
+    return *this;
+}
+
+const char* CommandEncoder::GetStateName(STATE_TYPE Type)
+{
+    switch (Type)
+    {
+        case STATE_PIPELINE: return "pipeline";
+        case STATE_VERTEX_BUFFERS: return "vertex buffers";
+        case STATE_INDEX_BUFFER: return "index buffer";
+        case STATE_RESOURCES: return "resources";
+        case STATE_BUFFER_OFFSET: return "buffer offset";
+        default: return "unknown";
+    }
+}
+
+void CommandEncoder::Invalidate()
+{
+    m_pPSO             = nullptr;
+    m_NumVertexBuffers = 0;
+    m_pIndexBuffer     = nullptr;
+    m_pSRB             = nullptr;
+    m_ResourcesDirty   = true;
+    m_pOffsetVariable  = nullptr;
+}
+
+void CommandEncoder::SetPipelineState(IPipelineState* pPSO)
+{
+    if (Filter(pPSO == m_pPSO, STATE_PIPELINE))
+        return;
+
+    m_pContext->SetPipelineState(pPSO);
+    m_pPSO           = pPSO;
+    m_ResourcesDirty = true;
+}
+
+void CommandEncoder::SetVertexBuffers(Uint32 NumBuffers, IBuffer* const* ppBuffers, const Uint64* pOffsets)
+{
+    bool redundant = NumBuffers == m_NumVertexBuffers;
+    for (Uint32 i = 0; i < NumBuffers && redundant; ++i)
+        redundant = ppBuffers[i] == m_pVertexBuffers[i] && (pOffsets != nullptr ? pOffsets[i] : 0) == m_VertexBufferOffsets[i];
+    if (Filter(redundant, STATE_VERTEX_BUFFERS))
+        return;
+
+    // reset unused slots so a previous binding with more buffers does not linger
+    m_pContext->SetVertexBuffers(0, NumBuffers, ppBuffers, pOffsets, m_TransitionMode, SET_VERTEX_BUFFERS_FLAG_RESET);
+
+    // only cache what fits, larger bindings are never filtered
+    m_NumVertexBuffers = NumBuffers <= MaxVertexBuffers ? NumBuffers : 0;
+    for (Uint32 i = 0; i < m_NumVertexBuffers; ++i)
+    {
+        m_pVertexBuffers[i]      = ppBuffers[i];
+        m_VertexBufferOffsets[i] = pOffsets != nullptr ? pOffsets[i] : 0;
+    }
+}
+
+void CommandEncoder::SetIndexBuffer(IBuffer* pIndexBuffer, Uint64 Offset)
+{
+    if (Filter(pIndexBuffer == m_pIndexBuffer && Offset == m_IndexBufferOffset, STATE_INDEX_BUFFER))
+        return;
+
+    m_pContext->SetIndexBuffer(pIndexBuffer, Offset, m_TransitionMode);
+    m_pIndexBuffer      = pIndexBuffer;
+    m_IndexBufferOffset = Offset;
+}
+
+void CommandEncoder::SetBufferOffset(IShaderResourceVariable* pVariable, Uint32 Offset)
+{
+    if (Filter(pVariable == m_pOffsetVariable && Offset == m_BufferOffset, STATE_BUFFER_OFFSET))
+        return;
+
+    pVariable->SetBufferOffset(Offset);
+    m_pOffsetVariable = pVariable;
+    m_BufferOffset    = Offset;
+}
+
+void CommandEncoder::CommitShaderResources(IShaderResourceBinding* pSRB)
+{
+    if (Filter(pSRB == m_pSRB && !m_ResourcesDirty, STATE_RESOURCES))
+        return;
+
+    m_pContext->CommitShaderResources(pSRB, m_TransitionMode);
+    m_pSRB           = pSRB;
+    m_ResourcesDirty = false;
+}
+
+void CommandEncoder::DrawIndexed(const DrawIndexedAttribs& Attribs)
+{
+    m_pContext->DrawIndexed(Attribs);
+    ++m_Stats.NumDraws;
+}
+
+void CommandEncoder::DrawIndexedIndirect(const DrawIndexedIndirectAttribs& Attribs)
+{
+    m_pContext->DrawIndexedIndirect(Attribs);
+    ++m_Stats.NumDraws;
+    m_Stats.NumIndirectRecords += Attribs.DrawCount;
+}
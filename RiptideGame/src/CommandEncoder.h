@@ -0,0 +1,94 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include "DeviceContext.h"
+
+using namespace Diligent;
+
+// Thin layer in front of IDeviceContext that remembers the bound pipeline, vertex/index buffers,
+// SRB and dynamic buffer offsets and drops calls that would not change them.
+// Anything that changes context state behind the encoder's back must be followed by Invalidate().
+class CommandEncoder
+{
+public:
+    enum STATE_TYPE : Uint32
+    {
+        STATE_PIPELINE = 0,
+        STATE_VERTEX_BUFFERS,
+        STATE_INDEX_BUFFER,
+        STATE_RESOURCES,
+        STATE_BUFFER_OFFSET,
+        STATE_COUNT
+    };
+
+    struct Stats
+    {
+        Uint32 Submitted[STATE_COUNT] = {};
+        Uint32 Filtered[STATE_COUNT]  = {};
+        Uint32 NumDraws               = 0;
+
+        // records executed by the indirect draws, each of which counts once in NumDraws
+        Uint32 NumIndirectRecords = 0;
+
+        Uint32 GetTotalSubmitted() const;
+        Uint32 GetTotalFiltered() const;
+        Stats& operator+=(const Stats& Other);
+    };
+
+    static const char* GetStateName(STATE_TYPE Type);
+
+    // deferred contexts cannot transition resource states, they are transitioned up front and only verified
+    explicit CommandEncoder(IDeviceContext* pContext, RESOURCE_STATE_TRANSITION_MODE TransitionMode = RESOURCE_STATE_TRANSITION_MODE_TRANSITION) :
+        m_pContext(pContext),
+        m_TransitionMode(TransitionMode)
+    {
+    }
+
+    IDeviceContext* GetContext() const { return m_pContext; }
+
+    // forget the cached state, e.g. at the start of a frame or after executing command lists
+    void Invalidate();
+
+    const Stats& GetStats() const { return m_Stats; }
+    void         ResetStats() { m_Stats = {}; }
+
+    void SetPipelineState(IPipelineState* pPSO);
+    void SetVertexBuffers(Uint32 NumBuffers, IBuffer* const* ppBuffers, const Uint64* pOffsets);
+    void SetIndexBuffer(IBuffer* pIndexBuffer, Uint64 Offset = 0);
+
+    // the SRB is recommitted when it or the pipeline changes; offsets of dynamic buffers are applied
+    // when the next draw is prepared and do not need a recommit
+    void SetBufferOffset(IShaderResourceVariable* pVariable, Uint32 Offset);
+    void CommitShaderResources(IShaderResourceBinding* pSRB);
+
+    void DrawIndexed(const DrawIndexedAttribs& Attribs);
+    void DrawIndexedIndirect(const DrawIndexedIndirectAttribs& Attribs);
+
+private:
+    static constexpr Uint32 MaxVertexBuffers = 4;
+
+    bool Filter(bool Redundant, STATE_TYPE Type)
+    {
+        if (Redundant)
+            ++m_Stats.Filtered[Type];
+        else
+            ++m_Stats.Submitted[Type];
+        return Redundant;
+    }
+
+    IDeviceContext*                      m_pContext;
+    const RESOURCE_STATE_TRANSITION_MODE m_TransitionMode;
+
+    IPipelineState*          m_pPSO                                  = nullptr;
+    IBuffer*                 m_pVertexBuffers[MaxVertexBuffers]      = {};
+    Uint64                   m_VertexBufferOffsets[MaxVertexBuffers] = {};
+    Uint32                   m_NumVertexBuffers                      = 0;
+    IBuffer*                 m_pIndexBuffer                          = nullptr;
+    Uint64                   m_IndexBufferOffset                     = 0;
+    IShaderResourceBinding*  m_pSRB                                  = nullptr;
+    bool                     m_ResourcesDirty                        = true;
+    IShaderResourceVariable* m_pOffsetVariable                       = nullptr;
+    Uint32                   m_BufferOffset                          = 0;
+
+    Stats m_Stats;
+};
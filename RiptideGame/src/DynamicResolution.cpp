@@ -0,0 +1,111 @@
+#include "DynamicResolution.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+DynamicResolution::DynamicResolution(IRenderDevice* pDevice, const DynamicResolutionDesc& Desc, bool MeasureGpuTime) :
+    m_Desc(Desc)
+{
+    if (!m_Desc.Enabled)
+        m_Desc.MinScale = m_Desc.MaxScale;
+    if (m_Desc.MinScale <= 0 || m_Desc.MinScale > m_Desc.MaxScale)
+        throw std::runtime_error("Invalid dynamic resolution scale range");
+    m_Scale = m_Desc.MaxScale;
+
+    // without timestamps there is nothing to scale by, it stays at the maximum; while disabled,
+    // UpdateScale() cannot leave the maximum either
+    m_HasQueries = (m_Desc.Enabled || MeasureGpuTime) && pDevice->GetDeviceInfo().Features.TimestampQueries != DEVICE_FEATURE_STATE_DISABLED;
+    if (!m_HasQueries)
+        return;
+
+    QueryDesc queryDesc;
+    queryDesc.Name = "Dynamic resolution timestamp";
+    queryDesc.Type = QUERY_TYPE_TIMESTAMP;
+    for (FrameSlot& slot : m_Slots)
+    {
+        pDevice->CreateQuery(queryDesc, &slot.Begin);
+        pDevice->CreateQuery(queryDesc, &slot.End);
+    }
+}
+
+void DynamicResolution::BeginFrame(IDeviceContext* pContext, float FrameDuration)
+{
+    if (!m_HasQueries)
+        return;
+
+    // the slot reused for this frame holds the newest result that can be ready
+    FrameSlot& slot = m_Slots[m_FrameIndex % NumSlots];
+    double     gpuTimeMs;
+    if (slot.Pending && ReadBack(slot, gpuTimeMs))
+    {
+        m_LastGpuTimeMs = gpuTimeMs;
+        UpdateScale(gpuTimeMs, 1000.0 * FrameDuration * m_Desc.GpuBudget);
+    }
+    slot.Pending = false;
+
+    pContext->EndQuery(slot.Begin);
+    m_FrameActive = true;
+}
+
+void DynamicResolution::EndFrame(IDeviceContext* pContext)
+{
+    if (!m_FrameActive)
+        return;
+
+    FrameSlot& slot = m_Slots[m_FrameIndex % NumSlots];
+    pContext->EndQuery(slot.End);
+    slot.Pending  = true;
+    m_FrameActive = false;
+    ++m_FrameIndex;
+}
+
+void DynamicResolution::GetViewportSize(uint32_t TargetWidth, uint32_t TargetHeight, uint32_t& Width, uint32_t& Height) const
+{
+    const float relScale = m_Scale / m_Desc.MaxScale;
+    Width                = std::min(TargetWidth, (static_cast<uint32_t>(TargetWidth * relScale) + 7) & ~7u);
+    Height               = std::min(TargetHeight, (static_cast<uint32_t>(TargetHeight * relScale) + 7) & ~7u);
+}
+
+bool DynamicResolution::ReadBack(FrameSlot& Slot, double& GpuTimeMs)
+{
+    // still in flight after NumSlots frames, skip rather than stall
+    QueryDataTimestamp begin, end;
+    if (!Slot.Begin->GetData(&begin, sizeof(begin)) ||
+        !Slot.End->GetData(&end, sizeof(end)) ||
+        begin.Frequency == 0)
+        return false;
+
+    GpuTimeMs = static_cast<double>(end.Counter - begin.Counter) * 1000.0 / static_cast<double>(begin.Frequency);
+    return true;
+}
+
+void DynamicResolution::UpdateScale(double GpuTimeMs, double BudgetMs)
+{
+    ++m_FramesSinceDecrease;
+    if (GpuTimeMs > BudgetMs)
+    {
+        m_FramesUnderBudget = 0;
+
+        // frames still in flight were rendered at the old scale, they must not lower it again
+        if (m_FramesSinceDecrease <= NumSlots)
+            return;
+
+        // GPU time grows roughly with the pixel count, i.e. with the square of the scale;
+        // aim between the increase threshold and the budget
+        const double targetMs = BudgetMs * 0.5 * (1.0 + m_Desc.IncreaseThreshold);
+        m_Scale               = std::max(m_Desc.MinScale, static_cast<float>(m_Scale * std::sqrt(targetMs / GpuTimeMs)));
+        m_FramesSinceDecrease = 0;
+    }
+    else if (GpuTimeMs < BudgetMs * m_Desc.IncreaseThreshold)
+    {
+        if (++m_FramesUnderBudget >= m_Desc.IncreaseDelayFrames)
+        {
+            m_Scale             = std::min(m_Desc.MaxScale, m_Scale + m_Desc.IncreaseStep);
+            m_FramesUnderBudget = 0;
+        }
+    }
+    else
+    {
+        m_FramesUnderBudget = 0;
+    }
+}
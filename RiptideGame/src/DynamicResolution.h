@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include "RenderDevice.h"
+#include "DeviceContext.h"
+#include "Query.h"
+#include "RefCntAutoPtr.hpp"
+
+using namespace Diligent;
+
+struct DynamicResolutionDesc
+{
+    // off: always render at MaxScale
+    bool Enabled = false;
+
+    // relative to the recommended render target size; the targets are allocated at MaxScale
+    float MinScale = 0.6f;
+    float MaxScale = 1.0f;
+
+    // fraction of the frame duration the GPU work of a frame may take
+    float GpuBudget = 0.9f;
+
+    // the scale only grows after this many frames in a row below IncreaseThreshold of the budget,
+    // the gap to the budget keeps it from oscillating
+    uint32_t IncreaseDelayFrames = 45;
+    float    IncreaseThreshold   = 0.75f;
+    float    IncreaseStep        = 0.05f;
+};
+
+// Picks the render resolution scale from measured GPU frame times. The frame's GPU work is
+// bracketed by timestamp queries that are read back a few frames later without stalling; the scale
+// drops as soon as a frame is over budget and grows slowly once frames are well under it.
+class DynamicResolution
+{
+public:
+    // MeasureGpuTime keeps the GPU time measured while the scale is fixed, e.g. for frame pacing
+    DynamicResolution(IRenderDevice* pDevice, const DynamicResolutionDesc& Desc, bool MeasureGpuTime = false);
+
+    // FrameDuration is the display's frame time in seconds; picks this frame's scale from the
+    // newest GPU time that is available, immediate context only
+    void BeginFrame(IDeviceContext* pContext, float FrameDuration);
+    void EndFrame(IDeviceContext* pContext);
+
+    float GetScale() const { return m_Scale; }
+    float GetMaxScale() const { return m_Desc.MaxScale; }
+
+    // viewport size for this frame in a target allocated at MaxScale, in multiples of 8 pixels
+    void GetViewportSize(uint32_t TargetWidth, uint32_t TargetHeight, uint32_t& Width, uint32_t& Height) const;
+
+    // 0 until the first frame was read back
+    double GetLastGpuTimeMs() const { return m_LastGpuTimeMs; }
+
+private:
+    // frames in flight before their queries are read back
+    static constexpr uint32_t NumSlots = 4;
+
+    struct FrameSlot
+    {
+        RefCntAutoPtr<IQuery> Begin;
+        RefCntAutoPtr<IQuery> End;
+        bool                  Pending = false;
+    };
+
+    bool ReadBack(FrameSlot& Slot, double& GpuTimeMs);
+    void UpdateScale(double GpuTimeMs, double BudgetMs);
+
+    DynamicResolutionDesc m_Desc;
+
+    FrameSlot m_Slots[NumSlots];
+    uint64_t  m_FrameIndex  = 0;
+    bool      m_HasQueries  = false;
+    bool      m_FrameActive = false;
+
+    float    m_Scale               = 1.0f;
+    uint32_t m_FramesUnderBudget   = 0;
+    uint32_t m_FramesSinceDecrease = NumSlots;
+    double   m_LastGpuTimeMs       = 0;
+};
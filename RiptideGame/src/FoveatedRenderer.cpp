@@ -0,0 +1,274 @@
+#include "FoveatedRenderer.h"
+#include <algorithm>
+#include <stdexcept>
+#include "MapHelper.hpp"
+
+static const char* CompositeVSSource = R"(
+struct PSInput
+{
+    float4 Pos : SV_POSITION;
+    float2 UV  : TEX_COORD;
+};
+
+// one triangle covering the viewport, UV spans the viewport
+void main(in uint VertID : SV_VertexID, out PSInput PSOut)
+{
+    PSOut.UV  = float2((VertID << 1) & 2, VertID & 2);
+    PSOut.Pos = float4(PSOut.UV * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+}
+)";
+
+static const char* CompositePSSource = R"(
+struct PSInput
+{
+    float4 Pos : SV_POSITION;
+    float2 UV  : TEX_COORD;
+};
+
+cbuffer CompositeConstants
+{
+    float4 InsetRect[2];
+    float4 PeripheryUV;
+    float4 InsetUV;
+    uint   FirstEye;
+    uint   NumEyes;
+};
+
+Texture2D    g_Periphery;
+SamplerState g_Periphery_sampler;
+Texture2D    g_Inset;
+SamplerState g_Inset_sampler;
+
+// fraction of the inset over which it fades into the periphery, hides the change in sharpness
+static const float Feather = 0.05;
+
+// eye UV to target UV, clamped to the eye's region so filtering does not pick up the other eye
+float2 TargetUV(float2 EyeUV, uint LocalEye, float4 Scale)
+{
+    float2 uv = float2(LocalEye + EyeUV.x, EyeUV.y) * Scale.xy;
+    float2 lo = float2(LocalEye * Scale.x, 0.0) + Scale.zw;
+    float2 hi = float2((LocalEye + 1) * Scale.x, Scale.y) - Scale.zw;
+    return clamp(uv, lo, hi);
+}
+
+float4 main(in PSInput PSIn) : SV_TARGET
+{
+    uint   localEye = min(uint(PSIn.UV.x * NumEyes), NumEyes - 1);
+    float2 eyeUV    = float2(PSIn.UV.x * NumEyes - localEye, PSIn.UV.y);
+    float4 rect     = InsetRect[FirstEye + localEye];
+
+    float4 color = g_Periphery.Sample(g_Periphery_sampler, TargetUV(eyeUV, localEye, PeripheryUV));
+
+    float2 insetUV = (eyeUV - rect.xy) / (rect.zw - rect.xy);
+    if (all(insetUV >= 0.0) && all(insetUV <= 1.0))
+    {
+        // edges on the border of the view are not blended
+        float2 lo     = insetUV / Feather + step(rect.xy, 0.0);
+        float2 hi     = (1.0 - insetUV) / Feather + step(1.0, rect.zw);
+        float  weight = saturate(min(min(lo.x, lo.y), min(hi.x, hi.y)));
+        color = lerp(color, g_Inset.Sample(g_Inset_sampler, TargetUV(insetUV, localEye, InsetUV)), weight);
+    }
+    return float4(color.rgb, 1.0);
+}
+)";
+
+FoveatedRenderer::FoveatedRenderer(IRenderDevice*       pDevice,
+                                   const FoveationDesc& Desc,
+                                   uint32_t             NumViews,
+                                   uint32_t             EyeTargetWidth,
+                                   uint32_t             EyeTargetHeight,
+                                   TEXTURE_FORMAT       ColorFormat,
+                                   TEXTURE_FORMAT       DepthFormat) :
+    m_Desc(Desc),
+    m_NumViews(NumViews),
+    m_ColorFormat(ColorFormat)
+{
+    if (m_Desc.InsetSize <= 0 || m_Desc.InsetSize > 1 || m_Desc.PeripheryScale <= 0 || m_Desc.PeripheryScale > 1)
+        throw std::runtime_error("Invalid foveation inset size or periphery scale");
+
+    const float passScales[PASS_COUNT] = {m_Desc.PeripheryScale, m_Desc.InsetSize};
+    for (uint32_t pass = 0; pass < PASS_COUNT; ++pass)
+    {
+        m_TargetWidth[pass]  = std::max(1u, static_cast<uint32_t>(EyeTargetWidth * passScales[pass] + 0.5f));
+        m_TargetHeight[pass] = std::max(1u, static_cast<uint32_t>(EyeTargetHeight * passScales[pass] + 0.5f));
+
+        TextureDesc colorDesc;
+        colorDesc.Name      = pass == PASS_PERIPHERY ? "Foveation periphery" : "Foveation inset";
+        colorDesc.Type      = RESOURCE_DIM_TEX_2D;
+        colorDesc.Width     = m_TargetWidth[pass] * m_NumViews;
+        colorDesc.Height    = m_TargetHeight[pass];
+        colorDesc.Format    = ColorFormat;
+        colorDesc.BindFlags = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE;
+
+        TextureDesc depthDesc = colorDesc;
+        depthDesc.Format      = DepthFormat;
+        depthDesc.BindFlags   = BIND_DEPTH_STENCIL;
+
+        const uint32_t numTargets = m_NumViews > 1 ? 1 : 2;
+        for (uint32_t target = 0; target < numTargets; ++target)
+        {
+            pDevice->CreateTexture(colorDesc, nullptr, &m_Targets[pass].Color[target]);
+            m_MemoryUsage += GetTextureMemorySize(colorDesc);
+        }
+        pDevice->CreateTexture(depthDesc, nullptr, &m_Targets[pass].Depth);
+        m_MemoryUsage += GetTextureMemorySize(depthDesc);
+    }
+
+    BufferDesc CBDesc;
+    CBDesc.Name           = "Foveation Composite CB";
+    CBDesc.Size           = sizeof(CompositeConstants);
+    CBDesc.Usage          = USAGE_DYNAMIC;
+    CBDesc.BindFlags      = BIND_UNIFORM_BUFFER;
+    CBDesc.CPUAccessFlags = CPU_ACCESS_WRITE;
+    pDevice->CreateBuffer(CBDesc, nullptr, &m_Constants);
+}
+
+void FoveatedRenderer::CreatePipeline(PipelineCache& Cache)
+{
+    GraphicsPipelineStateCreateInfo PSOCreateInfo;
+    PSOCreateInfo.PSODesc.Name = "Foveation Composite PSO";
+
+    ShaderCreateInfo ShaderCI;
+    ShaderCI.SourceLanguage                  = SHADER_SOURCE_LANGUAGE_HLSL;
+    ShaderCI.Desc.UseCombinedTextureSamplers = true;
+    ShaderCI.EntryPoint                      = "main";
+
+    RefCntAutoPtr<IShader> pVS;
+    {
+        ShaderCI.Desc.ShaderType = SHADER_TYPE_VERTEX;
+        ShaderCI.Desc.Name       = "Foveation Composite VS";
+        ShaderCI.Source          = CompositeVSSource;
+        Cache.CreateShader(ShaderCI, &pVS);
+    }
+
+    RefCntAutoPtr<IShader> pPS;
+    {
+        ShaderCI.Desc.ShaderType = SHADER_TYPE_PIXEL;
+        ShaderCI.Desc.Name       = "Foveation Composite PS";
+        ShaderCI.Source          = CompositePSSource;
+        Cache.CreateShader(ShaderCI, &pPS);
+    }
+
+    // overwrites every pixel of the eye viewport, no depth
+    PSOCreateInfo.PSODesc.PipelineType                          = PIPELINE_TYPE_GRAPHICS;
+    PSOCreateInfo.GraphicsPipeline.NumRenderTargets             = 1;
+    PSOCreateInfo.GraphicsPipeline.RTVFormats[0]                = m_ColorFormat;
+    PSOCreateInfo.GraphicsPipeline.DSVFormat                    = TEX_FORMAT_UNKNOWN;
+    PSOCreateInfo.GraphicsPipeline.PrimitiveTopology            = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    PSOCreateInfo.GraphicsPipeline.RasterizerDesc.CullMode      = CULL_MODE_NONE;
+    PSOCreateInfo.GraphicsPipeline.DepthStencilDesc.DepthEnable = False;
+
+    PSOCreateInfo.pVS = pVS;
+    PSOCreateInfo.pPS = pPS;
+
+    ShaderResourceVariableDesc Variables[] = {
+        {SHADER_TYPE_PIXEL, "CompositeConstants", SHADER_RESOURCE_VARIABLE_TYPE_STATIC},
+        {SHADER_TYPE_PIXEL, "g_Periphery", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE},
+        {SHADER_TYPE_PIXEL, "g_Inset", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}};
+    PSOCreateInfo.PSODesc.ResourceLayout.Variables    = Variables;
+    PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = _countof(Variables);
+
+    const SamplerDesc    linearClamp{FILTER_TYPE_LINEAR, FILTER_TYPE_LINEAR, FILTER_TYPE_LINEAR,
+                                  TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP};
+    ImmutableSamplerDesc Samplers[] = {
+        {SHADER_TYPE_PIXEL, "g_Periphery", linearClamp},
+        {SHADER_TYPE_PIXEL, "g_Inset", linearClamp}};
+    PSOCreateInfo.PSODesc.ResourceLayout.ImmutableSamplers    = Samplers;
+    PSOCreateInfo.PSODesc.ResourceLayout.NumImmutableSamplers = _countof(Samplers);
+
+    Cache.CreateGraphicsPipelineState(PSOCreateInfo, &m_PSO);
+    if (m_PSO == nullptr)
+        throw std::runtime_error("Failed to create foveation composite pipeline state");
+
+    m_PSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "CompositeConstants")->Set(m_Constants);
+
+    // the targets never change, so every SRB is set up once
+    const uint32_t numTargets = m_NumViews > 1 ? 1 : 2;
+    for (uint32_t target = 0; target < numTargets; ++target)
+    {
+        m_PSO->CreateShaderResourceBinding(&m_SRBs[target], true);
+        m_SRBs[target]->GetVariableByName(SHADER_TYPE_PIXEL, "g_Periphery")->Set(m_Targets[PASS_PERIPHERY].Color[target]->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE));
+        m_SRBs[target]->GetVariableByName(SHADER_TYPE_PIXEL, "g_Inset")->Set(m_Targets[PASS_INSET].Color[target]->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE));
+    }
+}
+
+void FoveatedRenderer::BeginFrame(const StereoCamera& Camera, uint32_t ViewportWidth, uint32_t ViewportHeight)
+{
+    const float passScales[PASS_COUNT] = {m_Desc.PeripheryScale, m_Desc.InsetSize};
+    for (uint32_t pass = 0; pass < PASS_COUNT; ++pass)
+    {
+        m_PassWidth[pass]  = std::min(m_TargetWidth[pass], std::max(1u, static_cast<uint32_t>(ViewportWidth * passScales[pass] + 0.5f)));
+        m_PassHeight[pass] = std::min(m_TargetHeight[pass], std::max(1u, static_cast<uint32_t>(ViewportHeight * passScales[pass] + 0.5f)));
+    }
+
+    // the lens center is where the view direction projects to, it is off center on most HMDs;
+    // the inset is moved inside the view rather than cut off at its border
+    const float halfSize = m_Desc.InsetSize;
+    for (uint32_t eye = 0; eye < 2; ++eye)
+    {
+        const float4x4& proj    = Camera.GetProj(eye);
+        const float     centerX = proj.m[2][0] / proj.m[2][3];
+        const float     centerY = proj.m[2][1] / proj.m[2][3];
+        const float     x0      = clamp(centerX - halfSize, -1.0f, 1.0f - 2.0f * halfSize);
+        const float     y0      = clamp(centerY - halfSize, -1.0f, 1.0f - 2.0f * halfSize);
+        m_InsetNDC[eye]         = float4(x0, y0, x0 + 2.0f * halfSize, y0 + 2.0f * halfSize);
+    }
+
+    // both eyes, whether they are rendered in one pass or two
+    m_Stats.FullPixels   = 2ull * ViewportWidth * ViewportHeight;
+    m_Stats.ShadedPixels = 0;
+    for (uint32_t pass = 0; pass < PASS_COUNT; ++pass)
+        m_Stats.ShadedPixels += 2ull * m_PassWidth[pass] * m_PassHeight[pass];
+}
+
+ITextureView* FoveatedRenderer::GetRTV(PASS Pass, uint32_t Target) const
+{
+    return m_Targets[Pass].Color[Target]->GetDefaultView(TEXTURE_VIEW_RENDER_TARGET);
+}
+
+ITextureView* FoveatedRenderer::GetDSV(PASS Pass) const
+{
+    return m_Targets[Pass].Depth->GetDefaultView(TEXTURE_VIEW_DEPTH_STENCIL);
+}
+
+float4 FoveatedRenderer::GetClipTransform(PASS Pass, uint32_t Eye) const
+{
+    if (Pass == PASS_PERIPHERY)
+        return float4(1, 1, 0, 0);
+
+    // maps the inset rectangle to [-1, 1]
+    const float4& rect   = m_InsetNDC[Eye];
+    const float   scaleX = 2.0f / (rect.z - rect.x);
+    const float   scaleY = 2.0f / (rect.w - rect.y);
+    return float4(scaleX, scaleY, -0.5f * (rect.x + rect.z) * scaleX, -0.5f * (rect.y + rect.w) * scaleY);
+}
+
+void FoveatedRenderer::Composite(IDeviceContext* pContext, uint32_t Target, uint32_t FirstEye)
+{
+    {
+        MapHelper<CompositeConstants> constants(pContext, m_Constants, MAP_WRITE, MAP_FLAG_DISCARD);
+        for (uint32_t eye = 0; eye < 2; ++eye)
+        {
+            // NDC y points up, UV v down
+            const float4& rect        = m_InsetNDC[eye];
+            constants->InsetRect[eye] = float4(0.5f + 0.5f * rect.x, 0.5f - 0.5f * rect.w, 0.5f + 0.5f * rect.z, 0.5f - 0.5f * rect.y);
+        }
+
+        float4* passUV[PASS_COUNT] = {&constants->PeripheryUV, &constants->InsetUV};
+        for (uint32_t pass = 0; pass < PASS_COUNT; ++pass)
+        {
+            const float texWidth  = static_cast<float>(m_TargetWidth[pass] * m_NumViews);
+            const float texHeight = static_cast<float>(m_TargetHeight[pass]);
+            *passUV[pass]         = float4(m_PassWidth[pass] / texWidth, m_PassHeight[pass] / texHeight, 0.5f / texWidth, 0.5f / texHeight);
+        }
+
+        constants->FirstEye = FirstEye;
+        constants->NumEyes  = m_NumViews;
+    }
+
+    pContext->SetPipelineState(m_PSO);
+    pContext->CommitShaderResources(m_SRBs[Target], RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+
+    DrawAttribs drawAttrs{3, DRAW_FLAG_VERIFY_ALL};
+    pContext->Draw(drawAttrs);
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include "DeviceContext.h"
+#include "RefCntAutoPtr.hpp"
+#include "BasicMath.hpp"
+#include "StereoCamera.h"
+#include "RenderTargetManager.h"
+#include "PipelineCache.h"
+
+using namespace Diligent;
+
+struct FoveationDesc
+{
+    bool Enabled = false;
+
+    // width and height of the full resolution inset around the lens center, relative to the eye's
+    float InsetSize = 0.5f;
+
+    // resolution of the periphery pass relative to the eye's
+    float PeripheryScale = 0.5f;
+};
+
+// Fixed foveated rendering without variable rate shading hardware. Every eye is rendered twice:
+// completely at reduced resolution, and at full resolution only in an inset around the lens center,
+// where the lens resolves the most detail. Composite() then combines both into the eye target.
+// The targets use the same layout as the eye targets: one per eye, or both eyes side by side.
+class FoveatedRenderer
+{
+public:
+    enum PASS : uint32_t
+    {
+        PASS_PERIPHERY = 0,
+        PASS_INSET,
+        PASS_COUNT
+    };
+
+    struct Stats
+    {
+        // scene pixels without foveation, and the ones shaded by both passes
+        uint64_t FullPixels   = 0;
+        uint64_t ShadedPixels = 0;
+    };
+
+    FoveatedRenderer(IRenderDevice*       pDevice,
+                     const FoveationDesc& Desc,
+                     uint32_t             NumViews,
+                     uint32_t             EyeTargetWidth,
+                     uint32_t             EyeTargetHeight,
+                     TEXTURE_FORMAT       ColorFormat,
+                     TEXTURE_FORMAT       DepthFormat);
+
+    // creates the composite pipeline, may run on any thread before the first Composite()
+    void CreatePipeline(PipelineCache& Cache);
+
+    // places the insets at the lens centers of the eye projections and sizes the passes for the
+    // frame's eye viewport
+    void BeginFrame(const StereoCamera& Camera, uint32_t ViewportWidth, uint32_t ViewportHeight);
+
+    ITextureView* GetRTV(PASS Pass, uint32_t Target) const;
+    ITextureView* GetDSV(PASS Pass) const;
+
+    // viewport of one eye in the pass's target
+    uint32_t GetPassWidth(PASS Pass) const { return m_PassWidth[Pass]; }
+    uint32_t GetPassHeight(PASS Pass) const { return m_PassHeight[Pass]; }
+
+    // clip space scale (xy) and offset (zw) that stretches the part of the eye's view covered by
+    // the pass over its viewport
+    float4 GetClipTransform(PASS Pass, uint32_t Eye) const;
+
+    // draws both passes of the target's eyes into the bound render target, whose viewport must
+    // be set to the eye viewport; changes the pipeline and resources behind the caller's back
+    void Composite(IDeviceContext* pContext, uint32_t Target, uint32_t FirstEye);
+
+    const Stats& GetStats() const { return m_Stats; }
+
+    uint64_t GetMemoryUsage() const { return m_MemoryUsage; }
+
+private:
+    // in multi-pass mode the eyes are rendered one after the other, so they share the depth buffer
+    struct PassTarget
+    {
+        RefCntAutoPtr<ITexture> Color[2];
+        RefCntAutoPtr<ITexture> Depth;
+    };
+
+    struct CompositeConstants
+    {
+        float4   InsetRect[2];     // eye UV of the inset, min in xy, max in zw
+        float4   PeripheryUV;      // UV size of one eye's viewport in xy, half a texel in zw
+        float4   InsetUV;
+        uint32_t FirstEye;
+        uint32_t NumEyes;
+        uint32_t Padding[2];
+    };
+
+    const FoveationDesc  m_Desc;
+    const uint32_t       m_NumViews;
+    const TEXTURE_FORMAT m_ColorFormat;
+
+    // the second color target only exists in multi-pass mode
+    PassTarget m_Targets[PASS_COUNT];
+    uint32_t   m_TargetWidth[PASS_COUNT]  = {};
+    uint32_t   m_TargetHeight[PASS_COUNT] = {};
+
+    uint32_t m_PassWidth[PASS_COUNT]  = {};
+    uint32_t m_PassHeight[PASS_COUNT] = {};
+
+    // inset rectangles in NDC, x0 y0 x1 y1
+    float4 m_InsetNDC[2];
+
+    RefCntAutoPtr<IBuffer>                m_Constants;
+    RefCntAutoPtr<IPipelineState>         m_PSO;
+    RefCntAutoPtr<IShaderResourceBinding> m_SRBs[2];
+
+    Stats    m_Stats;
+    uint64_t m_MemoryUsage = 0;
+};
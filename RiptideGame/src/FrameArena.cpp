@@ -0,0 +1,47 @@
+#include "FrameArena.h"
+#include <algorithm>
+
+static uint8_t* AlignPointer(uint8_t* pMemory, size_t Alignment)
+{
+    const uintptr_t address = reinterpret_cast<uintptr_t>(pMemory);
+    return pMemory + (((address + Alignment - 1) & ~(uintptr_t{Alignment} - 1)) - address);
+}
+
+FrameArena::FrameArena(size_t Capacity) :
+    m_Block(new uint8_t[Capacity]),
+    m_Capacity(Capacity)
+{
+    m_Stats.Capacity = Capacity;
+}
+
+void* FrameArena::Allocate(size_t Size, size_t Alignment)
+{
+    const uintptr_t base   = reinterpret_cast<uintptr_t>(m_Block.get());
+    const size_t    offset = ((base + m_Used + Alignment - 1) & ~(uintptr_t{Alignment} - 1)) - base;
+    if (offset + Size <= m_Capacity)
+    {
+        m_Used = offset + Size;
+        return m_Block.get() + offset;
+    }
+
+    // the frame keeps running from the heap, the next one gets a block that fits
+    m_Overflow.emplace_back(new uint8_t[Size + Alignment]);
+    m_OverflowSize += Size + Alignment;
+    ++m_Stats.NumOverflows;
+    return AlignPointer(m_Overflow.back().get(), Alignment);
+}
+
+void FrameArena::Reset()
+{
+    m_Stats.PeakUsed = std::max(m_Stats.PeakUsed, GetUsed());
+    if (!m_Overflow.empty())
+    {
+        // with some headroom, so a frame slightly larger than this one does not overflow again
+        m_Capacity = GetUsed() + GetUsed() / 4;
+        m_Block.reset(new uint8_t[m_Capacity]);
+        m_Overflow.clear();
+        m_OverflowSize   = 0;
+        m_Stats.Capacity = m_Capacity;
+    }
+    m_Used = 0;
+}
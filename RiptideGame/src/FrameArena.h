@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// Linear allocator for one frame's transient CPU data, like draw packets and scratch lists.
+// Allocations bump an offset into one block and are all released by Reset() at the end of the
+// frame; nothing is destroyed, so only trivially destructible types go in. A frame that does not
+// fit takes overflow blocks from the heap and Reset() grows the block to that frame's size, so
+// steady-state frames do not touch the heap. Not thread-safe.
+class FrameArena
+{
+public:
+    struct Stats
+    {
+        size_t   Capacity     = 0;
+        size_t   PeakUsed     = 0; // by any frame so far
+        uint32_t NumOverflows = 0; // heap blocks taken by frames that did not fit, in total
+    };
+
+    explicit FrameArena(size_t Capacity = 256 << 10);
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    // Alignment must be a power of two
+    void* Allocate(size_t Size, size_t Alignment);
+
+    template <typename T>
+    T* Allocate(size_t Count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "frame arena memory is released without destroying its contents");
+        return static_cast<T*>(Allocate(sizeof(T) * Count, alignof(T)));
+    }
+
+    // releases everything allocated since the last Reset()
+    void Reset();
+
+    size_t       GetUsed() const { return m_Used + m_OverflowSize; }
+    const Stats& GetStats() const { return m_Stats; }
+
+private:
+    std::unique_ptr<uint8_t[]> m_Block;
+    size_t                     m_Capacity = 0;
+    size_t                     m_Used     = 0;
+
+    std::vector<std::unique_ptr<uint8_t[]>> m_Overflow;
+    size_t                                  m_OverflowSize = 0;
+
+    Stats m_Stats;
+};
+
+// for standard containers that only live until the end of the frame; deallocation does nothing,
+// so containers should be reserved up front instead of growing
+template <typename T>
+class FrameArenaAllocator
+{
+public:
+    using value_type = T;
+
+    explicit FrameArenaAllocator(FrameArena& Arena) :
+        m_pArena(&Arena)
+    {
+    }
+
+    template <typename U>
+    FrameArenaAllocator(const FrameArenaAllocator<U>& Other) :
+        m_pArena(Other.GetArena())
+    {
+    }
+
+    T*   allocate(size_t Count) { return static_cast<T*>(m_pArena->Allocate(sizeof(T) * Count, alignof(T))); }
+    void deallocate(T*, size_t) {}
+
+    FrameArena* GetArena() const { return m_pArena; }
+
+    template <typename U>
+    bool operator==(const FrameArenaAllocator<U>& Other) const { return m_pArena == Other.GetArena(); }
+    template <typename U>
+    bool operator!=(const FrameArenaAllocator<U>& Other) const { return m_pArena != Other.GetArena(); }
+
+private:
+    FrameArena* m_pArena;
+};
+
+template <typename T>
+using FrameVector = std::vector<T, FrameArenaAllocator<T>>;
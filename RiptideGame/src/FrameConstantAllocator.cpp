@@ -0,0 +1,59 @@
+#include "FrameConstantAllocator.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+FrameConstantAllocator::FrameConstantAllocator(IRenderDevice* pDevice, const char* Name, Uint64 InitialSize) :
+    m_pDevice(pDevice),
+    m_Name(Name),
+    m_Alignment(std::max(pDevice->GetAdapterInfo().Buffer.ConstantBufferOffsetAlignment, Uint32{16})),
+    m_Capacity(std::max<Uint64>(InitialSize, m_Alignment)) // doubled until a frame fits, so never zero
+{
+}
+
+void FrameConstantAllocator::Begin(IDeviceContext* pContext, Uint64 Size)
+{
+    m_Recreated = false;
+    if (!m_pBuffer || Size > m_Capacity)
+    {
+        while (m_Capacity < Size)
+            m_Capacity *= 2;
+
+        BufferDesc desc;
+        desc.Name           = m_Name;
+        desc.Size           = m_Capacity;
+        desc.Usage          = USAGE_DYNAMIC;
+        desc.BindFlags      = BIND_UNIFORM_BUFFER;
+        desc.CPUAccessFlags = CPU_ACCESS_WRITE;
+
+        m_pBuffer.Release();
+        m_pDevice->CreateBuffer(desc, nullptr, &m_pBuffer);
+        if (!m_pBuffer)
+            throw std::runtime_error("Failed to create frame constant buffer");
+        m_Recreated = true;
+    }
+
+    m_MappedData.Map(pContext, m_pBuffer, MAP_WRITE, MAP_FLAG_DISCARD);
+    if (!m_MappedData)
+        throw std::runtime_error("Failed to map frame constant buffer, " + std::to_string(Size) + " bytes may exceed the backend's dynamic memory");
+    m_Offset = 0;
+    m_Limit  = Size;
+}
+
+void FrameConstantAllocator::End()
+{
+    m_MappedData.Unmap();
+    m_Limit = 0;
+}
+
+Uint32 FrameConstantAllocator::Allocate(const void* pData, Uint32 Size)
+{
+    const Uint64 offset = m_Offset;
+    const Uint32 size   = GetAlignedSize(Size);
+    if (offset + size > m_Limit)
+        throw std::runtime_error("Frame constant allocation exceeds the size passed to Begin()");
+
+    memcpy(static_cast<Uint8*>(m_MappedData) + offset, pData, Size);
+    m_Offset += size;
+    return static_cast<Uint32>(offset);
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstring>
+#include "RenderDevice.h"
+#include "DeviceContext.h"
+#include "RefCntAutoPtr.hpp"
+#include "MapHelper.hpp"
+
+using namespace Diligent;
+
+// Linear allocator for one frame's dynamic constants. The whole buffer is mapped with DISCARD once
+// per frame and every draw takes an aligned sub-allocation that is bound with SetBufferOffset().
+// DISCARD hands out memory the GPU is not reading: D3D11 renames the buffer and the D3D12/Vulkan
+// backends suballocate from their fenced per-frame dynamic heap, so frames in flight are never
+// overwritten without a per-draw map.
+class FrameConstantAllocator
+{
+public:
+    FrameConstantAllocator(IRenderDevice* pDevice, const char* Name, Uint64 InitialSize = 64 << 10);
+
+    // Size is the upper bound of all allocations until End(); the buffer cannot grow while mapped.
+    // Throws if the backend cannot map Size bytes, on Vulkan they come from a dynamic heap of
+    // EngineVkCreateInfo::DynamicHeapSize shared by the frames in flight
+    void Begin(IDeviceContext* pContext, Uint64 Size);
+
+    // must be called before any draw that reads the buffer
+    void End();
+
+    Uint32 GetAlignedSize(Uint32 Size) const { return (Size + m_Alignment - 1) / m_Alignment * m_Alignment; }
+
+    // returns the offset to pass to SetBufferOffset()
+    Uint32 Allocate(const void* pData, Uint32 Size);
+
+    template <typename T>
+    Uint32 Allocate(const T& Data)
+    {
+        return Allocate(&Data, sizeof(T));
+    }
+
+    IBuffer* GetBuffer() const { return m_pBuffer; }
+
+    // true if the last Begin() recreated the buffer, so variables bound to the old one must be reset
+    bool WasRecreated() const { return m_Recreated; }
+
+    Uint64 GetUsedSize() const { return m_Offset; }
+
+private:
+    IRenderDevice* m_pDevice;
+    const char*    m_Name;
+    Uint32         m_Alignment;
+
+    RefCntAutoPtr<IBuffer> m_pBuffer;
+    Uint64                 m_Capacity  = 0;
+    bool                   m_Recreated = false;
+
+    MapHelper<Uint8> m_MappedData;
+    Uint64           m_Offset = 0;
+    Uint64           m_Limit  = 0;
+};
@@ -0,0 +1,95 @@
+#include "FramePacer.h"
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+void FramePacer::CostEstimate::Add(double Ms, double Smoothing)
+{
+    if (!Valid)
+    {
+        // like a round-trip time estimator, start with a wide deviation
+        Mean      = Ms;
+        Deviation = Ms * 0.5;
+        Valid     = true;
+        return;
+    }
+
+    const double error = Ms - Mean;
+    Mean += Smoothing * error;
+    Deviation += Smoothing * (std::abs(error) - Deviation);
+}
+
+FramePacer::FramePacer(const FramePacingDesc& Desc) :
+    m_Desc(Desc)
+{
+}
+
+void FramePacer::BeginFrame(IVRRuntime* pRuntime, double GpuTimeMs)
+{
+    const Clock::time_point now = Clock::now();
+
+    // a reprojected frame's GPU time says nothing about the cost of a rendered one
+    const bool skipGpuSample = m_SkipGpuSample;
+    m_SkipGpuSample          = false;
+
+    // the frame before the one WaitGetPoses() just started is the newest one that is complete
+    vr::Compositor_FrameTiming timing = {};
+    timing.m_nSize                    = sizeof(vr::Compositor_FrameTiming);
+    if (pRuntime->GetFrameTiming(&timing, 1) && (!m_HasTiming || timing.m_nFrameIndex != m_LastTimingFrame))
+    {
+        m_HasTiming       = true;
+        m_LastTimingFrame = timing.m_nFrameIndex;
+
+        const bool reprojected = (timing.m_nReprojectionFlags & (vr::VRCompositor_ReprojectionReason_Cpu | vr::VRCompositor_ReprojectionReason_Gpu)) != 0;
+        ++m_Stats.NumFrames;
+        m_Stats.NumDroppedFrames += timing.m_nNumDroppedFrames;
+        m_Stats.NumMispresentedFrames += timing.m_nNumMisPresented;
+        m_Stats.NumReprojectedFrames += reprojected ? 1 : 0;
+        if (reprojected || timing.m_nNumDroppedFrames > 0 || timing.m_nNumMisPresented > 0)
+            m_RecoveryFramesLeft = m_Desc.RecoveryFrames;
+
+        const float appGpuMs = timing.m_flPreSubmitGpuMs + timing.m_flPostSubmitGpuMs;
+        if (appGpuMs > 0)
+            GpuTimeMs = appGpuMs;
+        m_CompositorGpuMs = timing.m_flCompositorRenderGpuMs;
+    }
+    if (GpuTimeMs > 0 && !skipGpuSample)
+        m_Gpu.Add(GpuTimeMs, m_Desc.Smoothing);
+
+    m_Stats.CpuEstimateMs = static_cast<float>(m_Cpu.Get(m_Desc.DeviationFactor));
+    m_Stats.GpuEstimateMs = static_cast<float>(m_Gpu.Get(m_Desc.DeviationFactor));
+
+    // the CPU and GPU work overlap, but counting them one after the other errs on the early side
+    const double budgetMs = 1000.0 * pRuntime->GetFrameDuration() - m_CompositorGpuMs - m_Desc.SafetyMarginMs;
+    double       delayMs  = 0;
+    if (m_Desc.Enabled && m_RecoveryFramesLeft == 0 && m_Cpu.Valid)
+        delayMs = std::max(0.0, budgetMs - m_Stats.CpuEstimateMs - m_Stats.GpuEstimateMs);
+
+    // unlike the start, a missed deadline is only predicted from the mean costs, the padded ones
+    // would give up on frames that usually make it
+    m_WillMissDeadline = m_Cpu.Valid && m_Gpu.Valid && m_Cpu.Mean + m_Gpu.Mean > budgetMs;
+    if (m_RecoveryFramesLeft > 0)
+        --m_RecoveryFramesLeft;
+
+    m_StartTime          = now + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(delayMs));
+    m_Stats.StartDelayMs = static_cast<float>(delayMs);
+}
+
+bool FramePacer::WaitForStart()
+{
+    if (m_Stats.StartDelayMs <= 0)
+        return false;
+
+    std::this_thread::sleep_until(m_StartTime);
+    return true;
+}
+
+void FramePacer::EndFrame(double CpuTimeMs)
+{
+    m_Cpu.Add(CpuTimeMs, m_Desc.Smoothing);
+}
+
+void FramePacer::EndReprojectedFrame()
+{
+    m_SkipGpuSample = true;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include "VRRuntime.h"
+
+struct FramePacingDesc
+{
+    // off: the frame's work starts as soon as WaitGetPoses() returns; missed frames are counted either way
+    bool Enabled = false;
+
+    // kept free before the deadline for what the estimates miss, including the oversleep of the wait
+    float SafetyMarginMs = 1.5f;
+
+    // the cost estimates are a moving mean plus this many moving mean deviations
+    float DeviationFactor = 3.0f;
+
+    // weight of a new frame in the moving mean and deviation
+    float Smoothing = 0.1f;
+
+    // frames that start without delay after a missed or reprojected frame
+    uint32_t RecoveryFrames = 90;
+};
+
+// Starts the frame's CPU work as late as the deadline allows instead of right after
+// WaitGetPoses(), so the scene and the poses it is rendered with are newer when it is lit.
+// CPU cost is measured by the caller, GPU cost comes from the compositor's frame timing or,
+// when the runtime reports none, from the caller's own timestamps. The compositor's timing history
+// also tells which frames were dropped or reprojected; after one, frames start without delay for a while.
+class FramePacer
+{
+public:
+    struct Stats
+    {
+        // compositor frames seen, and of those the ones that missed their vsync
+        uint64_t NumFrames             = 0;
+        uint64_t NumDroppedFrames      = 0; // vsyncs that showed an old frame again
+        uint64_t NumReprojectedFrames  = 0; // frames the compositor reprojected because the CPU or GPU was late
+        uint64_t NumMispresentedFrames = 0;
+
+        // of the last frame
+        float StartDelayMs  = 0; // from WaitGetPoses() returning to the start of the frame's work
+        float LatencyMs     = 0; // from the query of the poses it is rendered with to its photons
+        float CpuEstimateMs = 0;
+        float GpuEstimateMs = 0;
+    };
+
+    explicit FramePacer(const FramePacingDesc& Desc);
+
+    // right after WaitGetPoses(): reads the timing of the last finished frame and picks this frame's
+    // start. GpuTimeMs is the newest GPU time of a frame measured by the caller, 0 if there is none
+    void BeginFrame(IVRRuntime* pRuntime, double GpuTimeMs);
+
+    // sleeps until the frame's work should start, false if it starts right away
+    bool WaitForStart();
+
+    // the newest poses the frame is rendered with are SecondsToPhotons from their photons
+    void SetPoseLatency(float SecondsToPhotons) { m_Stats.LatencyMs = 1000.f * SecondsToPhotons; }
+
+    // CPU time from the start of the frame's work until its submission
+    void EndFrame(double CpuTimeMs);
+
+    // instead of EndFrame() for a frame that was not rendered, its costs are not counted
+    void EndReprojectedFrame();
+
+    // whether this frame's mean CPU and GPU cost exceed what is left until its deadline
+    bool WillMissDeadline() const { return m_WillMissDeadline; }
+
+    const Stats& GetStats() const { return m_Stats; }
+
+private:
+    struct CostEstimate
+    {
+        double Mean      = 0;
+        double Deviation = 0;
+        bool   Valid     = false;
+
+        void   Add(double Ms, double Smoothing);
+        double Get(double DeviationFactor) const { return Mean + DeviationFactor * Deviation; }
+    };
+
+    using Clock = std::chrono::steady_clock;
+
+    FramePacingDesc m_Desc;
+
+    CostEstimate m_Cpu;
+    CostEstimate m_Gpu;
+
+    uint32_t m_LastTimingFrame    = 0;
+    bool     m_HasTiming          = false;
+    uint32_t m_RecoveryFramesLeft = 0;
+    double   m_CompositorGpuMs    = 0;
+    bool     m_WillMissDeadline   = false;
+    bool     m_SkipGpuSample      = false;
+
+    Clock::time_point m_StartTime;
+
+    Stats m_Stats;
+};
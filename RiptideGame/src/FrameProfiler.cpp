@@ -0,0 +1,320 @@
+#include "FrameProfiler.h"
+#include <algorithm>
+
+FrameProfiler::FrameProfiler(IRenderDevice* pDevice,
+                             uint32_t       HistoryFrames,
+                             uint32_t       MaxSamplesPerFrame,
+                             uint32_t       StatsWindow) :
+    m_StartTime(Clock::now()),
+    m_MaxSamplesPerFrame(MaxSamplesPerFrame),
+    m_StatsWindowSize(StatsWindow),
+    // GPU samples are appended to their frame's slot when resolved, so the history must outlive them
+    m_NumFrameSlots(std::max(HistoryFrames, NumGpuFrameSlots + 1)),
+    m_Frames(new FrameSlot[m_NumFrameSlots])
+{
+    for (uint32_t i = 0; i < m_NumFrameSlots; ++i)
+        m_Frames[i].Samples.resize(m_MaxSamplesPerFrame);
+
+    m_GpuTimersSupported = pDevice != nullptr && pDevice->GetDeviceInfo().Features.TimestampQueries != DEVICE_FEATURE_STATE_DISABLED;
+    if (m_GpuTimersSupported)
+    {
+        QueryDesc queryDesc;
+        queryDesc.Name = "Frame profiler timestamp";
+        queryDesc.Type = QUERY_TYPE_TIMESTAMP;
+        for (GpuFrameSlot& gpuSlot : m_GpuFrames)
+        {
+            gpuSlot.Queries.resize(MaxGpuScopesPerFrame * 2);
+            for (auto& pQuery : gpuSlot.Queries)
+                pDevice->CreateQuery(queryDesc, &pQuery);
+            gpuSlot.Scopes.reserve(MaxGpuScopesPerFrame);
+        }
+    }
+}
+
+uint32_t FrameProfiler::RegisterStage(const char* Name)
+{
+    Stage stage;
+    stage.Name = Name;
+    stage.Cpu.Values.resize(m_StatsWindowSize);
+    stage.Gpu.Values.resize(m_StatsWindowSize);
+    m_Stages.push_back(std::move(stage));
+
+    m_FrameTotals.resize(m_Stages.size());
+    m_StageHit.resize(m_Stages.size());
+    m_Scratch.reserve(m_StatsWindowSize);
+    return static_cast<uint32_t>(m_Stages.size() - 1);
+}
+
+double FrameProfiler::NowMs() const
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - m_StartTime).count();
+}
+
+uint32_t FrameProfiler::GetThreadIdx()
+{
+    static std::atomic<uint32_t> s_NextThreadIdx{0};
+    thread_local const uint32_t  t_ThreadIdx = s_NextThreadIdx.fetch_add(1);
+    return t_ThreadIdx;
+}
+
+void FrameProfiler::BeginFrame()
+{
+    m_Active = IsEnabled();
+    if (!m_Active)
+        return;
+
+    m_pCurrentFrame = &m_Frames[m_FrameIndex % m_NumFrameSlots];
+    m_pCurrentFrame->NumSamples.store(0, std::memory_order_relaxed);
+    m_pCurrentFrame->FrameIndex = m_FrameIndex;
+
+    if (m_GpuTimersSupported)
+    {
+        // the slot was last used NumGpuFrameSlots frames ago, which is normally enough for the GPU to catch up
+        GpuFrameSlot& gpuSlot = m_GpuFrames[m_FrameIndex % NumGpuFrameSlots];
+        if (!gpuSlot.Scopes.empty())
+            ResolveGpuFrame(gpuSlot);
+        gpuSlot.Scopes.clear();
+        gpuSlot.FrameIndex = m_FrameIndex;
+    }
+}
+
+void FrameProfiler::EndFrame()
+{
+    if (!m_Active)
+        return;
+    m_Active = false;
+
+    std::fill(m_FrameTotals.begin(), m_FrameTotals.end(), 0.0);
+    std::fill(m_StageHit.begin(), m_StageHit.end(), uint8_t{0});
+
+    const uint32_t numSamples = std::min(m_pCurrentFrame->NumSamples.load(std::memory_order_acquire), m_MaxSamplesPerFrame);
+    for (uint32_t i = 0; i < numSamples; ++i)
+    {
+        const Sample& s = m_pCurrentFrame->Samples[i];
+        m_FrameTotals[s.Stage] += s.DurationMs;
+        m_StageHit[s.Stage] = 1;
+    }
+
+    for (size_t stage = 0; stage < m_Stages.size(); ++stage)
+    {
+        if (m_StageHit[stage])
+            m_Stages[stage].Cpu.Push(m_FrameTotals[stage]);
+    }
+
+    m_pCurrentFrame = nullptr;
+    ++m_FrameIndex;
+}
+
+void FrameProfiler::ResolvePendingGpuFrames()
+{
+    if (!m_GpuTimersSupported)
+        return;
+
+    // oldest frame first
+    for (uint32_t i = 0; i < NumGpuFrameSlots; ++i)
+    {
+        GpuFrameSlot& gpuSlot = m_GpuFrames[(m_FrameIndex + i) % NumGpuFrameSlots];
+        if (!gpuSlot.Scopes.empty())
+            ResolveGpuFrame(gpuSlot);
+        gpuSlot.Scopes.clear();
+    }
+}
+
+void FrameProfiler::AddSample(FrameSlot& Slot, const Sample& S)
+{
+    const uint32_t idx = Slot.NumSamples.fetch_add(1, std::memory_order_acq_rel);
+    if (idx < m_MaxSamplesPerFrame)
+        Slot.Samples[idx] = S;
+    else
+        m_DroppedSamples.fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameProfiler::AddCpuSample(uint32_t Stage, double StartMs, double DurationMs)
+{
+    if (!m_Active)
+        return;
+
+    AddSample(*m_pCurrentFrame, Sample{Stage, GetThreadIdx(), StartMs, DurationMs});
+}
+
+uint32_t FrameProfiler::BeginGpuScope(IDeviceContext* pContext, uint32_t Stage)
+{
+    if (!m_Active || !m_GpuTimersSupported)
+        return InvalidGpuScope;
+
+    GpuFrameSlot& gpuSlot = m_GpuFrames[m_FrameIndex % NumGpuFrameSlots];
+    if (gpuSlot.Scopes.size() >= MaxGpuScopesPerFrame)
+    {
+        m_DroppedSamples.fetch_add(1, std::memory_order_relaxed);
+        return InvalidGpuScope;
+    }
+
+    const uint32_t scope = static_cast<uint32_t>(gpuSlot.Scopes.size());
+    gpuSlot.Scopes.push_back(GpuScope{Stage, NowMs()});
+    pContext->EndQuery(gpuSlot.Queries[scope * 2]);
+    return scope;
+}
+
+void FrameProfiler::EndGpuScope(IDeviceContext* pContext, uint32_t Scope)
+{
+    GpuFrameSlot& gpuSlot = m_GpuFrames[m_FrameIndex % NumGpuFrameSlots];
+    pContext->EndQuery(gpuSlot.Queries[Scope * 2 + 1]);
+}
+
+void FrameProfiler::ResolveGpuFrame(GpuFrameSlot& GpuSlot)
+{
+    std::fill(m_FrameTotals.begin(), m_FrameTotals.end(), 0.0);
+    std::fill(m_StageHit.begin(), m_StageHit.end(), uint8_t{0});
+
+    // GPU and CPU clocks are not correlated: anchor the first GPU timestamp of the frame
+    // to the CPU time at which its scope was opened
+    FrameSlot* pFrame = &m_Frames[GpuSlot.FrameIndex % m_NumFrameSlots];
+    if (pFrame->FrameIndex != GpuSlot.FrameIndex)
+        pFrame = nullptr;
+
+    bool   hasAnchor     = false;
+    Uint64 anchorCounter = 0;
+    double anchorMs      = 0;
+    for (size_t scope = 0; scope < GpuSlot.Scopes.size(); ++scope)
+    {
+        QueryDataTimestamp begin, end;
+        if (!GpuSlot.Queries[scope * 2]->GetData(&begin, sizeof(begin)) ||
+            !GpuSlot.Queries[scope * 2 + 1]->GetData(&end, sizeof(end)) ||
+            begin.Frequency == 0)
+        {
+            // still in flight after NumGpuFrameSlots frames, drop rather than stall
+            m_DroppedSamples.fetch_add(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        const double ticksToMs = 1000.0 / static_cast<double>(begin.Frequency);
+        if (!hasAnchor)
+        {
+            hasAnchor     = true;
+            anchorCounter = begin.Counter;
+            anchorMs      = GpuSlot.Scopes[scope].CpuStartMs;
+        }
+
+        const uint32_t stage      = GpuSlot.Scopes[scope].Stage;
+        const double   durationMs = static_cast<double>(end.Counter - begin.Counter) * ticksToMs;
+        m_FrameTotals[stage] += durationMs;
+        m_StageHit[stage] = 1;
+
+        if (pFrame != nullptr)
+        {
+            const double startMs = anchorMs + (static_cast<double>(begin.Counter) - static_cast<double>(anchorCounter)) * ticksToMs;
+            AddSample(*pFrame, Sample{stage, GpuThreadIdx, startMs, durationMs});
+        }
+    }
+
+    for (size_t stage = 0; stage < m_Stages.size(); ++stage)
+    {
+        if (m_StageHit[stage])
+            m_Stages[stage].Gpu.Push(m_FrameTotals[stage]);
+    }
+}
+
+void FrameProfiler::StatsWindow::Push(double Value)
+{
+    Values[Next] = Value;
+    Next         = (Next + 1) % static_cast<uint32_t>(Values.size());
+    Count        = std::min(Count + 1, static_cast<uint32_t>(Values.size()));
+}
+
+FrameProfiler::StageStats FrameProfiler::StatsWindow::Compute(std::vector<double>& Scratch) const
+{
+    StageStats stats;
+    if (Count == 0)
+        return stats;
+
+    Scratch.assign(Values.begin(), Values.begin() + Count);
+
+    double sum = 0;
+    for (double v : Scratch)
+        sum += v;
+
+    auto Percentile = [&](double p) {
+        auto nth = Scratch.begin() + static_cast<size_t>(p * (Scratch.size() - 1) + 0.5);
+        std::nth_element(Scratch.begin(), nth, Scratch.end());
+        return *nth;
+    };
+
+    stats.Mean      = sum / Count;
+    stats.P50       = Percentile(0.50);
+    stats.P95       = Percentile(0.95);
+    stats.P99       = Percentile(0.99);
+    stats.NumFrames = Count;
+    return stats;
+}
+
+FrameProfiler::StageStats FrameProfiler::GetCpuStats(uint32_t Stage) const
+{
+    return m_Stages[Stage].Cpu.Compute(m_Scratch);
+}
+
+FrameProfiler::StageStats FrameProfiler::GetGpuStats(uint32_t Stage) const
+{
+    return m_Stages[Stage].Gpu.Compute(m_Scratch);
+}
+
+void FrameProfiler::PrintReport(FILE* pFile) const
+{
+    fprintf(pFile, "  %-24s %38s   %38s\n", "stage (ms)", "CPU mean / p50 / p95 / p99", "GPU mean / p50 / p95 / p99");
+    for (uint32_t stage = 0; stage < GetNumStages(); ++stage)
+    {
+        const StageStats cpu = GetCpuStats(stage);
+        const StageStats gpu = GetGpuStats(stage);
+        if (cpu.NumFrames == 0 && gpu.NumFrames == 0)
+            continue;
+
+        fprintf(pFile, "  %-24s", m_Stages[stage].Name.c_str());
+        for (const StageStats* pStats : {&cpu, &gpu})
+        {
+            if (pStats->NumFrames > 0)
+                fprintf(pFile, "   %8.3f %8.3f %8.3f %8.3f", pStats->Mean, pStats->P50, pStats->P95, pStats->P99);
+            else
+                fprintf(pFile, "   %8s %8s %8s %8s", "-", "-", "-", "-");
+        }
+        fprintf(pFile, "\n");
+    }
+
+    const uint64_t dropped = GetDroppedSampleCount();
+    if (dropped > 0)
+        fprintf(pFile, "  dropped samples: %llu\n", static_cast<unsigned long long>(dropped));
+}
+
+bool FrameProfiler::WriteChromeTrace(const char* Path) const
+{
+    FILE* pFile = fopen(Path, "w");
+    if (pFile == nullptr)
+        return false;
+
+    // GPU samples get their own track
+    const uint32_t gpuTid = 1000;
+
+    fprintf(pFile, "{\"traceEvents\":[\n");
+    fprintf(pFile, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"GPU\"}}", gpuTid);
+
+    // oldest frame first
+    for (uint32_t i = 0; i < m_NumFrameSlots; ++i)
+    {
+        const FrameSlot& frame = m_Frames[(m_FrameIndex + i) % m_NumFrameSlots];
+        if (frame.FrameIndex == ~uint64_t{0})
+            continue;
+
+        const uint32_t numSamples = std::min(frame.NumSamples.load(std::memory_order_acquire), m_MaxSamplesPerFrame);
+        for (uint32_t s = 0; s < numSamples; ++s)
+        {
+            const Sample& sample = frame.Samples[s];
+            fprintf(pFile, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,\"args\":{\"frame\":%llu}}",
+                    m_Stages[sample.Stage].Name.c_str(),
+                    sample.ThreadIdx == GpuThreadIdx ? "gpu" : "cpu",
+                    sample.ThreadIdx == GpuThreadIdx ? gpuTid : sample.ThreadIdx,
+                    sample.StartMs * 1000.0, sample.DurationMs * 1000.0,
+                    static_cast<unsigned long long>(frame.FrameIndex));
+        }
+    }
+
+    fprintf(pFile, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return fclose(pFile) == 0;
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+#include "RenderDevice.h"
+#include "DeviceContext.h"
+#include "Query.h"
+#include "RefCntAutoPtr.hpp"
+
+using namespace Diligent;
+
+// Per-stage CPU/GPU frame timings. Samples of each frame go into a preallocated ring of frame slots
+// that any thread can append to without locking; rolling percentiles are computed from per-frame
+// stage totals, and the retained history can be written out as Chrome trace JSON.
+// When disabled, scoped timers reduce to a single branch.
+class FrameProfiler
+{
+public:
+    struct StageStats
+    {
+        double   Mean      = 0;
+        double   P50       = 0;
+        double   P95       = 0;
+        double   P99       = 0;
+        uint32_t NumFrames = 0;
+    };
+
+    static constexpr uint32_t InvalidGpuScope = ~0u;
+
+    FrameProfiler(IRenderDevice* pDevice,
+                  uint32_t       HistoryFrames      = 128,
+                  uint32_t       MaxSamplesPerFrame = 2048,
+                  uint32_t       StatsWindow        = 512);
+
+    // Stages must be registered before the first frame is profiled.
+    uint32_t RegisterStage(const char* Name);
+
+    void SetEnabled(bool Enabled) { m_Enabled.store(Enabled, std::memory_order_relaxed); }
+    bool IsEnabled() const { return m_Enabled.load(std::memory_order_relaxed); }
+
+    // true between BeginFrame() and EndFrame() of a frame that is being profiled
+    bool IsActive() const { return m_Active; }
+
+    void BeginFrame();
+    void EndFrame();
+
+    // GPU timings are normally read back a few frames late; call once the GPU is idle
+    // to collect the outstanding ones, e.g. before printing the final report
+    void ResolvePendingGpuFrames();
+
+    // thread-safe while the frame is active
+    void AddCpuSample(uint32_t Stage, double StartMs, double DurationMs);
+
+    // immediate context only: Diligent does not support queries in deferred contexts
+    uint32_t BeginGpuScope(IDeviceContext* pContext, uint32_t Stage);
+    void     EndGpuScope(IDeviceContext* pContext, uint32_t Scope);
+
+    StageStats GetCpuStats(uint32_t Stage) const;
+    StageStats GetGpuStats(uint32_t Stage) const;
+
+    uint32_t           GetNumStages() const { return static_cast<uint32_t>(m_Stages.size()); }
+    const std::string& GetStageName(uint32_t Stage) const { return m_Stages[Stage].Name; }
+    uint64_t           GetDroppedSampleCount() const { return m_DroppedSamples.load(std::memory_order_relaxed); }
+
+    void PrintReport(FILE* pFile) const;
+
+    // writes the retained frame history in the Chrome trace event format (chrome://tracing, Perfetto)
+    bool WriteChromeTrace(const char* Path) const;
+
+    double NowMs() const;
+
+private:
+    static constexpr uint32_t GpuThreadIdx         = ~0u;
+    static constexpr uint32_t NumGpuFrameSlots     = 4;
+    static constexpr uint32_t MaxGpuScopesPerFrame = 64;
+
+    struct Sample
+    {
+        uint32_t Stage;
+        uint32_t ThreadIdx;
+        double   StartMs;
+        double   DurationMs;
+    };
+
+    struct FrameSlot
+    {
+        std::vector<Sample>   Samples;
+        std::atomic<uint32_t> NumSamples{0};
+        uint64_t              FrameIndex = ~uint64_t{0};
+    };
+
+    // rolling window of per-frame totals
+    struct StatsWindow
+    {
+        std::vector<double> Values;
+        uint32_t            Next  = 0;
+        uint32_t            Count = 0;
+
+        void       Push(double Value);
+        StageStats Compute(std::vector<double>& Scratch) const;
+    };
+
+    struct Stage
+    {
+        std::string Name;
+        StatsWindow Cpu;
+        StatsWindow Gpu;
+    };
+
+    struct GpuScope
+    {
+        uint32_t Stage;
+        double   CpuStartMs;
+    };
+
+    struct GpuFrameSlot
+    {
+        std::vector<RefCntAutoPtr<IQuery>> Queries; // begin/end pairs
+        std::vector<GpuScope>              Scopes;
+        uint64_t                           FrameIndex = ~uint64_t{0};
+    };
+
+    static uint32_t GetThreadIdx();
+
+    void AddSample(FrameSlot& Slot, const Sample& S);
+    void ResolveGpuFrame(GpuFrameSlot& GpuSlot);
+
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point m_StartTime;
+
+    const uint32_t m_MaxSamplesPerFrame;
+    const uint32_t m_StatsWindowSize;
+    const uint32_t m_NumFrameSlots;
+
+    std::atomic<bool> m_Enabled{false};
+    bool              m_Active     = false;
+    uint64_t          m_FrameIndex = 0;
+
+    std::vector<Stage>           m_Stages;
+    std::unique_ptr<FrameSlot[]> m_Frames;
+    FrameSlot*                   m_pCurrentFrame = nullptr;
+
+    bool         m_GpuTimersSupported = false;
+    GpuFrameSlot m_GpuFrames[NumGpuFrameSlots];
+
+    std::vector<double>         m_FrameTotals;
+    std::vector<uint8_t>        m_StageHit;
+    mutable std::vector<double> m_Scratch;
+
+    std::atomic<uint64_t> m_DroppedSamples{0};
+};
+
+class ScopedCpuTimer
+{
+public:
+    ScopedCpuTimer(FrameProfiler& Profiler, uint32_t Stage) :
+        m_Profiler(Profiler),
+        m_Stage(Stage)
+    {
+        if (m_Profiler.IsActive())
+            m_StartMs = m_Profiler.NowMs();
+    }
+
+    ~ScopedCpuTimer()
+    {
+        if (m_StartMs >= 0)
+            m_Profiler.AddCpuSample(m_Stage, m_StartMs, m_Profiler.NowMs() - m_StartMs);
+    }
+
+    ScopedCpuTimer(const ScopedCpuTimer&) = delete;
+    ScopedCpuTimer& operator=(const ScopedCpuTimer&) = delete;
+
+private:
+    FrameProfiler& m_Profiler;
+    uint32_t       m_Stage;
+    double         m_StartMs = -1;
+};
+
+class ScopedGpuTimer
+{
+public:
+    ScopedGpuTimer(FrameProfiler& Profiler, IDeviceContext* pContext, uint32_t Stage) :
+        m_Profiler(Profiler),
+        m_pContext(pContext)
+    {
+        if (m_Profiler.IsActive())
+            m_Scope = m_Profiler.BeginGpuScope(m_pContext, Stage);
+    }
+
+    ~ScopedGpuTimer()
+    {
+        if (m_Scope != FrameProfiler::InvalidGpuScope)
+            m_Profiler.EndGpuScope(m_pContext, m_Scope);
+    }
+
+    ScopedGpuTimer(const ScopedGpuTimer&) = delete;
+    ScopedGpuTimer& operator=(const ScopedGpuTimer&) = delete;
+
+private:
+    FrameProfiler&  m_Profiler;
+    IDeviceContext* m_pContext;
+    uint32_t        m_Scope = FrameProfiler::InvalidGpuScope;
+};
@@ -0,0 +1,245 @@
+#include "GeometryArena.h"
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include "Mesh.h"
+
+void FreeListAllocator::Reset(uint32_t Capacity)
+{
+    m_FreeRanges.clear();
+    if (Capacity > 0)
+        m_FreeRanges.push_back({0, Capacity});
+    m_Capacity = Capacity;
+    m_FreeSize = Capacity;
+}
+
+bool FreeListAllocator::IsPacked() const
+{
+    return m_FreeRanges.empty() || (m_FreeRanges.size() == 1 && m_FreeRanges[0].Offset + m_FreeRanges[0].Size == m_Capacity);
+}
+
+uint32_t FreeListAllocator::Allocate(uint32_t Size)
+{
+    for (auto it = m_FreeRanges.begin(); it != m_FreeRanges.end(); ++it)
+    {
+        if (it->Size < Size)
+            continue;
+
+        const uint32_t offset = it->Offset;
+        it->Offset += Size;
+        it->Size -= Size;
+        if (it->Size == 0)
+            m_FreeRanges.erase(it);
+        m_FreeSize -= Size;
+        return offset;
+    }
+    return InvalidOffset;
+}
+
+void FreeListAllocator::Free(uint32_t Offset, uint32_t Size)
+{
+    auto it = std::lower_bound(m_FreeRanges.begin(), m_FreeRanges.end(), Offset,
+                               [](const Range& range, uint32_t offset) { return range.Offset < offset; });
+    it = m_FreeRanges.insert(it, {Offset, Size});
+    m_FreeSize += Size;
+
+    auto next = it + 1;
+    if (next != m_FreeRanges.end() && it->Offset + it->Size == next->Offset)
+    {
+        it->Size += next->Size;
+        m_FreeRanges.erase(next);
+    }
+    if (it != m_FreeRanges.begin())
+    {
+        auto prev = it - 1;
+        if (prev->Offset + prev->Size == it->Offset)
+        {
+            prev->Size += it->Size;
+            m_FreeRanges.erase(it);
+        }
+    }
+}
+
+GeometryArena::GeometryArena(IRenderDevice* pDevice, const GeometryArenaDesc& Desc) :
+    m_pDevice(pDevice),
+    m_InitialCapacity{std::max(1u, Desc.VertexCapacity), std::max(1u, Desc.IndexCapacity), std::max(1u, Desc.IndexCapacity)}
+{
+    m_Pools[POOL_VERTICES]  = {"Geometry arena VB", sizeof(QuantizedVertex), BIND_VERTEX_BUFFER, RESOURCE_STATE_VERTEX_BUFFER};
+    m_Pools[POOL_INDICES16] = {"Geometry arena IB16", sizeof(uint16_t), BIND_INDEX_BUFFER, RESOURCE_STATE_INDEX_BUFFER};
+    m_Pools[POOL_INDICES32] = {"Geometry arena IB32", sizeof(uint32_t), BIND_INDEX_BUFFER, RESOURCE_STATE_INDEX_BUFFER};
+}
+
+uint32_t* GeometryArena::GetPoolOffset(Range& MeshRange, POOL PoolId)
+{
+    if (MeshRange.NumVertices == 0)
+        return nullptr;
+    if (PoolId == POOL_VERTICES)
+        return &MeshRange.BaseVertex;
+    return GetIndexPool(MeshRange.IndexType) == PoolId ? &MeshRange.FirstIndex : nullptr;
+}
+
+GeometryArena::Handle GeometryArena::Allocate(IDeviceContext* pContext, const void* pVertices, uint32_t NumVertices, const void* pIndices, uint32_t NumIndices, VALUE_TYPE IndexType)
+{
+    if (NumVertices == 0 || NumIndices == 0)
+        throw std::runtime_error("Meshes in the geometry arena need vertices and indices");
+    if (IndexType != VT_UINT16 && IndexType != VT_UINT32)
+        throw std::runtime_error("Meshes in the geometry arena need 16 or 32-bit indices");
+
+    // the range is not registered yet, so repacking one pool cannot move the other half of it
+    Range range;
+    range.NumVertices = NumVertices;
+    range.NumIndices  = NumIndices;
+    range.IndexType   = IndexType;
+    range.BaseVertex  = AllocateInPool(pContext, POOL_VERTICES, NumVertices);
+    try
+    {
+        range.FirstIndex = AllocateInPool(pContext, GetIndexPool(IndexType), NumIndices);
+    }
+    catch (...)
+    {
+        // a full index pool must not leak the vertices
+        m_Pools[POOL_VERTICES].Allocator.Free(range.BaseVertex, NumVertices);
+        throw;
+    }
+
+    const Pool& vertexPool = m_Pools[POOL_VERTICES];
+    const Pool& indexPool  = m_Pools[GetIndexPool(IndexType)];
+    pContext->UpdateBuffer(vertexPool.Buffer, uint64_t{range.BaseVertex} * vertexPool.ElementSize, uint64_t{NumVertices} * vertexPool.ElementSize,
+                           pVertices, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    pContext->UpdateBuffer(indexPool.Buffer, uint64_t{range.FirstIndex} * indexPool.ElementSize, uint64_t{NumIndices} * indexPool.ElementSize,
+                           pIndices, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+
+    // back to the states draws expect; deferred contexts only verify them
+    StateTransitionDesc barriers[] = {
+        {vertexPool.Buffer, RESOURCE_STATE_UNKNOWN, vertexPool.State, STATE_TRANSITION_FLAG_UPDATE_STATE},
+        {indexPool.Buffer, RESOURCE_STATE_UNKNOWN, indexPool.State, STATE_TRANSITION_FLAG_UPDATE_STATE}};
+    pContext->TransitionResourceStates(_countof(barriers), barriers);
+
+    if (!m_FreeHandles.empty())
+    {
+        const Handle mesh = m_FreeHandles.back();
+        m_FreeHandles.pop_back();
+        m_Ranges[mesh] = range;
+        return mesh;
+    }
+    m_Ranges.push_back(range);
+    return static_cast<Handle>(m_Ranges.size() - 1);
+}
+
+void GeometryArena::Free(Handle Mesh)
+{
+    Range& range = m_Ranges[Mesh];
+    m_Pools[POOL_VERTICES].Allocator.Free(range.BaseVertex, range.NumVertices);
+    m_Pools[GetIndexPool(range.IndexType)].Allocator.Free(range.FirstIndex, range.NumIndices);
+
+    range = {};
+    m_FreeHandles.push_back(Mesh);
+}
+
+uint32_t GeometryArena::AllocateInPool(IDeviceContext* pContext, POOL PoolId, uint32_t Size)
+{
+    Pool&    pool   = m_Pools[PoolId];
+    uint32_t offset = pool.Allocator.Allocate(Size);
+    if (offset != FreeListAllocator::InvalidOffset)
+        return offset;
+
+    // packing the live ranges is enough when the free space is only fragmented, otherwise the buffer grows
+    const uint32_t used     = pool.Allocator.GetCapacity() - pool.Allocator.GetFreeSize();
+    uint64_t       capacity = std::max(pool.Allocator.GetCapacity(), m_InitialCapacity[PoolId]);
+    while (capacity - used < Size)
+        capacity *= 2;
+    if (capacity > UINT32_MAX)
+        throw std::runtime_error(std::string(pool.Name) + " is full");
+
+    Repack(pContext, PoolId, static_cast<uint32_t>(capacity));
+    return pool.Allocator.Allocate(Size);
+}
+
+void GeometryArena::Repack(IDeviceContext* pContext, POOL PoolId, uint32_t NewCapacity)
+{
+    Pool& pool = m_Pools[PoolId];
+
+    BufferDesc desc;
+    desc.Name      = pool.Name;
+    desc.Size      = uint64_t{NewCapacity} * pool.ElementSize;
+    desc.Usage     = USAGE_DEFAULT;
+    desc.BindFlags = pool.BindFlags;
+
+    RefCntAutoPtr<IBuffer> pBuffer;
+    m_pDevice->CreateBuffer(desc, nullptr, &pBuffer);
+    if (!pBuffer)
+        throw std::runtime_error(std::string("Failed to create ") + pool.Name);
+
+    std::vector<std::pair<uint32_t, Handle>> live;
+    for (Handle mesh = 0; mesh < m_Ranges.size(); ++mesh)
+    {
+        if (const uint32_t* pOffset = GetPoolOffset(m_Ranges[mesh], PoolId))
+            live.emplace_back(*pOffset, mesh);
+    }
+    std::sort(live.begin(), live.end());
+
+    // ranges that are already adjacent are copied together, a fresh arena is copied in one go
+    uint32_t packedSize = 0;
+    uint32_t copySrc    = 0;
+    uint32_t copyDst    = 0;
+    uint32_t copySize   = 0;
+    auto     FlushCopy  = [&]() {
+        if (copySize > 0)
+        {
+            pContext->CopyBuffer(pool.Buffer, uint64_t{copySrc} * pool.ElementSize, RESOURCE_STATE_TRANSITION_MODE_TRANSITION,
+                                 pBuffer, uint64_t{copyDst} * pool.ElementSize, uint64_t{copySize} * pool.ElementSize, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        }
+    };
+    for (const auto& entry : live)
+    {
+        Range&         range  = m_Ranges[entry.second];
+        uint32_t&      offset = *GetPoolOffset(range, PoolId);
+        const uint32_t size   = PoolId == POOL_VERTICES ? range.NumVertices : range.NumIndices;
+        if (copySize == 0 || copySrc + copySize != offset)
+        {
+            FlushCopy();
+            copySrc  = offset;
+            copyDst  = packedSize;
+            copySize = 0;
+        }
+        copySize += size;
+        offset = packedSize;
+        packedSize += size;
+    }
+    FlushCopy();
+
+    pool.Allocator.Reset(NewCapacity);
+    pool.Allocator.Allocate(packedSize);
+
+    StateTransitionDesc barrier{pBuffer, RESOURCE_STATE_UNKNOWN, pool.State, STATE_TRANSITION_FLAG_UPDATE_STATE};
+    pContext->TransitionResourceStates(1, &barrier);
+
+    // the old buffer is released once the GPU is done with the copies
+    pool.Buffer = pBuffer;
+    ++m_NumRepacks;
+}
+
+void GeometryArena::Defragment(IDeviceContext* pContext)
+{
+    for (uint32_t poolId = 0; poolId < POOL_COUNT; ++poolId)
+    {
+        const FreeListAllocator& allocator = m_Pools[poolId].Allocator;
+        if (!allocator.IsPacked())
+            Repack(pContext, static_cast<POOL>(poolId), allocator.GetCapacity());
+    }
+}
+
+GeometryArena::Stats GeometryArena::GetStats() const
+{
+    Stats stats;
+    for (const Pool& pool : m_Pools)
+    {
+        stats.CapacityBytes += uint64_t{pool.Allocator.GetCapacity()} * pool.ElementSize;
+        stats.UsedBytes += uint64_t{pool.Allocator.GetCapacity() - pool.Allocator.GetFreeSize()} * pool.ElementSize;
+        stats.NumFreeRanges += pool.Allocator.GetNumFreeRanges();
+    }
+    stats.NumAllocations = static_cast<uint32_t>(m_Ranges.size() - m_FreeHandles.size());
+    stats.NumRepacks     = m_NumRepacks;
+    return stats;
+}
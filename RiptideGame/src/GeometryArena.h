@@ -0,0 +1,143 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "RenderDevice.h"
+#include "DeviceContext.h"
+#include "RefCntAutoPtr.hpp"
+
+using namespace Diligent;
+
+struct GeometryArenaDesc
+{
+    // initial buffer sizes in elements, the index size applies to 16 and 32-bit indices each;
+    // a buffer that cannot fit an allocation is repacked, and grown when that is not enough
+    uint32_t VertexCapacity = 1u << 20;
+    uint32_t IndexCapacity  = 4u << 20;
+};
+
+// Sub-allocates element ranges from a fixed capacity. Free ranges are kept ordered by offset and
+// merged with their neighbours, allocation takes the first range that fits.
+class FreeListAllocator
+{
+public:
+    static constexpr uint32_t InvalidOffset = ~0u;
+
+    // everything becomes one free range
+    void Reset(uint32_t Capacity);
+
+    // InvalidOffset if no single free range is large enough
+    uint32_t Allocate(uint32_t Size);
+
+    void Free(uint32_t Offset, uint32_t Size);
+
+    uint32_t GetCapacity() const { return m_Capacity; }
+    uint32_t GetFreeSize() const { return m_FreeSize; }
+    uint32_t GetNumFreeRanges() const { return static_cast<uint32_t>(m_FreeRanges.size()); }
+
+    // all free space is one range at the end
+    bool IsPacked() const;
+
+private:
+    struct Range
+    {
+        uint32_t Offset;
+        uint32_t Size;
+    };
+
+    std::vector<Range> m_FreeRanges;
+    uint32_t           m_Capacity = 0;
+    uint32_t           m_FreeSize = 0;
+};
+
+// One vertex buffer and one index buffer per index size shared by all meshes, so drawing
+// different meshes never rebinds buffers and their draws can go into one indirect multi-draw.
+// Indices are relative to the mesh's first vertex and drawn with BaseVertex, so moving a mesh
+// only moves its data. Render thread only, the buffers may be replaced by Allocate() and Defragment().
+class GeometryArena
+{
+public:
+    using Handle = uint32_t;
+
+    static constexpr Handle InvalidHandle = ~0u;
+
+    // where a mesh's data currently is, in elements of the arena's buffers
+    struct Range
+    {
+        uint32_t   BaseVertex  = 0;
+        uint32_t   NumVertices = 0;
+        uint32_t   FirstIndex  = 0;
+        uint32_t   NumIndices  = 0;
+        VALUE_TYPE IndexType   = VT_UINT32;
+    };
+
+    struct Stats
+    {
+        uint64_t CapacityBytes  = 0;
+        uint64_t UsedBytes      = 0;
+        uint32_t NumAllocations = 0;
+        uint32_t NumFreeRanges  = 0;
+        uint32_t NumRepacks     = 0;
+    };
+
+    GeometryArena(IRenderDevice* pDevice, const GeometryArenaDesc& Desc);
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // copies the data into the arena through the context's upload memory; IndexType is VT_UINT16 or VT_UINT32
+    Handle Allocate(IDeviceContext* pContext, const void* pVertices, uint32_t NumVertices, const void* pIndices, uint32_t NumIndices, VALUE_TYPE IndexType);
+
+    void Free(Handle Mesh);
+
+    // changes when the arena is repacked, so it is looked up when drawing
+    const Range& GetRange(Handle Mesh) const { return m_Ranges[Mesh]; }
+
+    IBuffer* GetVertexBuffer() const { return m_Pools[POOL_VERTICES].Buffer; }
+    IBuffer* GetIndexBuffer(VALUE_TYPE IndexType) const { return m_Pools[GetIndexPool(IndexType)].Buffer; }
+
+    // moves the live ranges to the start of their buffers, leaving a single free range in each
+    void Defragment(IDeviceContext* pContext);
+
+    Stats GetStats() const;
+
+private:
+    enum POOL : uint32_t
+    {
+        POOL_VERTICES = 0,
+        POOL_INDICES16,
+        POOL_INDICES32,
+        POOL_COUNT
+    };
+
+    struct Pool
+    {
+        const char*    Name;
+        uint32_t       ElementSize;
+        BIND_FLAGS     BindFlags;
+        RESOURCE_STATE State;
+
+        RefCntAutoPtr<IBuffer> Buffer;
+        FreeListAllocator      Allocator;
+    };
+
+    static POOL GetIndexPool(VALUE_TYPE IndexType) { return IndexType == VT_UINT16 ? POOL_INDICES16 : POOL_INDICES32; }
+
+    // the element offset of the range in the pool, nullptr if the range does not use the pool
+    static uint32_t* GetPoolOffset(Range& MeshRange, POOL PoolId);
+
+    uint32_t AllocateInPool(IDeviceContext* pContext, POOL PoolId, uint32_t Size);
+
+    // copies the live ranges of the pool, packed, into a new buffer of NewCapacity elements
+    void Repack(IDeviceContext* pContext, POOL PoolId, uint32_t NewCapacity);
+
+    IRenderDevice* m_pDevice;
+    const uint32_t m_InitialCapacity[POOL_COUNT];
+
+    Pool m_Pools[POOL_COUNT];
+
+    // indexed by handle, freed handles have no vertices and are reused
+    std::vector<Range>  m_Ranges;
+    std::vector<Handle> m_FreeHandles;
+    uint32_t            m_NumRepacks = 0;
+};
@@ -0,0 +1,473 @@
+#include "GpuCuller.h"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include "MapHelper.hpp"
+
+static_assert(sizeof(GpuCuller::Object) == 176, "GpuCuller::Object must match CullObject in the shader");
+static_assert(sizeof(InstanceData) == 160, "the write pass stores InstanceData with a stride of 160 bytes");
+
+static const char* CullCSSource = R"(
+struct CullObject
+{
+    float4 World[4];
+    float4 Normal[4];
+    float4 Color;
+    float4 Sphere;
+    uint   MeshId;
+    uint   PoseIndex;
+    uint   Flags;
+    uint   Padding;
+};
+
+cbuffer CullConstants
+{
+    float4 Planes[12];
+    float4 ViewPosition;
+    float  PixelsPerUnit;
+    float  MaxPixelError;
+    float  CoarsenError;
+    uint   LodsEnabled;
+    uint   NumObjects;
+    uint   NumDraws;
+    uint   NumViews;
+    uint   Replication;
+};
+
+StructuredBuffer<CullObject> g_Objects;
+StructuredBuffer<uint4>      g_Meshes;      // first batch, number of levels, bounding radius
+StructuredBuffer<uint2>      g_Batches;     // draw record, level error
+RWByteAddressBuffer          g_DrawArgs;    // NumIndices, NumInstances, FirstIndex, BaseVertex, FirstInstance
+RWStructuredBuffer<uint2>    g_ObjectSlots; // draw record and instance within it
+RWStructuredBuffer<uint>     g_ObjectLods;  // kept between frames for the hysteresis
+RWByteAddressBuffer          g_Instances;
+RWByteAddressBuffer          g_Stats;
+
+#define INVALID_SLOT     0xFFFFFFFF
+#define ALWAYS_VISIBLE   1
+#define DRAW_ARGS_STRIDE 20
+#define INSTANCE_STRIDE  160
+
+groupshared uint gs_NumVisible;
+
+bool IsInFrustum(float4 sphere, uint firstPlane)
+{
+    for (uint i = 0; i < 6; ++i)
+    {
+        float4 plane = Planes[firstPlane + i];
+        if (dot(plane.xyz, sphere.xyz) + plane.w < -sphere.w)
+            return false;
+    }
+    return true;
+}
+
+// same selection as Scene::SelectLods()
+uint SelectLod(uint objIdx, CullObject obj, uint4 mesh)
+{
+    float distance   = length(obj.Sphere.xyz - ViewPosition.xyz) - obj.Sphere.w;
+    float meshRadius = asfloat(mesh.z);
+    float errorScale = (meshRadius > 0.0 && distance > 0.0) ? PixelsPerUnit * obj.Sphere.w / (meshRadius * distance) : 3.402823466e+38;
+
+    // the buffer is not initialized when it grows, so the previous level is clamped
+    uint lod = LodsEnabled != 0 ? min(g_ObjectLods[objIdx], mesh.y - 1) : 0;
+    while (lod > 0 && asfloat(g_Batches[mesh.x + lod].y) * errorScale > MaxPixelError)
+        --lod;
+    while (LodsEnabled != 0 && lod + 1 < mesh.y && asfloat(g_Batches[mesh.x + lod + 1].y) * errorScale <= CoarsenError)
+        ++lod;
+    g_ObjectLods[objIdx] = lod;
+    return lod;
+}
+
+bool CullObjectAt(uint objIdx)
+{
+    g_ObjectSlots[objIdx] = uint2(INVALID_SLOT, 0);
+
+    CullObject obj  = g_Objects[objIdx];
+    uint4      mesh = g_Meshes[obj.MeshId];
+    if (mesh.y == 0)
+        return false;
+
+    // visible if it intersects either eye's frustum
+    if ((obj.Flags & ALWAYS_VISIBLE) == 0 && !IsInFrustum(obj.Sphere, 0) && !IsInFrustum(obj.Sphere, 6))
+        return false;
+
+    // objects that are not tested have no bounding sphere to select a level with
+    uint lod     = (obj.Flags & ALWAYS_VISIBLE) != 0 ? 0 : SelectLod(objIdx, obj, mesh);
+    uint drawIdx = g_Batches[mesh.x + lod].x;
+    uint slot;
+    g_DrawArgs.InterlockedAdd(drawIdx * DRAW_ARGS_STRIDE + 4, 1, slot);
+    g_ObjectSlots[objIdx] = uint2(drawIdx, slot);
+    return true;
+}
+
+[numthreads(64, 1, 1)]
+void CullObjects(uint3 id : SV_DispatchThreadID, uint groupIdx : SV_GroupIndex)
+{
+    if (groupIdx == 0)
+        gs_NumVisible = 0;
+    GroupMemoryBarrierWithGroupSync();
+
+    if (id.x < NumObjects && CullObjectAt(id.x))
+        InterlockedAdd(gs_NumVisible, 1);
+    GroupMemoryBarrierWithGroupSync();
+
+    // one global atomic per group instead of one per visible object
+    if (groupIdx == 0 && gs_NumVisible > 0)
+        g_Stats.InterlockedAdd(0, gs_NumVisible);
+}
+
+// serial, but over the draw records, which are few next to the objects
+[numthreads(1, 1, 1)]
+void PlaceInstances()
+{
+    uint first = 0;
+    for (uint drawIdx = 0; drawIdx < NumDraws; ++drawIdx)
+    {
+        uint offset = drawIdx * DRAW_ARGS_STRIDE;
+        uint count  = g_DrawArgs.Load(offset + 4);
+
+        // at a multiple of NumViews, like InstanceBuffer::Upload()
+        first = (first + NumViews - 1) / NumViews * NumViews;
+        g_DrawArgs.Store(offset + 4, count * NumViews);
+        g_DrawArgs.Store(offset + 16, first);
+        first += count * Replication;
+    }
+}
+
+[numthreads(64, 1, 1)]
+void WriteInstances(uint3 id : SV_DispatchThreadID)
+{
+    if (id.x >= NumObjects)
+        return;
+
+    uint2 slot = g_ObjectSlots[id.x];
+    if (slot.x == INVALID_SLOT)
+        return;
+
+    CullObject obj   = g_Objects[id.x];
+    uint       first = g_DrawArgs.Load(slot.x * DRAW_ARGS_STRIDE + 16);
+    for (uint copy = 0; copy < Replication; ++copy)
+    {
+        uint address = (first + slot.y * Replication + copy) * INSTANCE_STRIDE;
+        for (uint row = 0; row < 4; ++row)
+        {
+            g_Instances.Store4(address + row * 16, asuint(obj.World[row]));
+            g_Instances.Store4(address + 64 + row * 16, asuint(obj.Normal[row]));
+        }
+        g_Instances.Store4(address + 128, asuint(obj.Color));
+        g_Instances.Store4(address + 144, uint4(obj.PoseIndex, 0, 0, 0));
+    }
+}
+)";
+
+static uint32_t AsUint(float Value)
+{
+    uint32_t bits;
+    memcpy(&bits, &Value, sizeof(bits));
+    return bits;
+}
+
+bool GpuCuller::IsSupported(IRenderDevice* pDevice)
+{
+    const DeviceFeatures& features = pDevice->GetDeviceInfo().Features;
+    return features.ComputeShaders != DEVICE_FEATURE_STATE_DISABLED && features.IndirectRendering != DEVICE_FEATURE_STATE_DISABLED;
+}
+
+GpuCuller::GpuCuller(IRenderDevice* pDevice, uint32_t NumViews, bool UseStepRate) :
+    m_pDevice(pDevice),
+    m_NumViews(NumViews),
+    m_Replication(UseStepRate ? 1 : NumViews)
+{
+    BufferDesc CBDesc;
+    CBDesc.Name      = "GPU cull constants CB";
+    CBDesc.Size      = sizeof(CullConstants);
+    CBDesc.Usage     = USAGE_DEFAULT;
+    CBDesc.BindFlags = BIND_UNIFORM_BUFFER;
+    pDevice->CreateBuffer(CBDesc, nullptr, &m_Constants);
+
+    BufferDesc StatsDesc;
+    StatsDesc.Name              = "GPU cull stats";
+    StatsDesc.Size              = 16;
+    StatsDesc.Usage             = USAGE_DEFAULT;
+    StatsDesc.BindFlags         = BIND_UNORDERED_ACCESS;
+    StatsDesc.Mode              = BUFFER_MODE_RAW;
+    StatsDesc.ElementByteStride = 4;
+    pDevice->CreateBuffer(StatsDesc, nullptr, &m_Stats);
+
+    // read a few frames later, once the fence shows the GPU is done with them
+    BufferDesc ReadbackDesc;
+    ReadbackDesc.Name           = "GPU cull stats readback";
+    ReadbackDesc.Size           = 16;
+    ReadbackDesc.Usage          = USAGE_STAGING;
+    ReadbackDesc.CPUAccessFlags = CPU_ACCESS_READ;
+    for (RefCntAutoPtr<IBuffer>& pReadback : m_StatsReadback)
+        pDevice->CreateBuffer(ReadbackDesc, nullptr, &pReadback);
+
+    FenceDesc fenceDesc;
+    fenceDesc.Name = "GPU cull readback fence";
+    pDevice->CreateFence(fenceDesc, &m_Fence);
+
+    if (!m_Constants || !m_Stats || !m_Fence)
+        throw std::runtime_error("Failed to create GPU culling resources");
+}
+
+void GpuCuller::CreatePipelines(PipelineCache& Cache)
+{
+    const char* entryPoints[PASS_COUNT] = {"CullObjects", "PlaceInstances", "WriteInstances"};
+    for (uint32_t pass = 0; pass < PASS_COUNT; ++pass)
+    {
+        ShaderCreateInfo ShaderCI;
+        ShaderCI.SourceLanguage  = SHADER_SOURCE_LANGUAGE_HLSL;
+        ShaderCI.Desc.ShaderType = SHADER_TYPE_COMPUTE;
+        ShaderCI.Desc.Name       = entryPoints[pass];
+        ShaderCI.EntryPoint      = entryPoints[pass];
+        ShaderCI.Source          = CullCSSource;
+
+        RefCntAutoPtr<IShader> pCS;
+        Cache.CreateShader(ShaderCI, &pCS);
+
+        // the buffers are rebound whenever they grow
+        ComputePipelineStateCreateInfo PSOCreateInfo;
+        PSOCreateInfo.PSODesc.Name         = entryPoints[pass];
+        PSOCreateInfo.PSODesc.PipelineType = PIPELINE_TYPE_COMPUTE;
+        PSOCreateInfo.pCS                  = pCS;
+
+        ShaderResourceVariableDesc Variables[] = {
+            {SHADER_TYPE_COMPUTE, "CullConstants", SHADER_RESOURCE_VARIABLE_TYPE_STATIC}};
+        PSOCreateInfo.PSODesc.ResourceLayout.DefaultVariableType = SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE;
+        PSOCreateInfo.PSODesc.ResourceLayout.Variables           = Variables;
+        PSOCreateInfo.PSODesc.ResourceLayout.NumVariables        = _countof(Variables);
+
+        Cache.CreateComputePipelineState(PSOCreateInfo, &m_PSOs[pass]);
+        if (m_PSOs[pass] == nullptr)
+            throw std::runtime_error("Failed to create GPU culling pipeline state");
+
+        m_PSOs[pass]->GetStaticVariableByName(SHADER_TYPE_COMPUTE, "CullConstants")->Set(m_Constants);
+        m_PSOs[pass]->CreateShaderResourceBinding(&m_SRBs[pass], true);
+    }
+}
+
+bool GpuCuller::ReserveBuffer(IDeviceContext* pContext, RefCntAutoPtr<IBuffer>& pBuffer, const char* Name, uint64_t Size,
+                              BIND_FLAGS BindFlags, BUFFER_MODE Mode, uint32_t ElementStride, bool KeepContents)
+{
+    const uint64_t capacity = pBuffer ? pBuffer->GetDesc().Size : 0;
+    if (Size <= capacity)
+        return false;
+
+    // grow geometrically so a growing scene does not recreate the buffers every frame
+    uint64_t newCapacity = std::max<uint64_t>(capacity, uint64_t{64} * ElementStride);
+    while (newCapacity < Size)
+        newCapacity *= 2;
+
+    BufferDesc desc;
+    desc.Name              = Name;
+    desc.Size              = newCapacity;
+    desc.Usage             = USAGE_DEFAULT;
+    desc.BindFlags         = BindFlags;
+    desc.Mode              = Mode;
+    desc.ElementByteStride = ElementStride;
+
+    RefCntAutoPtr<IBuffer> pNewBuffer;
+    m_pDevice->CreateBuffer(desc, nullptr, &pNewBuffer);
+    if (!pNewBuffer)
+        throw std::runtime_error(std::string("Failed to create ") + Name);
+
+    if (KeepContents && capacity > 0)
+        pContext->CopyBuffer(pBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION, pNewBuffer, 0, capacity, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+
+    pBuffer         = pNewBuffer;
+    m_BindingsDirty = true;
+    return true;
+}
+
+void GpuCuller::SetObjects(IDeviceContext* pContext, const Object* pObjects, uint32_t FirstObject, uint32_t NumObjects)
+{
+    if (NumObjects == 0)
+        return;
+
+    ReserveBuffer(pContext, m_Objects, "GPU cull objects", (uint64_t{FirstObject} + NumObjects) * sizeof(Object),
+                  BIND_SHADER_RESOURCE, BUFFER_MODE_STRUCTURED, sizeof(Object), true);
+    pContext->UpdateBuffer(m_Objects, uint64_t{FirstObject} * sizeof(Object), uint64_t{NumObjects} * sizeof(Object), pObjects,
+                           RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+}
+
+void GpuCuller::BindResources()
+{
+    struct Binding
+    {
+        const char*      Name;
+        IBuffer*         pBuffer;
+        BUFFER_VIEW_TYPE ViewType;
+    };
+    const Binding bindings[] = {
+        {"g_Objects", m_Objects, BUFFER_VIEW_SHADER_RESOURCE},
+        {"g_Meshes", m_MeshTable, BUFFER_VIEW_SHADER_RESOURCE},
+        {"g_Batches", m_BatchTable, BUFFER_VIEW_SHADER_RESOURCE},
+        {"g_DrawArgs", m_DrawArgs, BUFFER_VIEW_UNORDERED_ACCESS},
+        {"g_ObjectSlots", m_ObjectSlots, BUFFER_VIEW_UNORDERED_ACCESS},
+        {"g_ObjectLods", m_ObjectLods, BUFFER_VIEW_UNORDERED_ACCESS},
+        {"g_Instances", m_Instances, BUFFER_VIEW_UNORDERED_ACCESS},
+        {"g_Stats", m_Stats, BUFFER_VIEW_UNORDERED_ACCESS}};
+
+    // each pass only has the variables its entry point uses
+    for (RefCntAutoPtr<IShaderResourceBinding>& pSRB : m_SRBs)
+    {
+        for (const Binding& binding : bindings)
+        {
+            if (IShaderResourceVariable* pVar = pSRB->GetVariableByName(SHADER_TYPE_COMPUTE, binding.Name))
+                pVar->Set(binding.pBuffer->GetDefaultView(binding.ViewType), SET_SHADER_RESOURCE_FLAG_ALLOW_OVERWRITE);
+        }
+    }
+    m_BindingsDirty = false;
+}
+
+void GpuCuller::Cull(IDeviceContext* pContext, const GeometryArena& Geometry, const std::vector<GpuMesh>& Meshes, uint32_t NumObjects, const View& CullView)
+{
+    ReadStats(pContext);
+
+    // every loaded mesh level becomes a draw record; 16-bit index draws come first, so each index size is one multi-draw
+    uint32_t numDraws = 0;
+    m_NumDraws16      = 0;
+    for (const GpuMesh& mesh : Meshes)
+    {
+        if (mesh.Geometry == GeometryArena::InvalidHandle)
+            continue;
+        const uint32_t numLods = static_cast<uint32_t>(mesh.Lods.size());
+        numDraws += numLods;
+        if (Geometry.GetRange(mesh.Geometry).IndexType == VT_UINT16)
+            m_NumDraws16 += numLods;
+    }
+
+    m_MeshData.clear();
+    m_BatchData.clear();
+    m_DrawArgsData.resize(numDraws);
+    uint32_t nextDraw[2] = {0, m_NumDraws16};
+    for (const GpuMesh& mesh : Meshes)
+    {
+        // unloaded meshes have no levels, their objects are never visible
+        const bool  loaded = mesh.Geometry != GeometryArena::InvalidHandle;
+        const float radius = length(mesh.Bounds.Max - mesh.Bounds.Min) * 0.5f;
+        m_MeshData.push_back(uint4(static_cast<uint32_t>(m_BatchData.size()), loaded ? static_cast<uint32_t>(mesh.Lods.size()) : 0, AsUint(radius), 0));
+        for (const MeshLod& lod : mesh.Lods)
+        {
+            uint32_t drawIdx = ~0u;
+            if (loaded)
+            {
+                const GeometryArena::Range& range = Geometry.GetRange(mesh.Geometry);
+                drawIdx                           = nextDraw[range.IndexType == VT_UINT16 ? 0 : 1]++;
+                m_DrawArgsData[drawIdx]           = {lod.NumIndices, 0, range.FirstIndex + lod.FirstIndex, static_cast<Int32>(range.BaseVertex), 0};
+            }
+            m_BatchData.push_back(uint2(drawIdx, AsUint(lod.Error)));
+        }
+    }
+
+    // batches start at a multiple of the view count, which leaves up to NumViews - 1 unused instances before each
+    const uint64_t numInstances = uint64_t{NumObjects} * m_Replication + uint64_t{numDraws} * m_NumViews;
+    ReserveBuffer(pContext, m_Objects, "GPU cull objects", std::max(NumObjects, 1u) * sizeof(Object),
+                  BIND_SHADER_RESOURCE, BUFFER_MODE_STRUCTURED, sizeof(Object), true);
+    ReserveBuffer(pContext, m_MeshTable, "GPU cull meshes", m_MeshData.size() * sizeof(uint4), BIND_SHADER_RESOURCE, BUFFER_MODE_STRUCTURED, sizeof(uint4));
+    ReserveBuffer(pContext, m_BatchTable, "GPU cull batches", m_BatchData.size() * sizeof(uint2), BIND_SHADER_RESOURCE, BUFFER_MODE_STRUCTURED, sizeof(uint2));
+    ReserveBuffer(pContext, m_ObjectSlots, "GPU cull object slots", std::max(NumObjects, 1u) * sizeof(uint2), BIND_UNORDERED_ACCESS, BUFFER_MODE_STRUCTURED, sizeof(uint2));
+    ReserveBuffer(pContext, m_ObjectLods, "GPU cull object levels", std::max(NumObjects, 1u) * sizeof(uint32_t), BIND_UNORDERED_ACCESS, BUFFER_MODE_STRUCTURED, sizeof(uint32_t));
+    ReserveBuffer(pContext, m_Instances, "GPU cull instances", numInstances * sizeof(InstanceData), BIND_VERTEX_BUFFER | BIND_UNORDERED_ACCESS, BUFFER_MODE_RAW, 4);
+    ReserveBuffer(pContext, m_DrawArgs, "GPU cull draw args", uint64_t{numDraws} * sizeof(IndirectDrawArgs), BIND_INDIRECT_DRAW_ARGS | BIND_UNORDERED_ACCESS, BUFFER_MODE_RAW, 4);
+    if (m_BindingsDirty)
+        BindResources();
+
+    CullConstants constants = {};
+    for (uint32_t eye = 0; eye < 2; ++eye)
+    {
+        // the extracted planes point inwards but are not normalized
+        ViewFrustum frustum;
+        ExtractViewFrustumPlanesFromMatrix(CullView.ViewProj[eye], frustum, false);
+        for (uint32_t i = 0; i < ViewFrustum::NUM_PLANES; ++i)
+        {
+            const Plane3D& plane              = frustum.GetPlane(static_cast<ViewFrustum::PLANE_IDX>(i));
+            const float    invLen             = 1.0f / length(plane.Normal);
+            constants.Planes[eye * ViewFrustum::NUM_PLANES + i] = float4(plane.Normal * invLen, plane.Distance * invLen);
+        }
+    }
+    constants.ViewPosition  = float4(CullView.Position, 1.0f);
+    constants.PixelsPerUnit = CullView.PixelsPerUnit;
+    constants.MaxPixelError = CullView.Lods.MaxPixelError;
+    constants.CoarsenError  = CullView.Lods.MaxPixelError * (1.0f - CullView.Lods.Hysteresis);
+    constants.LodsEnabled   = CullView.Lods.Enabled ? 1 : 0;
+    constants.NumObjects    = NumObjects;
+    constants.NumDraws      = numDraws;
+    constants.NumViews      = m_NumViews;
+    constants.Replication   = m_Replication;
+
+    const uint32_t zero = 0;
+    pContext->UpdateBuffer(m_Constants, 0, sizeof(constants), &constants, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    pContext->UpdateBuffer(m_MeshTable, 0, m_MeshData.size() * sizeof(uint4), m_MeshData.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    pContext->UpdateBuffer(m_BatchTable, 0, m_BatchData.size() * sizeof(uint2), m_BatchData.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    pContext->UpdateBuffer(m_DrawArgs, 0, m_DrawArgsData.size() * sizeof(IndirectDrawArgs), m_DrawArgsData.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    pContext->UpdateBuffer(m_Stats, 0, sizeof(zero), &zero, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+
+    // the group count is the only part of the submission that depends on the number of objects
+    const uint32_t numGroups = (NumObjects + 63) / 64;
+    auto           Dispatch  = [&](PASS pass, uint32_t groups) {
+        pContext->SetPipelineState(m_PSOs[pass]);
+        pContext->CommitShaderResources(m_SRBs[pass], RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        pContext->DispatchCompute(DispatchComputeAttribs{groups});
+    };
+
+    // transitions from and to the unordered access state are UAV barriers
+    auto UavBarrier = [&](IBuffer* pBuffer) {
+        StateTransitionDesc barrier{pBuffer, RESOURCE_STATE_UNORDERED_ACCESS, RESOURCE_STATE_UNORDERED_ACCESS, STATE_TRANSITION_FLAG_UPDATE_STATE};
+        pContext->TransitionResourceStates(1, &barrier);
+    };
+
+    if (numGroups > 0)
+        Dispatch(PASS_CULL, numGroups);
+    UavBarrier(m_DrawArgs);
+    UavBarrier(m_ObjectSlots);
+    Dispatch(PASS_PLACE, 1);
+    UavBarrier(m_DrawArgs);
+    if (numGroups > 0)
+        Dispatch(PASS_WRITE, numGroups);
+
+    // the draws only verify the states
+    StateTransitionDesc barriers[] = {
+        {m_DrawArgs, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_INDIRECT_ARGUMENT, STATE_TRANSITION_FLAG_UPDATE_STATE},
+        {m_Instances, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_VERTEX_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE}};
+    pContext->TransitionResourceStates(_countof(barriers), barriers);
+
+    // a readback buffer is only reused once the GPU has finished the frame that last wrote it
+    const uint64_t frame = ++m_FrameIndex;
+    const uint32_t slot  = frame % NumReadbacks;
+    if (m_ReadbackFrame[slot] <= m_Fence->GetCompletedValue())
+    {
+        pContext->CopyBuffer(m_Stats, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION, m_StatsReadback[slot], 0, sizeof(uint32_t), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        m_ReadbackFrame[slot] = frame;
+    }
+    pContext->EnqueueSignal(m_Fence, frame);
+}
+
+void GpuCuller::ReadStats(IDeviceContext* pContext)
+{
+    const uint64_t completed = m_Fence->GetCompletedValue();
+
+    uint32_t newest = NumReadbacks;
+    for (uint32_t slot = 0; slot < NumReadbacks; ++slot)
+    {
+        const uint64_t frame = m_ReadbackFrame[slot];
+        if (frame > m_LastReadFrame && frame <= completed && (newest == NumReadbacks || frame > m_ReadbackFrame[newest]))
+            newest = slot;
+    }
+    if (newest == NumReadbacks)
+        return;
+
+    MapHelper<uint32_t> stats(pContext, m_StatsReadback[newest], MAP_READ, MAP_FLAG_DO_NOT_WAIT);
+    if (stats)
+    {
+        m_NumVisible    = *stats;
+        m_LastReadFrame = m_ReadbackFrame[newest];
+    }
+}
+
+void GpuCuller::Draw(CommandEncoder& Encoder, const GeometryArena& Geometry) const
+{
+    InstanceBuffer::DrawIndirect(Encoder, Geometry, m_Instances, m_DrawArgs, m_NumDraws16, static_cast<uint32_t>(m_DrawArgsData.size()) - m_NumDraws16);
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "RenderDevice.h"
+#include "DeviceContext.h"
+#include "RefCntAutoPtr.hpp"
+#include "BasicMath.hpp"
+#include "CommandEncoder.h"
+#include "GeometryArena.h"
+#include "InstanceBatch.h"
+#include "Mesh.h"
+#include "PipelineCache.h"
+#include "Scene.h"
+
+using namespace Diligent;
+
+// Culling, level of detail selection and instance data on the GPU, for the instanced pipeline.
+// Objects live in a GPU buffer that is only written when they change. Every frame three compute
+// passes test them against both eyes' frusta, pick their levels like Scene::SelectLods() and count
+// the survivors per mesh level, place the levels' instances, and write the instance data and the
+// indirect draw records the instanced pipeline draws from. The CPU cost per frame depends on the
+// number of meshes, not on the number of objects.
+class GpuCuller
+{
+public:
+    // in the layout of the shader's CullObject
+    struct Object
+    {
+        float4x4 World; // includes the mesh's dequantization
+        float4x4 NormalTransform;
+        float4   Color;
+        float4   Sphere; // world space center in xyz, radius in w; unused for always visible objects
+        uint32_t MeshId    = 0;
+        uint32_t PoseIndex = 0;
+        uint32_t Flags     = 0;
+        uint32_t Padding   = 0;
+    };
+
+    // drawn at full detail without testing, e.g. devices placed by the pose buffer
+    static constexpr uint32_t ObjectFlagAlwaysVisible = 1;
+
+    struct View
+    {
+        float4x4    ViewProj[2];
+        float3      Position; // for the level of detail errors
+        float       PixelsPerUnit = 0;
+        MeshLodDesc Lods;
+    };
+
+    // compute shaders and indirect draws
+    static bool IsSupported(IRenderDevice* pDevice);
+
+    GpuCuller(IRenderDevice* pDevice, uint32_t NumViews, bool UseStepRate);
+
+    // may run on any thread before the first Cull()
+    void CreatePipelines(PipelineCache& Cache);
+
+    // writes objects [FirstObject, FirstObject + NumObjects), the ones before are kept when the buffer grows
+    void SetObjects(IDeviceContext* pContext, const Object* pObjects, uint32_t FirstObject, uint32_t NumObjects);
+
+    // culls objects [0, NumObjects) on the immediate context; Meshes are indexed by the objects' mesh
+    // IDs, and their levels must match the batches of the renderer. Changes the pipeline state
+    void Cull(IDeviceContext* pContext, const GeometryArena& Geometry, const std::vector<GpuMesh>& Meshes, uint32_t NumObjects, const View& CullView);
+
+    // the instanced PSO and SRB must already be bound
+    void Draw(CommandEncoder& Encoder, const GeometryArena& Geometry) const;
+
+    // of the newest frame whose result reached the CPU, usually two or three frames back
+    uint32_t GetNumVisible() const { return m_NumVisible; }
+
+private:
+    struct CullConstants
+    {
+        float4   Planes[12]; // inward facing and normalized, six per eye
+        float4   ViewPosition;
+        float    PixelsPerUnit;
+        float    MaxPixelError;
+        float    CoarsenError; // below which a coarser level is picked
+        uint32_t LodsEnabled;
+        uint32_t NumObjects;
+        uint32_t NumDraws;
+        uint32_t NumViews;
+        uint32_t Replication;
+    };
+
+    enum PASS : uint32_t
+    {
+        PASS_CULL = 0,
+        PASS_PLACE,
+        PASS_WRITE,
+        PASS_COUNT
+    };
+
+    static constexpr uint32_t NumReadbacks = 3;
+
+    // recreates the buffer when it is smaller than Size, keeping its contents if KeepContents is set;
+    // returns true if it was recreated
+    bool ReserveBuffer(IDeviceContext* pContext, RefCntAutoPtr<IBuffer>& pBuffer, const char* Name, uint64_t Size,
+                       BIND_FLAGS BindFlags, BUFFER_MODE Mode, uint32_t ElementStride, bool KeepContents = false);
+
+    void BindResources();
+
+    // reads the visible count of the newest frame the GPU has completed
+    void ReadStats(IDeviceContext* pContext);
+
+    IRenderDevice* m_pDevice;
+    const uint32_t m_NumViews;
+    const uint32_t m_Replication;
+
+    RefCntAutoPtr<IPipelineState>         m_PSOs[PASS_COUNT];
+    RefCntAutoPtr<IShaderResourceBinding> m_SRBs[PASS_COUNT];
+    bool                                  m_BindingsDirty = true;
+
+    RefCntAutoPtr<IBuffer> m_Constants;
+    RefCntAutoPtr<IBuffer> m_Objects;
+    RefCntAutoPtr<IBuffer> m_MeshTable;
+    RefCntAutoPtr<IBuffer> m_BatchTable;
+    RefCntAutoPtr<IBuffer> m_ObjectSlots;
+    RefCntAutoPtr<IBuffer> m_ObjectLods;
+    RefCntAutoPtr<IBuffer> m_Instances;
+    RefCntAutoPtr<IBuffer> m_DrawArgs;
+    RefCntAutoPtr<IBuffer> m_Stats;
+
+    // rebuilt every frame, the arena may have moved the meshes; 16-bit index draws first
+    std::vector<uint4>            m_MeshData;
+    std::vector<uint2>            m_BatchData;
+    std::vector<IndirectDrawArgs> m_DrawArgsData;
+    uint32_t                      m_NumDraws16 = 0;
+
+    RefCntAutoPtr<IFence>  m_Fence;
+    RefCntAutoPtr<IBuffer> m_StatsReadback[NumReadbacks];
+    uint64_t               m_ReadbackFrame[NumReadbacks] = {};
+    uint64_t               m_FrameIndex                  = 0;
+    uint64_t               m_LastReadFrame               = 0;
+    uint32_t               m_NumVisible                  = 0;
+};
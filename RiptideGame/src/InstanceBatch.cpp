@@ -0,0 +1,188 @@
+#include "InstanceBatch.h"
+#include <algorithm>
+#include <cstring>
+#include "MapHelper.hpp"
+
+InstanceBuffer::InstanceBuffer(IRenderDevice* pDevice, Uint32 NumViews, bool IndirectDraws) :
+    m_pDevice(pDevice),
+    m_NumViews(NumViews)
+{
+    const DeviceFeatures& features = pDevice->GetDeviceInfo().Features;
+    m_UseStepRate   = m_NumViews == 1 || features.InstanceDataStepRate != DEVICE_FEATURE_STATE_DISABLED;
+    m_IndirectDraws = IndirectDraws && features.IndirectRendering != DEVICE_FEATURE_STATE_DISABLED;
+}
+
+void InstanceBuffer::Reserve(Uint64 Size)
+{
+    if (Size <= m_Capacity)
+        return;
+
+    // grow geometrically so a growing scene does not recreate the buffer every frame
+    Uint64 capacity = std::max<Uint64>(m_Capacity, 64 * sizeof(InstanceData));
+    while (capacity < Size)
+        capacity *= 2;
+
+    BufferDesc desc;
+    desc.Name           = "Instance data VB";
+    desc.Size           = capacity;
+    desc.Usage          = USAGE_DYNAMIC;
+    desc.BindFlags      = BIND_VERTEX_BUFFER;
+    desc.CPUAccessFlags = CPU_ACCESS_WRITE;
+
+    m_pBuffer.Release();
+    m_pDevice->CreateBuffer(desc, nullptr, &m_pBuffer);
+    m_Capacity = capacity;
+}
+
+void InstanceBuffer::ReserveDrawArgs(Uint64 Size)
+{
+    if (Size <= m_DrawArgsCapacity)
+        return;
+
+    Uint64 capacity = std::max<Uint64>(m_DrawArgsCapacity, 64 * sizeof(IndirectDrawArgs));
+    while (capacity < Size)
+        capacity *= 2;
+
+    BufferDesc desc;
+    desc.Name      = "Instance draw args";
+    desc.Size      = capacity;
+    desc.Usage     = USAGE_DEFAULT;
+    desc.BindFlags = BIND_INDIRECT_DRAW_ARGS;
+
+    m_pDrawArgs.Release();
+    m_pDevice->CreateBuffer(desc, nullptr, &m_pDrawArgs);
+    m_DrawArgsCapacity = capacity;
+}
+
+void InstanceBuffer::Upload(IDeviceContext* pContext, const GeometryArena& Geometry, InstanceBatch* const* ppBatches, Uint32 NumBatches)
+{
+    const Uint32 replication = m_UseStepRate ? 1 : m_NumViews;
+
+    // batches start at a multiple of NumViews, so SV_InstanceID % NumViews picks the right eye
+    // also on backends where it includes FirstInstance
+    Uint32 numElements = 0;
+    m_NumInstances     = 0;
+    for (Uint32 i = 0; i < NumBatches; ++i)
+    {
+        numElements                   = (numElements + m_NumViews - 1) / m_NumViews * m_NumViews;
+        ppBatches[i]->m_FirstInstance = numElements;
+        numElements += ppBatches[i]->GetNumInstances() * replication;
+        m_NumInstances += ppBatches[i]->GetNumInstances();
+    }
+    if (m_NumInstances == 0)
+        return;
+
+    Reserve(Uint64{numElements} * sizeof(InstanceData));
+
+    {
+        MapHelper<InstanceData> instances(pContext, m_pBuffer, MAP_WRITE, MAP_FLAG_DISCARD);
+        for (Uint32 i = 0; i < NumBatches; ++i)
+        {
+            const std::vector<InstanceData>& src  = ppBatches[i]->m_Instances;
+            InstanceData*                    pDst = instances + ppBatches[i]->m_FirstInstance;
+            if (replication == 1)
+            {
+                if (!src.empty())
+                    memcpy(pDst, src.data(), src.size() * sizeof(InstanceData));
+            }
+            else
+            {
+                for (const InstanceData& instance : src)
+                {
+                    for (Uint32 view = 0; view < replication; ++view)
+                        *pDst++ = instance;
+                }
+            }
+        }
+    }
+
+    if (!m_IndirectDraws)
+        return;
+
+    // the arena ranges are resolved here, they may have moved since the last frame
+    m_DrawArgsData.clear();
+    for (VALUE_TYPE indexType : {VT_UINT16, VT_UINT32})
+    {
+        for (Uint32 i = 0; i < NumBatches; ++i)
+        {
+            const InstanceBatch& batch = *ppBatches[i];
+            if (batch.GetNumInstances() == 0)
+                continue;
+
+            const GeometryArena::Range& range = Geometry.GetRange(batch.m_Geometry);
+            if (range.IndexType != indexType)
+                continue;
+
+            m_DrawArgsData.push_back({batch.m_NumIndices, batch.GetNumInstances() * m_NumViews, range.FirstIndex + batch.m_FirstIndex,
+                                      static_cast<Int32>(range.BaseVertex), batch.m_FirstInstance});
+        }
+        if (indexType == VT_UINT16)
+            m_NumDraws16 = static_cast<Uint32>(m_DrawArgsData.size());
+    }
+
+    const Uint64 argsSize = m_DrawArgsData.size() * sizeof(IndirectDrawArgs);
+    ReserveDrawArgs(argsSize);
+    pContext->UpdateBuffer(m_pDrawArgs, 0, argsSize, m_DrawArgsData.data(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+
+    StateTransitionDesc barrier{m_pDrawArgs, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_INDIRECT_ARGUMENT, STATE_TRANSITION_FLAG_UPDATE_STATE};
+    pContext->TransitionResourceStates(1, &barrier);
+}
+
+void InstanceBuffer::Draw(CommandEncoder& Encoder, const GeometryArena& Geometry, const InstanceBatch* const* ppBatches, Uint32 NumBatches) const
+{
+    if (m_NumInstances == 0)
+        return;
+
+    // the shader picks the eye from SV_InstanceID % NumViews
+    if (m_IndirectDraws)
+    {
+        DrawIndirect(Encoder, Geometry, m_pBuffer, m_pDrawArgs, m_NumDraws16, static_cast<Uint32>(m_DrawArgsData.size()) - m_NumDraws16);
+        return;
+    }
+
+    for (Uint32 i = 0; i < NumBatches; ++i)
+    {
+        const InstanceBatch& batch = *ppBatches[i];
+        if (batch.GetNumInstances() == 0)
+            continue;
+
+        const GeometryArena::Range& range     = Geometry.GetRange(batch.m_Geometry);
+        IBuffer*                    pVBs[]    = {Geometry.GetVertexBuffer(), m_pBuffer};
+        Uint64                      offsets[] = {0, Uint64{batch.m_FirstInstance} * sizeof(InstanceData)};
+        Encoder.SetVertexBuffers(2, pVBs, offsets);
+        Encoder.SetIndexBuffer(Geometry.GetIndexBuffer(range.IndexType));
+
+        DrawIndexedAttribs drawAttrs{batch.m_NumIndices, range.IndexType, DRAW_FLAG_VERIFY_ALL, batch.GetNumInstances() * m_NumViews,
+                                     range.FirstIndex + batch.m_FirstIndex, range.BaseVertex};
+        Encoder.DrawIndexed(drawAttrs);
+    }
+}
+
+void InstanceBuffer::DrawIndirect(CommandEncoder& Encoder, const GeometryArena& Geometry, IBuffer* pInstances, IBuffer* pDrawArgs, Uint32 NumDraws16, Uint32 NumDraws32)
+{
+    IBuffer* pVBs[] = {Geometry.GetVertexBuffer(), pInstances};
+    Encoder.SetVertexBuffers(2, pVBs, nullptr);
+
+    // backends without native multi-draw submit the records one by one
+    const VALUE_TYPE indexTypes[] = {VT_UINT16, VT_UINT32};
+    const Uint32     numDraws[]   = {NumDraws16, NumDraws32};
+    Uint32           firstDraw    = 0;
+    for (Uint32 i = 0; i < _countof(indexTypes); ++i)
+    {
+        if (numDraws[i] == 0)
+            continue;
+
+        Encoder.SetIndexBuffer(Geometry.GetIndexBuffer(indexTypes[i]));
+
+        DrawIndexedIndirectAttribs drawAttrs;
+        drawAttrs.pAttribsBuffer                   = pDrawArgs;
+        drawAttrs.IndexType                        = indexTypes[i];
+        drawAttrs.Flags                            = DRAW_FLAG_VERIFY_ALL;
+        drawAttrs.DrawCount                        = numDraws[i];
+        drawAttrs.DrawArgsOffset                   = Uint64{firstDraw} * sizeof(IndirectDrawArgs);
+        drawAttrs.DrawArgsStride                   = sizeof(IndirectDrawArgs);
+        drawAttrs.AttribsBufferStateTransitionMode = RESOURCE_STATE_TRANSITION_MODE_VERIFY;
+        Encoder.DrawIndexedIndirect(drawAttrs);
+        firstDraw += numDraws[i];
+    }
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <vector>
+#include "RenderDevice.h"
+#include "DeviceContext.h"
+#include "RefCntAutoPtr.hpp"
+#include "BasicMath.hpp"
+#include "CommandEncoder.h"
+#include "GeometryArena.h"
+
+using namespace Diligent;
+
+// per-instance vertex data, matches ATTRIB2..ATTRIB11 of the instanced cube shader
+struct InstanceData
+{
+    float4x4 World;
+    float4x4 NormalTransform;
+    float4   Color;
+
+    // World is relative to this device pose in the late-latched pose buffer, 0 is the tracking origin
+    Uint32 PoseIndex  = 0;
+    Uint32 Padding[3] = {};
+};
+
+// All instances of one mesh level of detail for the current frame, drawn with a single instanced draw
+class InstanceBatch
+{
+public:
+    // the index range is relative to the mesh's range in the arena
+    InstanceBatch(GeometryArena::Handle Geometry, Uint32 FirstIndex, Uint32 NumIndices) :
+        m_Geometry(Geometry),
+        m_FirstIndex(FirstIndex),
+        m_NumIndices(NumIndices)
+    {
+    }
+
+    void Clear() { m_Instances.clear(); }
+
+    void Add(const InstanceData& Instance) { m_Instances.push_back(Instance); }
+
+    Uint32 GetNumInstances() const { return static_cast<Uint32>(m_Instances.size()); }
+
+private:
+    friend class InstanceBuffer;
+
+    GeometryArena::Handle m_Geometry;
+    Uint32                m_FirstIndex;
+    Uint32                m_NumIndices;
+
+    std::vector<InstanceData> m_Instances;
+
+    // the batch's first element in the instance buffer
+    Uint32 m_FirstInstance = 0;
+};
+
+// one record of the indirect arguments buffer, as DrawIndexedIndirect reads it
+struct IndirectDrawArgs
+{
+    Uint32 NumIndices;
+    Uint32 NumInstances;
+    Uint32 FirstIndex;
+    Int32  BaseVertex;
+    Uint32 FirstInstance;
+};
+static_assert(sizeof(IndirectDrawArgs) == 20, "IndirectDrawArgs must match the indirect draw layout");
+
+// Dynamic per-instance vertex buffer shared by all batches and written with one map per frame.
+// In stereo every instance is drawn once per view; when the device cannot step instance data
+// every NumViews instances, each instance is written NumViews times instead.
+// With indirect draws, Upload() also writes one draw record per non-empty batch, and all batches
+// are drawn with one multi-draw per index size; the instances are then selected with FirstInstance
+// instead of by binding the buffer at each batch's offset.
+class InstanceBuffer
+{
+public:
+    InstanceBuffer(IRenderDevice* pDevice, Uint32 NumViews, bool IndirectDraws);
+
+    // true if the input layout should use InstanceDataStepRate = NumViews
+    bool UsesStepRate() const { return m_UseStepRate; }
+
+    // false if disabled or not supported by the device
+    bool UsesIndirectDraws() const { return m_IndirectDraws; }
+
+    // on the immediate context, before the passes that draw the batches
+    void Upload(IDeviceContext* pContext, const GeometryArena& Geometry, InstanceBatch* const* ppBatches, Uint32 NumBatches);
+
+    // binds the arena's buffers and draws every batch; the instanced PSO and SRB must already be bound
+    void Draw(CommandEncoder& Encoder, const GeometryArena& Geometry, const InstanceBatch* const* ppBatches, Uint32 NumBatches) const;
+
+    // submits NumDraws16 records with 16-bit indices followed by NumDraws32 records with 32-bit
+    // indices from pDrawArgs, which must be in the indirect argument state
+    static void DrawIndirect(CommandEncoder& Encoder, const GeometryArena& Geometry, IBuffer* pInstances, IBuffer* pDrawArgs, Uint32 NumDraws16, Uint32 NumDraws32);
+
+private:
+    void Reserve(Uint64 Size);
+    void ReserveDrawArgs(Uint64 Size);
+
+    IRenderDevice* m_pDevice;
+    Uint32         m_NumViews;
+    bool           m_UseStepRate;
+    bool           m_IndirectDraws;
+
+    RefCntAutoPtr<IBuffer> m_pBuffer;
+    Uint64                 m_Capacity     = 0;
+    Uint32                 m_NumInstances = 0;
+
+    // 16-bit index draws first, then 32-bit ones
+    RefCntAutoPtr<IBuffer>        m_pDrawArgs;
+    Uint64                        m_DrawArgsCapacity = 0;
+    std::vector<IndirectDrawArgs> m_DrawArgsData;
+    Uint32                        m_NumDraws16 = 0;
+};
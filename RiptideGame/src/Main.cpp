@@ -4,6 +4,8 @@
 #include "DeviceContext.h"
 #include "EngineFactoryD3D11.h"
 #include "OpenVRInterface.h"
+#include "OpenVRRuntime.h"
+#include "SimulationThread.h"
 
 using namespace Diligent;
 
@@ -44,7 +46,8 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
         RefCntAutoPtr<IDeviceContext> pContext;
 
         EngineD3D11CreateInfo EngineCI;
-        EngineCI.GraphicsAPIVersion = {11, 0};
+        EngineCI.GraphicsAPIVersion        = {11, 0};
+        EngineCI.Features.TimestampQueries = DEVICE_FEATURE_STATE_OPTIONAL;
         auto GetEngineFactoryD3D11Func = LoadGraphicsEngineD3D11();
         if (!GetEngineFactoryD3D11Func)
             throw std::runtime_error("Failed to load D3D11 engine factory");
@@ -60,9 +63,28 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
             throw std::runtime_error("Failed to create D3D11 device and context");
 
         // initialize openvr
-        OpenVRInterface vrInterface(pDevice, pContext);
+        OpenVRRuntime vrRuntime;
+        vrRuntime.Initialize();
+
+        // compiled shaders and pipeline states are kept next to the executable between launches
+        OpenVRInterfaceDesc rendererDesc;
+        rendererDesc.PipelineCache.FilePath = "RiptidePipelines";
+
+        // start each frame as late as the compositor's timing allows
+        rendererDesc.FramePacing.Enabled = true;
+
+        // a frame that would be late is replaced by the last one warped to the newest poses
+        rendererDesc.Reprojection.Enabled = true;
+
+        OpenVRInterface vrInterface(pDevice, pContext, &vrRuntime, rendererDesc);
         vrInterface.Initialize();
 
+        // game logic runs off the VR critical path and hands the renderer complete scene snapshots
+        SimulationThread simulation(90.0, [](double, double, SceneSnapshot& scene) {
+            scene.Props.clear();
+        });
+        simulation.Start();
+
         // main loop
         MSG msg = {};
         while (true)
@@ -72,11 +94,26 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE, LPSTR, int)
                 if (msg.message == WM_QUIT)
                     return 0;
 
+                // F2 toggles the frame profiler, F3 prints its report and dumps a trace
+                if (msg.message == WM_KEYDOWN && msg.wParam == VK_F2)
+                {
+                    FrameProfiler& profiler = vrInterface.GetProfiler();
+                    profiler.SetEnabled(!profiler.IsEnabled());
+                }
+                else if (msg.message == WM_KEYDOWN && msg.wParam == VK_F3)
+                {
+                    vrInterface.GetProfiler().PrintReport(stdout);
+                    vrInterface.GetProfiler().WriteChromeTrace("RiptideTrace.json");
+                }
+
                 TranslateMessage(&msg);
                 DispatchMessage(&msg);
             }
 
-            vrInterface.RenderFrame();
+            // never waits for the simulation, a slow tick just means the previous snapshot is drawn again;
+            // the snapshot is acquired once the frame starts, so it is as new as the poses
+            vrInterface.BeginFrame();
+            vrInterface.RenderFrame(simulation.AcquireLatest());
         }
     }
     catch (const std::exception& e)
@@ -0,0 +1,462 @@
+#include "Mesh.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#if PLATFORM_WIN32
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <Windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace
+{
+
+// .rmesh files start with this header and NumLods MeshFileLod, followed by NumVertices
+// QuantizedVertex at VertexDataOffset and NumIndices indices of IndexSize bytes at
+// IndexDataOffset; all little endian
+struct MeshFileHeader
+{
+    uint32_t Magic;
+    uint32_t Version;
+    uint32_t NumVertices;
+    uint32_t NumIndices;
+    uint32_t IndexSize;
+    uint32_t NumLods;
+    float    BoundsMin[3];
+    float    BoundsMax[3];
+    uint64_t VertexDataOffset;
+    uint64_t IndexDataOffset;
+};
+static_assert(sizeof(MeshFileHeader) == 64, "the header keeps the vertex data 16 byte aligned");
+
+struct MeshFileLod
+{
+    uint32_t FirstIndex;
+    uint32_t NumIndices;
+    float    Error;
+    uint32_t Reserved;
+};
+static_assert(sizeof(MeshFileLod) == 16, "the levels keep the vertex data 16 byte aligned");
+
+constexpr uint32_t MeshFileMagic   = 0x48534D52; // "RMSH"
+constexpr uint32_t MeshFileVersion = 2;
+
+int16_t QuantizeSnorm16(float Value)
+{
+    return static_cast<int16_t>(std::lround(clamp(Value, -1.f, 1.f) * 32767.f));
+}
+
+// round to nearest, denormals flush to zero and out of range values become infinity
+uint16_t FloatToHalf(float Value)
+{
+    uint32_t bits;
+    memcpy(&bits, &Value, sizeof(bits));
+
+    const uint32_t sign     = (bits >> 16) & 0x8000u;
+    const int32_t  exponent = static_cast<int32_t>((bits >> 23) & 0xFFu) - 127 + 15;
+    const uint32_t mantissa = bits & 0x7FFFFFu;
+    if (exponent <= 0)
+        return static_cast<uint16_t>(sign);
+    if (exponent >= 31)
+        return static_cast<uint16_t>(sign | 0x7C00u);
+
+    // a carry out of the mantissa correctly increments the exponent
+    uint32_t half = sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13);
+    if (mantissa & 0x1000u)
+        ++half;
+    return static_cast<uint16_t>(half);
+}
+
+// projects the unit normal onto an octahedron and unfolds its lower half, the shader reverses it
+float2 EncodeOctahedral(const float3& Normal)
+{
+    const float l1 = std::abs(Normal.x) + std::abs(Normal.y) + std::abs(Normal.z);
+    if (l1 == 0)
+        return float2(0, 0);
+
+    const float2 p(Normal.x / l1, Normal.y / l1);
+    if (Normal.z >= 0)
+        return p;
+    return float2((1.f - std::abs(p.y)) * (p.x >= 0 ? 1.f : -1.f),
+                  (1.f - std::abs(p.x)) * (p.y >= 0 ? 1.f : -1.f));
+}
+
+GpuMesh UploadMesh(GeometryArena& Arena, IDeviceContext* pContext, const std::string& Name, const BoundBox& Bounds, const std::vector<MeshLod>& Lods,
+                   const void* pVertices, Uint32 NumVertices, const void* pIndices, Uint32 NumIndices, Uint32 IndexSize)
+{
+    GpuMesh mesh;
+    mesh.NumVertices = NumVertices;
+    mesh.NumIndices  = NumIndices;
+    mesh.IndexType   = IndexSize == 2 ? VT_UINT16 : VT_UINT32;
+    mesh.Bounds      = Bounds;
+    mesh.Lods        = Lods;
+    if (mesh.Lods.empty())
+        mesh.Lods.push_back({0, NumIndices, 0.f});
+    for (const MeshLod& lod : mesh.Lods)
+    {
+        if (lod.FirstIndex > NumIndices || lod.NumIndices > NumIndices - lod.FirstIndex)
+            throw std::runtime_error("Level of detail of mesh " + Name + " is out of range");
+    }
+
+    const float3 center  = (Bounds.Min + Bounds.Max) * 0.5f;
+    const float3 extents = (Bounds.Max - Bounds.Min) * 0.5f;
+    mesh.Dequantize      = float4x4::Scale(extents.x, extents.y, extents.z) * float4x4::Translation(center);
+
+    // copied once from the source data through the context's upload memory, there is no staging copy of our own
+    mesh.Geometry = Arena.Allocate(pContext, pVertices, NumVertices, pIndices, NumIndices, mesh.IndexType);
+    return mesh;
+}
+
+} // namespace
+
+QuantizedMesh QuantizeMesh(const MeshData& Mesh)
+{
+    const size_t numVertices = Mesh.Positions.size();
+    if (Mesh.Normals.size() != numVertices || (!Mesh.TexCoords.empty() && Mesh.TexCoords.size() != numVertices))
+        throw std::runtime_error("Mesh streams must have one entry per vertex");
+
+    QuantizedMesh result;
+    result.Bounds = {float3(FLT_MAX, FLT_MAX, FLT_MAX), float3(-FLT_MAX, -FLT_MAX, -FLT_MAX)};
+    for (const float3& pos : Mesh.Positions)
+    {
+        result.Bounds.Min = min(result.Bounds.Min, pos);
+        result.Bounds.Max = max(result.Bounds.Max, pos);
+    }
+    if (numVertices == 0)
+        result.Bounds = {float3(0, 0, 0), float3(0, 0, 0)};
+
+    // flat meshes have zero extents along one axis, all their vertices sit at the center there
+    const float3 center  = (result.Bounds.Min + result.Bounds.Max) * 0.5f;
+    const float3 extents = (result.Bounds.Max - result.Bounds.Min) * 0.5f;
+
+    result.Vertices.resize(numVertices);
+    for (size_t i = 0; i < numVertices; ++i)
+    {
+        QuantizedVertex& vertex = result.Vertices[i];
+        for (int c = 0; c < 3; ++c)
+            vertex.Position[c] = extents[c] > 0 ? QuantizeSnorm16((Mesh.Positions[i][c] - center[c]) / extents[c]) : 0;
+        vertex.Position[3] = 0;
+
+        const float2 normal = EncodeOctahedral(Mesh.Normals[i]);
+        vertex.Normal[0]    = QuantizeSnorm16(normal.x);
+        vertex.Normal[1]    = QuantizeSnorm16(normal.y);
+
+        const float2 uv    = Mesh.TexCoords.empty() ? float2(0, 0) : Mesh.TexCoords[i];
+        vertex.TexCoord[0] = FloatToHalf(uv.x);
+        vertex.TexCoord[1] = FloatToHalf(uv.y);
+    }
+
+    result.Indices = Mesh.Indices;
+    return result;
+}
+
+void GenerateLods(QuantizedMesh& Mesh, uint32_t MaxLods)
+{
+    const uint32_t numFullIndices = Mesh.Lods.empty() ? static_cast<uint32_t>(Mesh.Indices.size()) : Mesh.Lods[0].NumIndices;
+    if (!Mesh.Lods.empty() && Mesh.Lods[0].FirstIndex != 0)
+        throw std::runtime_error("The full detail level must come first in the index buffer");
+    Mesh.Indices.resize(numFullIndices);
+    Mesh.Lods = {{0, numFullIndices, 0.f}};
+
+    const float3 extents = (Mesh.Bounds.Max - Mesh.Bounds.Min) * 0.5f;
+
+    std::unordered_map<uint32_t, uint32_t> cellVertex;
+    std::vector<uint32_t>                  remap(Mesh.Vertices.size());
+    std::vector<uint32_t>                  lodIndices;
+    for (uint32_t gridBits = 10; gridBits > 0 && Mesh.Lods.size() < MaxLods; --gridBits)
+    {
+        // the first vertex in a grid cell stands in for all others in it
+        const uint32_t gridSize = 1u << gridBits;
+        cellVertex.clear();
+        for (uint32_t v = 0; v < Mesh.Vertices.size(); ++v)
+        {
+            uint32_t cellKey = 0;
+            for (int c = 0; c < 3; ++c)
+                cellKey = (cellKey << 10) | ((static_cast<uint32_t>(Mesh.Vertices[v].Position[c] + 32768) * gridSize) >> 16);
+            remap[v] = cellVertex.emplace(cellKey, v).first->second;
+        }
+
+        // triangles collapsed to a line or a point disappear
+        lodIndices.clear();
+        for (uint32_t i = 0; i + 2 < numFullIndices; i += 3)
+        {
+            const uint32_t a = remap[Mesh.Indices[i]];
+            const uint32_t b = remap[Mesh.Indices[i + 1]];
+            const uint32_t c = remap[Mesh.Indices[i + 2]];
+            if (a != b && b != c && a != c)
+                lodIndices.insert(lodIndices.end(), {a, b, c});
+        }
+        if (lodIndices.empty())
+            break;
+        if (lodIndices.size() > Mesh.Lods.back().NumIndices / 2)
+            continue;
+
+        // vertices move at most by the diagonal of a cell
+        const float3 cellSize = extents * (2.f / gridSize);
+        Mesh.Lods.push_back({static_cast<uint32_t>(Mesh.Indices.size()), static_cast<uint32_t>(lodIndices.size()), length(cellSize)});
+        Mesh.Indices.insert(Mesh.Indices.end(), lodIndices.begin(), lodIndices.end());
+    }
+}
+
+MeshData CreateCubeMeshData()
+{
+    MeshData mesh;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        for (float sign : {1.f, -1.f})
+        {
+            // u x v points along the face normal, which makes the triangles below clockwise seen from outside
+            float3 normal, u, v;
+            normal[axis]      = sign;
+            u[(axis + 1) % 3] = 1;
+            v[(axis + 2) % 3] = 1;
+            if (sign < 0)
+                std::swap(u, v);
+
+            const uint32_t first = static_cast<uint32_t>(mesh.Positions.size());
+            for (int corner = 0; corner < 4; ++corner)
+            {
+                const float s = (corner & 1) ? 1.f : -1.f;
+                const float t = (corner & 2) ? 1.f : -1.f;
+                mesh.Positions.push_back(normal + u * s + v * t);
+                mesh.Normals.push_back(normal);
+                mesh.TexCoords.push_back(float2((s + 1) * 0.5f, (1 - t) * 0.5f));
+            }
+            for (uint32_t idx : {0u, 1u, 2u, 1u, 3u, 2u})
+                mesh.Indices.push_back(first + idx);
+        }
+    }
+    return mesh;
+}
+
+MeshData CreateSphereMeshData(uint32_t NumSegments)
+{
+    NumSegments = std::max(NumSegments, 3u);
+
+    const uint32_t numRings   = std::max(NumSegments / 2, 2u);
+    const uint32_t ringStride = NumSegments + 1;
+    const float    pi         = 3.14159265358979f;
+
+    // the seam has its vertices twice, with texture coordinates 0 and 1
+    MeshData mesh;
+    for (uint32_t ring = 0; ring <= numRings; ++ring)
+    {
+        const float theta = pi * ring / numRings;
+        for (uint32_t segment = 0; segment <= NumSegments; ++segment)
+        {
+            const float  phi = 2 * pi * segment / NumSegments;
+            const float3 pos(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi));
+            mesh.Positions.push_back(pos);
+            mesh.Normals.push_back(pos);
+            mesh.TexCoords.push_back(float2(static_cast<float>(segment) / NumSegments, static_cast<float>(ring) / numRings));
+        }
+    }
+
+    // the triangles touching the poles would be degenerate and are left out
+    for (uint32_t ring = 0; ring < numRings; ++ring)
+    {
+        for (uint32_t segment = 0; segment < NumSegments; ++segment)
+        {
+            const uint32_t a = ring * ringStride + segment;
+            const uint32_t b = a + 1;
+            const uint32_t c = a + ringStride;
+            const uint32_t d = c + 1;
+            if (ring > 0)
+                mesh.Indices.insert(mesh.Indices.end(), {a, b, c});
+            if (ring + 1 < numRings)
+                mesh.Indices.insert(mesh.Indices.end(), {b, d, c});
+        }
+    }
+    return mesh;
+}
+
+void WriteMeshFile(const char* Path, const QuantizedMesh& Mesh)
+{
+    const uint32_t numVertices = static_cast<uint32_t>(Mesh.Vertices.size());
+    const uint32_t numIndices  = static_cast<uint32_t>(Mesh.Indices.size());
+
+    std::vector<MeshFileLod> lods;
+    for (const MeshLod& lod : Mesh.Lods)
+        lods.push_back({lod.FirstIndex, lod.NumIndices, lod.Error, 0});
+    if (lods.empty())
+        lods.push_back({0, numIndices, 0.f, 0});
+
+    MeshFileHeader header   = {};
+    header.Magic            = MeshFileMagic;
+    header.Version          = MeshFileVersion;
+    header.NumVertices      = numVertices;
+    header.NumIndices       = numIndices;
+    header.IndexSize        = numVertices <= 0x10000 ? 2 : 4;
+    header.NumLods          = static_cast<uint32_t>(lods.size());
+    header.VertexDataOffset = sizeof(MeshFileHeader) + lods.size() * sizeof(MeshFileLod);
+    header.IndexDataOffset  = header.VertexDataOffset + Uint64{numVertices} * sizeof(QuantizedVertex);
+    for (int c = 0; c < 3; ++c)
+    {
+        header.BoundsMin[c] = Mesh.Bounds.Min[c];
+        header.BoundsMax[c] = Mesh.Bounds.Max[c];
+    }
+
+    std::ofstream file(Path, std::ios::binary | std::ios::trunc);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(lods.data()), static_cast<std::streamsize>(lods.size() * sizeof(MeshFileLod)));
+    file.write(reinterpret_cast<const char*>(Mesh.Vertices.data()), static_cast<std::streamsize>(numVertices * sizeof(QuantizedVertex)));
+    if (header.IndexSize == 2)
+    {
+        const std::vector<uint16_t> indices(Mesh.Indices.begin(), Mesh.Indices.end());
+        file.write(reinterpret_cast<const char*>(indices.data()), static_cast<std::streamsize>(numIndices * sizeof(uint16_t)));
+    }
+    else
+    {
+        file.write(reinterpret_cast<const char*>(Mesh.Indices.data()), static_cast<std::streamsize>(numIndices * sizeof(uint32_t)));
+    }
+    if (!file)
+        throw std::runtime_error(std::string("Failed to write mesh file ") + Path);
+}
+
+MappedFile::MappedFile(const char* Path)
+{
+#if PLATFORM_WIN32
+    HANDLE hFile = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (hFile == INVALID_HANDLE_VALUE)
+        throw std::runtime_error(std::string("Failed to open ") + Path);
+    m_hFile = hFile;
+
+    LARGE_INTEGER size = {};
+    GetFileSizeEx(hFile, &size);
+    m_Size = static_cast<size_t>(size.QuadPart);
+
+    // empty files cannot be mapped
+    if (m_Size > 0)
+    {
+        m_hMapping = CreateFileMappingA(hFile, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (m_hMapping != nullptr)
+            m_pData = static_cast<const uint8_t*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+        if (m_pData == nullptr)
+        {
+            if (m_hMapping != nullptr)
+                CloseHandle(m_hMapping);
+            CloseHandle(hFile);
+            throw std::runtime_error(std::string("Failed to map ") + Path);
+        }
+    }
+#else
+    const int fd = open(Path, O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error(std::string("Failed to open ") + Path);
+
+    struct stat st = {};
+    if (fstat(fd, &st) == 0)
+        m_Size = static_cast<size_t>(st.st_size);
+
+    // empty files cannot be mapped, the mapping keeps the file open after close()
+    if (m_Size > 0)
+    {
+        void* pData = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (pData == MAP_FAILED)
+        {
+            close(fd);
+            throw std::runtime_error(std::string("Failed to map ") + Path);
+        }
+        madvise(pData, m_Size, MADV_SEQUENTIAL);
+        m_pData = static_cast<const uint8_t*>(pData);
+    }
+    close(fd);
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#if PLATFORM_WIN32
+    if (m_pData != nullptr)
+        UnmapViewOfFile(m_pData);
+    if (m_hMapping != nullptr)
+        CloseHandle(m_hMapping);
+    CloseHandle(m_hFile);
+#else
+    if (m_pData != nullptr)
+        munmap(const_cast<uint8_t*>(m_pData), m_Size);
+#endif
+}
+
+GpuMesh CreateGpuMesh(GeometryArena& Arena, IDeviceContext* pContext, const QuantizedMesh& Mesh, const char* Name)
+{
+    const Uint32 numVertices = static_cast<Uint32>(Mesh.Vertices.size());
+    const Uint32 numIndices  = static_cast<Uint32>(Mesh.Indices.size());
+    if (numVertices <= 0x10000)
+    {
+        const std::vector<uint16_t> indices(Mesh.Indices.begin(), Mesh.Indices.end());
+        return UploadMesh(Arena, pContext, Name, Mesh.Bounds, Mesh.Lods, Mesh.Vertices.data(), numVertices, indices.data(), numIndices, 2);
+    }
+    return UploadMesh(Arena, pContext, Name, Mesh.Bounds, Mesh.Lods, Mesh.Vertices.data(), numVertices, Mesh.Indices.data(), numIndices, 4);
+}
+
+GpuMesh LoadMeshFile(GeometryArena& Arena, IDeviceContext* pContext, const char* Path, bool GenerateMissingLods)
+{
+    const MappedFile file(Path);
+    if (file.GetSize() < sizeof(MeshFileHeader))
+        throw std::runtime_error(std::string(Path) + " is not a mesh file");
+
+    MeshFileHeader header;
+    memcpy(&header, file.GetData(), sizeof(header));
+    if (header.Magic != MeshFileMagic)
+        throw std::runtime_error(std::string(Path) + " is not a mesh file");
+    if (header.Version != MeshFileVersion)
+        throw std::runtime_error(std::string(Path) + " has an unsupported mesh file version");
+    if (header.IndexSize != 2 && header.IndexSize != 4)
+        throw std::runtime_error(std::string(Path) + " has an invalid index size");
+
+    const uint64_t lodBytes    = uint64_t{header.NumLods} * sizeof(MeshFileLod);
+    const uint64_t vertexBytes = uint64_t{header.NumVertices} * sizeof(QuantizedVertex);
+    const uint64_t indexBytes  = uint64_t{header.NumIndices} * header.IndexSize;
+    if (lodBytes > file.GetSize() - sizeof(MeshFileHeader) ||
+        header.VertexDataOffset > file.GetSize() || vertexBytes > file.GetSize() - header.VertexDataOffset ||
+        header.IndexDataOffset > file.GetSize() || indexBytes > file.GetSize() - header.IndexDataOffset)
+        throw std::runtime_error(std::string(Path) + " is truncated");
+
+    BoundBox bounds;
+    bounds.Min = float3(header.BoundsMin[0], header.BoundsMin[1], header.BoundsMin[2]);
+    bounds.Max = float3(header.BoundsMax[0], header.BoundsMax[1], header.BoundsMax[2]);
+
+    std::vector<MeshLod> lods(header.NumLods);
+    for (uint32_t i = 0; i < header.NumLods; ++i)
+    {
+        MeshFileLod lod;
+        memcpy(&lod, file.GetData() + sizeof(MeshFileHeader) + i * sizeof(MeshFileLod), sizeof(lod));
+        lods[i] = {lod.FirstIndex, lod.NumIndices, lod.Error};
+    }
+
+    const uint8_t* pVertices = file.GetData() + header.VertexDataOffset;
+    const uint8_t* pIndices  = file.GetData() + header.IndexDataOffset;
+    if (GenerateMissingLods && lods.size() <= 1)
+    {
+        // the only path that copies the data, the simplified levels are appended to the indices
+        QuantizedMesh mesh;
+        mesh.Bounds = bounds;
+        mesh.Lods   = lods;
+        mesh.Vertices.resize(header.NumVertices);
+        memcpy(mesh.Vertices.data(), pVertices, vertexBytes);
+        mesh.Indices.resize(header.NumIndices);
+        for (uint32_t i = 0; i < header.NumIndices; ++i)
+        {
+            mesh.Indices[i] = header.IndexSize == 2 ? reinterpret_cast<const uint16_t*>(pIndices)[i] : reinterpret_cast<const uint32_t*>(pIndices)[i];
+            if (mesh.Indices[i] >= header.NumVertices)
+                throw std::runtime_error(std::string(Path) + " has an out of range index");
+        }
+        GenerateLods(mesh);
+        return CreateGpuMesh(Arena, pContext, mesh, Path);
+    }
+
+    // the pages are read once, by the copy into the arena
+    return UploadMesh(Arena, pContext, Path, bounds, lods, pVertices, header.NumVertices, pIndices, header.NumIndices, header.IndexSize);
+}
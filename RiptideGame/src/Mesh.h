@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "RenderDevice.h"
+#include "RefCntAutoPtr.hpp"
+#include "BasicMath.hpp"
+#include "AdvancedMath.hpp"
+#include "GeometryArena.h"
+
+using namespace Diligent;
+
+// Vertex format of every mesh, 16 bytes instead of 32 for float positions, normals and texture
+// coordinates. Positions are snorm16 within the mesh bounds, normals are octahedral snorm16 and
+// texture coordinates half floats; matches ATTRIB0, ATTRIB1 and ATTRIB12 of the cube shader.
+struct QuantizedVertex
+{
+    int16_t  Position[4]; // w is padding
+    int16_t  Normal[2];
+    uint16_t TexCoord[2];
+};
+static_assert(sizeof(QuantizedVertex) == 16, "QuantizedVertex must match the input layout");
+
+// uncompressed geometry as it is generated or imported, all streams have one entry per vertex
+struct MeshData
+{
+    std::vector<float3>   Positions;
+    std::vector<float3>   Normals;
+    std::vector<float2>   TexCoords;
+    std::vector<uint32_t> Indices;
+};
+
+// index range of one level of detail, all levels of a mesh share its vertices
+struct MeshLod
+{
+    uint32_t FirstIndex = 0;
+    uint32_t NumIndices = 0;
+
+    // how far the level's surface may be from the full detail one, in the mesh's units
+    float Error = 0;
+};
+
+struct QuantizedMesh
+{
+    BoundBox                     Bounds;
+    std::vector<QuantizedVertex> Vertices;
+    std::vector<uint32_t>        Indices;
+
+    // from full to least detail; empty for a single level made of all indices
+    std::vector<MeshLod> Lods;
+};
+
+QuantizedMesh QuantizeMesh(const MeshData& Mesh);
+
+// replaces the levels after the first with simplified index buffers; vertices are clustered on
+// ever coarser grids, and a grid becomes the next level once it at least halves the triangles
+void GenerateLods(QuantizedMesh& Mesh, uint32_t MaxLods = 6);
+
+// cube from -1 to 1 with one normal per face
+MeshData CreateCubeMeshData();
+
+// unit radius sphere with NumSegments vertices around the equator
+MeshData CreateSphereMeshData(uint32_t NumSegments);
+
+// writes a .rmesh file with the mesh's levels, indices are stored in 16 bits when the vertex count allows it
+void WriteMeshFile(const char* Path, const QuantizedMesh& Mesh);
+
+// Read-only view of a whole file, unmapped when destroyed
+class MappedFile
+{
+public:
+    explicit MappedFile(const char* Path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const uint8_t* GetData() const { return m_pData; }
+    size_t         GetSize() const { return m_Size; }
+
+private:
+    const uint8_t* m_pData = nullptr;
+    size_t         m_Size  = 0;
+#if PLATFORM_WIN32
+    void* m_hFile    = nullptr;
+    void* m_hMapping = nullptr;
+#endif
+};
+
+struct GpuMesh
+{
+    // InvalidHandle once the mesh was unloaded
+    GeometryArena::Handle Geometry    = GeometryArena::InvalidHandle;
+    Uint32                NumVertices = 0;
+    Uint32                NumIndices  = 0;
+    VALUE_TYPE            IndexType   = VT_UINT32;
+
+    // at least one, relative to the mesh's range in the arena
+    std::vector<MeshLod> Lods;
+
+    // in the units the mesh was authored in
+    BoundBox Bounds;
+
+    // maps the snorm positions into Bounds, applied before the world transform
+    float4x4 Dequantize = float4x4::Identity();
+};
+
+// the data is uploaded into the arena on the context
+GpuMesh CreateGpuMesh(GeometryArena& Arena, IDeviceContext* pContext, const QuantizedMesh& Mesh, const char* Name);
+
+// maps a .rmesh file and uploads it into the arena straight from the mapping, without reading it first;
+// files written without levels of detail get them generated here unless GenerateMissingLods is false
+GpuMesh LoadMeshFile(GeometryArena& Arena, IDeviceContext* pContext, const char* Path, bool GenerateMissingLods = true);
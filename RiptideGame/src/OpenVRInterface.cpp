@@ -1,65 +1,304 @@
 #include "OpenVRInterface.h"
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <functional>
 
 void OpenVRInterface::Initialize()
 {
-    vr::EVRInitError eError = vr::VRInitError_None;
-    m_pHMD                  = vr::VR_Init(&eError, vr::VRApplication_Scene);
-    if (eError != vr::VRInitError_None)
-        throw std::runtime_error("VR_Init failed");
+    if (!m_pRuntime)
+        throw std::runtime_error("VR runtime is not set");
 
     uint32_t renderWidth, renderHeight;
-    m_pHMD->GetRecommendedRenderTargetSize(&renderWidth, &renderHeight);
+    m_pRuntime->GetRecommendedRenderTargetSize(&renderWidth, &renderHeight);
 
-    CreateEyeResources(renderWidth, renderHeight);
+    m_NumViews = m_Desc.Stereo == StereoMode::SinglePassInstanced ? 2 : 1;
+
+    // allocated once at the largest scale, dynamic resolution only changes the viewport
+    const float maxScale = m_Resolution.GetMaxScale();
+    m_EyeTargetWidth     = static_cast<uint32_t>(renderWidth * maxScale + 0.5f);
+    m_EyeTargetHeight    = static_cast<uint32_t>(renderHeight * maxScale + 0.5f);
+    m_ViewportWidth      = m_EyeTargetWidth;
+    m_ViewportHeight     = m_EyeTargetHeight;
+
+    CreateEyeResources(m_EyeTargetWidth, m_EyeTargetHeight);
     CreateCubeResources();
+
+    m_PipelineCache = std::make_unique<PipelineCache>(m_pDevice, m_Desc.PipelineCache);
+    if (m_Desc.TextureStreaming.Enabled)
+        m_Textures = std::make_unique<TextureStreamer>(m_pDevice, m_Desc.TextureStreaming);
+
+    const double creationStartMs = m_Profiler.NowMs();
+    auto         createPipelines = [this, creationStartMs]() {
+        CreatePipelines();
+        m_PipelineCreationMs = m_Profiler.NowMs() - creationStartMs;
+    };
+    if (m_Desc.AsyncPipelineCreation)
+    {
+        m_PipelineCreation = std::async(std::launch::async, createPipelines);
+    }
+    else
+    {
+        createPipelines();
+        FinishPipelineCreation();
+    }
+
+    UpdateDevices();
+    RebuildDeviceDraws();
+
+    if (!m_Desc.Instancing && m_Desc.NumSortThreads > 0)
+        m_SortThreads = std::make_unique<ThreadPool>(m_Desc.NumSortThreads);
+
+    m_Stages.Frame               = m_Profiler.RegisterStage("Frame");
+    m_Stages.WaitGetPoses        = m_Profiler.RegisterStage("WaitGetPoses");
+    m_Stages.FramePacing         = m_Profiler.RegisterStage("FramePacing");
+    m_Stages.UpdateDevicePoses   = m_Profiler.RegisterStage("UpdateDevicePoses");
+    m_Stages.UpdateScene         = m_Profiler.RegisterStage("UpdateScene");
+    m_Stages.StreamTextures      = m_Profiler.RegisterStage("StreamTextures");
+    m_Stages.Cull                = m_Profiler.RegisterStage("Cull");
+    m_Stages.SelectLods          = m_Profiler.RegisterStage("SelectLods");
+    m_Stages.GpuCull             = m_Profiler.RegisterStage("GpuCull");
+    m_Stages.SortDraws           = m_Profiler.RegisterStage("SortDraws");
+    m_Stages.RenderEye[0]        = m_Profiler.RegisterStage("RenderEye.Left");
+    m_Stages.RenderEye[1]        = m_Profiler.RegisterStage("RenderEye.Right");
+    m_Stages.RenderStereo        = m_Profiler.RegisterStage("RenderStereo");
+    m_Stages.UpdateConstants     = m_Profiler.RegisterStage("UpdateConstants");
+    m_Stages.UpdateInstances     = m_Profiler.RegisterStage("UpdateInstances");
+    m_Stages.RecordChunk         = m_Profiler.RegisterStage("RecordChunk");
+    m_Stages.ExecuteCommandLists = m_Profiler.RegisterStage("ExecuteCommandLists");
+    m_Stages.LatchPoses          = m_Profiler.RegisterStage("LatchPoses");
+    m_Stages.Reproject           = m_Profiler.RegisterStage("Reproject");
+    m_Stages.SubmitTextures      = m_Profiler.RegisterStage("SubmitTextures");
+
+    // time from WaitGetPoses() to the late latch, i.e. how much older the poses would have been
+    m_Stages.LatchedLatencySaving = m_Profiler.RegisterStage("LatchedLatencySaving");
 }
 
-void OpenVRInterface::RenderFrame()
+void OpenVRInterface::BeginFrame()
 {
-    vr::TrackedDevicePose_t trackedDevicePoses[vr::k_unMaxTrackedDeviceCount];
-    vr::VRCompositor()->WaitGetPoses(trackedDevicePoses, vr::k_unMaxTrackedDeviceCount, nullptr, 0);
+    if (m_FrameBegun)
+        return;
+    m_FrameBegun = true;
 
-    UpdateDevicePoses(trackedDevicePoses);
+    AllocationTracker::BeginFrame();
+    m_Profiler.BeginFrame();
+    m_FrameStartMs = m_Profiler.NowMs();
 
-    for (int eye = 0; eye < 2; ++eye)
     {
-        RenderEye(static_cast<vr::EVREye>(eye));
+        ScopedCpuTimer timer(m_Profiler, m_Stages.WaitGetPoses);
+        m_pRuntime->WaitGetPoses(m_FramePoses, vr::k_unMaxTrackedDeviceCount);
     }
 
-    SubmitTextures();
+    // the loading view is not worth delaying
+    float secondsToPhotons = m_pRuntime->GetPredictedSecondsToPhotons();
+    m_Pacer.BeginFrame(m_pRuntime, m_Resolution.GetLastGpuTimeMs());
+    if (m_PipelinesReady)
+    {
+        ScopedCpuTimer timer(m_Profiler, m_Stages.FramePacing);
+        if (m_Pacer.WaitForStart())
+        {
+            // same target time as WaitGetPoses(), but predicted from the tracking data at the delayed start
+            secondsToPhotons = m_pRuntime->GetPredictedSecondsToPhotons();
+            m_pRuntime->GetDeviceToAbsoluteTrackingPose(secondsToPhotons, m_FramePoses, vr::k_unMaxTrackedDeviceCount);
+        }
+    }
+    m_Pacer.SetPoseLatency(secondsToPhotons);
+    m_WorkStartMs = m_Profiler.NowMs();
 }
 
-void OpenVRInterface::CreateEyeResources(uint32_t width, uint32_t height)
+void OpenVRInterface::RenderFrame(const SceneSnapshot& Scene)
 {
-    TextureDesc eyeTexDesc;
-    eyeTexDesc.Type      = RESOURCE_DIM_TEX_2D;
-    eyeTexDesc.Width     = width;
-    eyeTexDesc.Height    = height;
-    eyeTexDesc.Format    = TEX_FORMAT_RGBA8_UNORM;
-    eyeTexDesc.BindFlags = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE;
+    BeginFrame();
+    if (!m_PipelinesReady && !FinishPipelineCreation())
+    {
+        RenderLoadingFrame();
+        EndFrame();
+        return;
+    }
 
-    TextureDesc depthDesc = eyeTexDesc;
-    depthDesc.Format      = TEX_FORMAT_D32_FLOAT;
-    depthDesc.BindFlags   = BIND_DEPTH_STENCIL;
+    // decided before any of the frame's work, a late frame is best skipped entirely
+    if (m_Reprojector && m_Reprojector->ShouldReproject(m_Pacer.WillMissDeadline()))
+    {
+        ReprojectFrame();
+        EndFrame();
+        return;
+    }
+
+    m_Encoder.ResetStats();
+    m_Encoder.Invalidate();
+    for (RecordContext& context : m_RecordContexts)
+        context.Encoder->ResetStats();
+
+    {
+        ScopedCpuTimer timer(m_Profiler, m_Stages.UpdateDevicePoses);
+        UpdateDevices();
+        UpdateDevicePoses(m_FramePoses);
+    }
+    m_PosesLatched   = false;
+    m_PosesFetchedMs = m_Profiler.NowMs();
+
+    m_Resolution.BeginFrame(m_pImmediateContext, m_pRuntime->GetFrameDuration());
+    m_Resolution.GetViewportSize(m_EyeTargetWidth, m_EyeTargetHeight, m_ViewportWidth, m_ViewportHeight);
+    if (m_Foveation)
+        m_Foveation->BeginFrame(m_Camera, m_ViewportWidth, m_ViewportHeight);
+
+    {
+        ScopedCpuTimer timer(m_Profiler, m_Stages.UpdateScene);
+        UpdateScene(Scene);
+    }
+
+    if (m_Textures)
+    {
+        ScopedCpuTimer cpuTimer(m_Profiler, m_Stages.StreamTextures);
+        ScopedGpuTimer gpuTimer(m_Profiler, m_pImmediateContext, m_Stages.StreamTextures);
+        m_Textures->Update(m_pImmediateContext, m_FrameArena);
+    }
 
-    for (int eye = 0; eye < 2; ++eye)
+    if (m_GpuCuller)
     {
-        m_pDevice->CreateTexture(eyeTexDesc, nullptr, &m_EyeTargets[eye].Color);
-        m_pDevice->CreateTexture(depthDesc, nullptr, &m_EyeTargets[eye].Depth);
+        // replaces the three stages below, with a CPU cost that does not grow with the objects
+        ScopedCpuTimer cpuTimer(m_Profiler, m_Stages.GpuCull);
+        ScopedGpuTimer gpuTimer(m_Profiler, m_pImmediateContext, m_Stages.GpuCull);
+        CullSceneOnGpu();
     }
+    else
+    {
+        {
+            ScopedCpuTimer timer(m_Profiler, m_Stages.Cull);
+            CullScene();
+        }
+
+        {
+            ScopedCpuTimer timer(m_Profiler, m_Stages.SelectLods);
+            SelectLods();
+        }
+
+        if (m_Desc.Instancing)
+        {
+            ScopedCpuTimer timer(m_Profiler, m_Stages.UpdateInstances);
+            UpdateInstances();
+        }
+        else
+        {
+            {
+                ScopedCpuTimer timer(m_Profiler, m_Stages.SortDraws);
+                BuildDrawQueue();
+            }
+
+            if (m_Desc.RingBufferConstants && m_RecordContexts.empty())
+            {
+                ScopedCpuTimer timer(m_Profiler, m_Stages.UpdateConstants);
+                UpdateDrawConstants();
+            }
+        }
+    }
+
+    if (m_Desc.Stereo == StereoMode::SinglePassInstanced)
+    {
+        ScopedCpuTimer cpuTimer(m_Profiler, m_Stages.RenderStereo);
+        ScopedGpuTimer gpuTimer(m_Profiler, m_pImmediateContext, m_Stages.RenderStereo);
+        RenderStereo();
+    }
+    else
+    {
+        for (int eye = 0; eye < 2; ++eye)
+        {
+            ScopedCpuTimer cpuTimer(m_Profiler, m_Stages.RenderEye[eye]);
+            ScopedGpuTimer gpuTimer(m_Profiler, m_pImmediateContext, m_Stages.RenderEye[eye]);
+            RenderEye(static_cast<vr::EVREye>(eye));
+        }
+    }
+    m_Resolution.EndFrame(m_pImmediateContext);
+
+    {
+        ScopedCpuTimer timer(m_Profiler, m_Stages.SubmitTextures);
+        SubmitTextures();
+    }
+    m_Pacer.EndFrame(m_Profiler.NowMs() - m_WorkStartMs);
+
+    // there is no swap chain to do this for us
+    m_pImmediateContext->FinishFrame();
+
+    // deferred contexts release their dynamic memory once their command lists have been submitted
+    for (RecordContext& context : m_RecordContexts)
+        context.pContext->FinishFrame();
+
+    m_EncoderStats = m_Encoder.GetStats();
+    for (const RecordContext& context : m_RecordContexts)
+        m_EncoderStats += context.Encoder->GetStats();
+
+    EndFrame();
 }
 
-void OpenVRInterface::CreateCubeResources()
+void OpenVRInterface::ReprojectFrame()
+{
+    UpdateDevices();
+
+    // the scene is not updated, so the snapshot is left for the next rendered frame
+    {
+        ScopedCpuTimer cpuTimer(m_Profiler, m_Stages.Reproject);
+        ScopedGpuTimer gpuTimer(m_Profiler, m_pImmediateContext, m_Stages.Reproject);
+
+        // predicted from the newest tracking data, as late as the late latch would
+        vr::TrackedDevicePose_t trackedDevicePoses[vr::k_unMaxTrackedDeviceCount];
+        const float             secondsToPhotons = m_pRuntime->GetPredictedSecondsToPhotons();
+        m_pRuntime->GetDeviceToAbsoluteTrackingPose(secondsToPhotons, trackedDevicePoses, vr::k_unMaxTrackedDeviceCount);
+        UpdateDevicePoses(trackedDevicePoses);
+        m_Pacer.SetPoseLatency(secondsToPhotons);
+
+        m_Reprojector->Warp(m_pImmediateContext, *m_EyeTargets, m_Camera);
+        m_Encoder.Invalidate();
+    }
+
+    // submitted with the bounds of the frame that was warped
+    m_ViewportWidth  = m_Reprojector->GetViewportWidth();
+    m_ViewportHeight = m_Reprojector->GetViewportHeight();
+    {
+        ScopedCpuTimer timer(m_Profiler, m_Stages.SubmitTextures);
+        SubmitTextures();
+    }
+    m_Pacer.EndReprojectedFrame();
+
+    m_pImmediateContext->FinishFrame();
+    m_EncoderStats = {};
+}
+
+void OpenVRInterface::EndFrame()
 {
-    // vertex/index buffer/normals
-    GEOMETRY_PRIMITIVE_VERTEX_FLAGS VertexComponents =
-        GEOMETRY_PRIMITIVE_VERTEX_FLAG_POSITION |
-        GEOMETRY_PRIMITIVE_VERTEX_FLAG_NORMAL;
+    // by hand, the frame starts in BeginFrame()
+    if (m_Profiler.IsActive())
+        m_Profiler.AddCpuSample(m_Stages.Frame, m_FrameStartMs, m_Profiler.NowMs() - m_FrameStartMs);
+    m_Profiler.EndFrame();
+
+    m_FrameArena.Reset();
+    m_FrameAllocations = AllocationTracker::EndFrame();
+    m_FrameBegun       = false;
+}
 
-    m_CubeVertexBuffer = TexturedCube::CreateVertexBuffer(m_pDevice, VertexComponents);
-    m_CubeIndexBuffer  = TexturedCube::CreateIndexBuffer(m_pDevice);
+void OpenVRInterface::CreateEyeResources(uint32_t width, uint32_t height)
+{
+    // the composite writes the resolved eye targets directly
+    if (m_Desc.Foveation.Enabled && m_Desc.EyeTargets.SampleCount > 1)
+        throw std::runtime_error("Foveation does not support multisampled eye targets");
 
-    // constant buffer
+    m_EyeTargets = std::make_unique<RenderTargetManager>(m_pDevice, m_Desc.EyeTargets, m_NumViews, width, height,
+                                                         TEX_FORMAT_RGBA8_UNORM, TEX_FORMAT_D32_FLOAT, !m_Desc.Foveation.Enabled);
+    if (m_Desc.Foveation.Enabled)
+    {
+        m_Foveation = std::make_unique<FoveatedRenderer>(m_pDevice, m_Desc.Foveation, m_NumViews, width, height,
+                                                         TEX_FORMAT_RGBA8_UNORM, TEX_FORMAT_D32_FLOAT);
+    }
+    if (m_Desc.Reprojection.Enabled)
+        m_Reprojector = std::make_unique<Reprojector>(m_pDevice, m_Desc.Reprojection, *m_EyeTargets);
+}
+
+void OpenVRInterface::CreateCubeResources()
+{
+    // in the same vertex format and arena as loaded meshes, so one pipeline draws both
+    m_Geometry = std::make_unique<GeometryArena>(m_pDevice, m_Desc.Geometry);
+    AddMesh(CreateGpuMesh(*m_Geometry, m_pImmediateContext, QuantizeMesh(CreateCubeMeshData()), "Cube"));
+
+    // constant buffers
     BufferDesc CBDesc;
     CBDesc.Name           = "Cube Constants CB";
     CBDesc.Size           = sizeof(ModelConstants);
@@ -68,27 +307,208 @@ void OpenVRInterface::CreateCubeResources()
     CBDesc.CPUAccessFlags = CPU_ACCESS_WRITE;
     m_pDevice->CreateBuffer(CBDesc, nullptr, &m_Constants);
 
-    // pipeline state
+    // updated on the immediate context only, so command lists from deferred contexts can use it
+    CBDesc.Name           = "Camera Constants CB";
+    CBDesc.Size           = sizeof(CameraConstants);
+    CBDesc.Usage          = USAGE_DEFAULT;
+    CBDesc.CPUAccessFlags = CPU_ACCESS_NONE;
+    m_pDevice->CreateBuffer(CBDesc, nullptr, &m_CameraConstants);
+
+    CBDesc.Name = "Pose Constants CB";
+    CBDesc.Size = sizeof(PoseConstants);
+    m_pDevice->CreateBuffer(CBDesc, nullptr, &m_PoseConstants);
+
+    m_FrameConstants = std::make_unique<FrameConstantAllocator>(m_pDevice, "Frame Constants CB");
+
+    // instance data
+    m_InstanceBuffer = std::make_unique<InstanceBuffer>(m_pDevice, m_NumViews, m_Desc.IndirectDraws);
+    if (m_Desc.GpuCulling && m_Desc.Instancing && m_InstanceBuffer->UsesIndirectDraws() && GpuCuller::IsSupported(m_pDevice))
+        m_GpuCuller = std::make_unique<GpuCuller>(m_pDevice, m_NumViews, m_InstanceBuffer->UsesStepRate());
+}
+
+uint32_t OpenVRInterface::LoadMesh(const char* Path)
+{
+    // uploading may repack the arena, which replaces its buffers behind the encoder
+    const uint32_t meshId = AddMesh(LoadMeshFile(*m_Geometry, m_pImmediateContext, Path));
+    m_Encoder.Invalidate();
+    return meshId;
+}
+
+void OpenVRInterface::UnloadMesh(uint32_t meshId)
+{
+    GpuMesh& mesh = m_Meshes[meshId];
+    if (meshId == CubeMeshId || mesh.Geometry == GeometryArena::InvalidHandle)
+        return;
+
+    m_Geometry->Free(mesh.Geometry);
+    mesh.Geometry = GeometryArena::InvalidHandle;
+}
+
+void OpenVRInterface::DefragmentGeometry()
+{
+    // repacking replaces the arena's buffers behind the encoder
+    m_Geometry->Defragment(m_pImmediateContext);
+    m_Encoder.Invalidate();
+}
+
+uint32_t OpenVRInterface::AddMesh(GpuMesh&& mesh)
+{
+    std::vector<Scene::MeshLod> sceneLods;
+    for (const MeshLod& lod : mesh.Lods)
+        sceneLods.push_back({lod.Error, lod.NumIndices / 3});
+    const uint32_t meshId = m_Scene.AddMesh(mesh.Bounds, sceneLods.data(), static_cast<uint32_t>(sceneLods.size()));
+
+    m_MeshFirstBatch.push_back(static_cast<uint32_t>(m_MeshInstances.size()));
+    for (const MeshLod& lod : mesh.Lods)
+    {
+        m_MeshInstances.push_back(std::make_unique<InstanceBatch>(mesh.Geometry, lod.FirstIndex, lod.NumIndices));
+        m_InstanceBatches.push_back(m_MeshInstances.back().get());
+    }
+    m_Meshes.push_back(std::move(mesh));
+    return meshId;
+}
+
+void OpenVRInterface::CreatePipelines()
+{
+    RefCntAutoPtr<IShaderSourceInputStreamFactory> pShaderSourceFactory;
+    m_pDevice->GetEngineFactory()->CreateDefaultShaderSourceStreamFactory(nullptr, &pShaderSourceFactory);
+
+    std::vector<std::function<void()>> jobs;
+    jobs.push_back([&]() {
+        CreateCubePSO(false, false, pShaderSourceFactory, &m_PSO);
+        m_PSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "CameraConstants")->Set(m_CameraConstants);
+        m_PSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "PoseConstants")->Set(m_PoseConstants);
+        m_PSO->CreateShaderResourceBinding(&m_SRB, true);
+        m_pModelConstantsVar = m_SRB->GetVariableByName(SHADER_TYPE_VERTEX, "ModelConstants");
+        m_pModelConstantsVar->Set(m_Constants);
+    });
+    jobs.push_back([&]() {
+        CreateCubePSO(true, false, pShaderSourceFactory, &m_InstancedPSO);
+        m_InstancedPSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "CameraConstants")->Set(m_CameraConstants);
+        m_InstancedPSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "PoseConstants")->Set(m_PoseConstants);
+        m_InstancedPSO->CreateShaderResourceBinding(&m_InstancedSRB, true);
+    });
+    jobs.push_back([&]() {
+        CreateCubePSO(false, true, pShaderSourceFactory, &m_TransparentPSO);
+        m_TransparentPSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "CameraConstants")->Set(m_CameraConstants);
+        m_TransparentPSO->GetStaticVariableByName(SHADER_TYPE_VERTEX, "PoseConstants")->Set(m_PoseConstants);
+    });
+    if (m_Foveation)
+        jobs.push_back([&]() { m_Foveation->CreatePipeline(*m_PipelineCache); });
+    if (m_Reprojector)
+        jobs.push_back([&]() { m_Reprojector->CreatePipeline(*m_PipelineCache); });
+    if (m_GpuCuller)
+        jobs.push_back([&]() { m_GpuCuller->CreatePipelines(*m_PipelineCache); });
+
+    // the pool's threads must not throw, the first error is rethrown once all jobs are done
+    std::exception_ptr error;
+    std::mutex         errorMutex;
+
+    ThreadPool workers(static_cast<uint32_t>(jobs.size()) - 1);
+    workers.ParallelFor(static_cast<uint32_t>(jobs.size()), [&](uint32_t jobIdx) {
+        try
+        {
+            jobs[jobIdx]();
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error)
+                error = std::current_exception();
+        }
+    });
+    if (error)
+        std::rethrow_exception(error);
+}
+
+bool OpenVRInterface::FinishPipelineCreation()
+{
+    if (m_PipelineCreation.valid())
+    {
+        if (m_PipelineCreation.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            return false;
+
+        // rethrows errors from pipeline creation
+        m_PipelineCreation.get();
+    }
+
+    CreateRecordContexts();
+    m_PipelineCache->Save();
+    m_PipelinesReady = true;
+    return true;
+}
+
+// shown until the pipeline states are ready
+static const float LoadingClearColor[] = {0.05f, 0.05f, 0.05f, 1.0f};
+
+void OpenVRInterface::RenderLoadingFrame()
+{
+    // the runtime expects a frame per vsync even without content, BeginFrame() waited for this one
+    UpdateDevices();
+
+    // textures already stream in while the pipelines are created
+    if (m_Textures)
+        m_Textures->Update(m_pImmediateContext, m_FrameArena);
+
+    for (uint32_t eye = 0; eye < 2; ++eye)
+    {
+        ITextureView* pRTV = m_EyeTargets->GetSubmitTexture(eye)->GetDefaultView(TEXTURE_VIEW_RENDER_TARGET);
+        m_pImmediateContext->SetRenderTargets(1, &pRTV, nullptr, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        m_pImmediateContext->ClearRenderTarget(pRTV, LoadingClearColor, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    }
+    SubmitTextures();
+
+    m_pImmediateContext->FinishFrame();
+}
+
+void OpenVRInterface::CreateRecordContexts()
+{
+    if (m_Desc.NumDeferredContexts == 0 || m_Desc.Instancing)
+        return;
+
+    m_RecordContexts.resize(m_Desc.NumDeferredContexts);
+    for (Uint32 i = 0; i < m_Desc.NumDeferredContexts; ++i)
+    {
+        RecordContext& context = m_RecordContexts[i];
+        context.pContext       = m_Desc.ppDeferredContexts[i];
+        if (context.pContext == nullptr || !context.pContext->GetDesc().IsDeferred)
+            throw std::runtime_error("Record contexts must be deferred contexts");
+
+        // SetBufferOffset() changes SRB state, so every thread needs its own SRB
+        m_PSO->CreateShaderResourceBinding(&context.SRB, true);
+        context.pModelConstantsVar = context.SRB->GetVariableByName(SHADER_TYPE_VERTEX, "ModelConstants");
+        context.Constants          = std::make_unique<FrameConstantAllocator>(m_pDevice, "Deferred Frame Constants CB");
+        context.Encoder            = std::make_unique<CommandEncoder>(context.pContext, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+    }
+
+    m_CommandLists.resize(m_RecordContexts.size());
+
+    // the thread calling RenderFrame() records the first chunk
+    m_RecordThreads = std::make_unique<ThreadPool>(m_Desc.NumDeferredContexts - 1);
+}
+
+void OpenVRInterface::CreateCubePSO(bool instanced, bool transparent, IShaderSourceInputStreamFactory* pShaderSourceFactory, IPipelineState** ppPSO)
+{
     GraphicsPipelineStateCreateInfo PSOCreateInfo;
-    PSOCreateInfo.PSODesc.Name = "VR Cube PSO";
+    PSOCreateInfo.PSODesc.Name = instanced ? "VR Cube Instanced PSO" : (transparent ? "VR Cube Transparent PSO" : "VR Cube PSO");
 
     // shaders
     ShaderCreateInfo ShaderCI;
     ShaderCI.SourceLanguage                  = SHADER_SOURCE_LANGUAGE_HLSL;
     ShaderCI.Desc.UseCombinedTextureSamplers = true;
+    ShaderCI.pShaderSourceStreamFactory      = pShaderSourceFactory;
 
-    RefCntAutoPtr<IShaderSourceInputStreamFactory> pShaderSourceFactory;
-    m_pDevice->GetEngineFactory()->CreateDefaultShaderSourceStreamFactory(nullptr, &pShaderSourceFactory);
-    ShaderCI.pShaderSourceStreamFactory = pShaderSourceFactory;
+    ShaderMacro Macros[] = {{"INSTANCED", instanced ? "1" : "0"}};
+    ShaderCI.Macros      = {Macros, _countof(Macros)};
 
     // vertex shader
     RefCntAutoPtr<IShader> pVS;
     {
         ShaderCI.Desc.ShaderType = SHADER_TYPE_VERTEX;
         ShaderCI.EntryPoint      = "main";
-        ShaderCI.Desc.Name       = "Cube VS";
+        ShaderCI.Desc.Name       = instanced ? "Cube Instanced VS" : "Cube VS";
         ShaderCI.Source          = VSSource;
-        m_pDevice->CreateShader(ShaderCI, &pVS);
+        m_PipelineCache->CreateShader(ShaderCI, &pVS);
     }
 
     // pixel shader
@@ -98,7 +518,7 @@ void OpenVRInterface::CreateCubeResources()
         ShaderCI.EntryPoint      = "main";
         ShaderCI.Desc.Name       = "Cube PS";
         ShaderCI.Source          = PSSource;
-        m_pDevice->CreateShader(ShaderCI, &pPS);
+        m_PipelineCache->CreateShader(ShaderCI, &pPS);
     }
 
     // pipeline setup
@@ -107,19 +527,47 @@ void OpenVRInterface::CreateCubeResources()
     PSOCreateInfo.GraphicsPipeline.RTVFormats[0]     = TEX_FORMAT_RGBA8_UNORM;
     PSOCreateInfo.GraphicsPipeline.DSVFormat         = TEX_FORMAT_D32_FLOAT;
     PSOCreateInfo.GraphicsPipeline.PrimitiveTopology = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    PSOCreateInfo.GraphicsPipeline.SmplDesc.Count    = static_cast<Uint8>(m_EyeTargets->GetSampleCount());
 
     // depth test
     PSOCreateInfo.GraphicsPipeline.DepthStencilDesc.DepthEnable      = True;
-    PSOCreateInfo.GraphicsPipeline.DepthStencilDesc.DepthWriteEnable = True;
+    PSOCreateInfo.GraphicsPipeline.DepthStencilDesc.DepthWriteEnable = transparent ? False : True;
+
+    // transparent objects are drawn back to front after the opaque ones, so they only need to blend
+    if (transparent)
+    {
+        RenderTargetBlendDesc& blend = PSOCreateInfo.GraphicsPipeline.BlendDesc.RenderTargets[0];
+        blend.BlendEnable            = True;
+        blend.SrcBlend               = BLEND_FACTOR_SRC_ALPHA;
+        blend.DestBlend              = BLEND_FACTOR_INV_SRC_ALPHA;
+        blend.SrcBlendAlpha          = BLEND_FACTOR_ONE;
+        blend.DestBlendAlpha         = BLEND_FACTOR_INV_SRC_ALPHA;
+    }
+
+    // input layout, per-instance data advances once per view unless it is replicated in the buffer
+    const Uint32 stepRate = m_InstanceBuffer->UsesStepRate() ? m_NumViews : 1;
 
-    // input layout
     LayoutElement LayoutElems[] =
         {
-            {0, 0, 3, VT_FLOAT32, False}, // Position
-            {1, 0, 3, VT_FLOAT32, False}  // Normal
-        };
+            {0, 0, 4, VT_INT16, True},    // Position, snorm within the mesh bounds
+            {1, 0, 2, VT_INT16, True},    // Normal, octahedral snorm
+            {12, 0, 2, VT_FLOAT16, False}, // TexCoord
+            // World
+            {2, 1, 4, VT_FLOAT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE, stepRate},
+            {3, 1, 4, VT_FLOAT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE, stepRate},
+            {4, 1, 4, VT_FLOAT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE, stepRate},
+            {5, 1, 4, VT_FLOAT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE, stepRate},
+            // NormalTransform
+            {6, 1, 4, VT_FLOAT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE, stepRate},
+            {7, 1, 4, VT_FLOAT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE, stepRate},
+            {8, 1, 4, VT_FLOAT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE, stepRate},
+            {9, 1, 4, VT_FLOAT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE, stepRate},
+            // Color
+            {10, 1, 4, VT_FLOAT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE, stepRate},
+            // PoseIndex
+            {11, 1, 1, VT_UINT32, False, INPUT_ELEMENT_FREQUENCY_PER_INSTANCE, stepRate}};
     PSOCreateInfo.GraphicsPipeline.InputLayout.LayoutElements = LayoutElems;
-    PSOCreateInfo.GraphicsPipeline.InputLayout.NumElements    = _countof(LayoutElems);
+    PSOCreateInfo.GraphicsPipeline.InputLayout.NumElements    = instanced ? _countof(LayoutElems) : 3;
 
     // shaders
     PSOCreateInfo.pVS = pVS;
@@ -127,179 +575,580 @@ void OpenVRInterface::CreateCubeResources()
 
     // resource layout
     ShaderResourceVariableDesc Variables[] = {
-        {SHADER_TYPE_VERTEX | SHADER_TYPE_PIXEL, "Constants", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}};
+        {SHADER_TYPE_VERTEX, "CameraConstants", SHADER_RESOURCE_VARIABLE_TYPE_STATIC},
+        {SHADER_TYPE_VERTEX, "PoseConstants", SHADER_RESOURCE_VARIABLE_TYPE_STATIC},
+        {SHADER_TYPE_VERTEX, "ModelConstants", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}};
     PSOCreateInfo.PSODesc.ResourceLayout.Variables    = Variables;
-    PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = _countof(Variables);
+    PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = instanced ? 2 : _countof(Variables);
 
-    m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, &m_PSO);
-    m_PSO->CreateShaderResourceBinding(&m_SRB, true);
-    m_SRB->GetVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_Constants);
+    m_PipelineCache->CreateGraphicsPipelineState(PSOCreateInfo, ppPSO);
+    if (*ppPSO == nullptr)
+        throw std::runtime_error("Failed to create cube pipeline state");
 }
 
-void OpenVRInterface::UpdateDevicePoses(vr::TrackedDevicePose_t* poses)
+void OpenVRInterface::UpdateDevices()
 {
-    m_LeftControllerMatrix  = float4x4::Identity();
-    m_RightControllerMatrix = float4x4::Identity();
-
-    for (uint32_t deviceIdx = 0; deviceIdx < vr::k_unMaxTrackedDeviceCount; ++deviceIdx)
+    vr::VREvent_t event;
+    while (m_pRuntime->PollNextEvent(&event))
     {
-        if (!poses[deviceIdx].bPoseIsValid)
-            continue;
+        m_Devices.HandleEvent(event);
+        m_Camera.HandleEvent(event);
+    }
 
-        vr::ETrackedDeviceClass deviceClass = m_pHMD->GetTrackedDeviceClass(deviceIdx);
+    if (m_Devices.CommitEvents())
+        RebuildDeviceDraws();
+}
+
+void OpenVRInterface::RebuildDeviceDraws()
+{
+    m_HMDSlot = m_Devices.FindSlot(vr::TrackedDeviceClass_HMD);
+
+    // every controller and tracker is drawn as a cube at its pose
+    m_DeviceDraws.clear();
+    for (uint32_t slot = 0; slot < m_Devices.GetNumActiveDevices() && m_DeviceDraws.size() < MaxDrawnDevices; ++slot)
+    {
+        const vr::ETrackedDeviceClass deviceClass = m_Devices.GetDevice(slot).Class;
         if (deviceClass == vr::TrackedDeviceClass_Controller)
-        {
-            vr::ETrackedControllerRole role = m_pHMD->GetControllerRoleForTrackedDeviceIndex(deviceIdx);
-            if (role == vr::TrackedControllerRole_LeftHand)
-            {
-                m_LeftControllerMatrix = ConvertSteamVRMatrix(poses[deviceIdx].mDeviceToAbsoluteTracking);
-            }
-            else if (role == vr::TrackedControllerRole_RightHand)
-            {
-                m_RightControllerMatrix = ConvertSteamVRMatrix(poses[deviceIdx].mDeviceToAbsoluteTracking);
-            }
-        }
-        else if (deviceClass == vr::TrackedDeviceClass_HMD)
-        {
-            m_HMDMatrix = ConvertSteamVRMatrix(poses[deviceIdx].mDeviceToAbsoluteTracking);
-        }
+            m_DeviceDraws.push_back({slot, float4(0.f, 0.f, 0.f, 1.0f)});
+        else if (deviceClass == vr::TrackedDeviceClass_GenericTracker)
+            m_DeviceDraws.push_back({slot, float4(0.1f, 0.1f, 0.5f, 1.0f)});
     }
 }
 
-void OpenVRInterface::RenderEye(vr::EVREye eye)
+void OpenVRInterface::UpdateDevicePoses(const vr::TrackedDevicePose_t* poses)
+{
+    m_Devices.UpdatePoses(poses, vr::k_unMaxTrackedDeviceCount);
+
+    // the view keeps the last valid HMD pose while tracking is lost
+    if (m_HMDSlot != TrackedDeviceRegistry::InvalidSlot && m_Devices.IsPoseValid(m_HMDSlot))
+        m_HMDMatrix = m_Devices.GetPose(m_HMDSlot);
+    m_Camera.Update(m_HMDMatrix);
+}
+
+void OpenVRInterface::UpdateCameraConstants(uint32_t firstEye, uint32_t numEyes, const float4* pClipTransforms)
+{
+    CameraConstants constants = {};
+    for (uint32_t eye = 0; eye < 2; ++eye)
+        constants.ClipTransform[eye] = pClipTransforms ? pClipTransforms[eye] : float4(1, 1, 0, 0);
+    constants.FirstEye = firstEye;
+    constants.NumEyes  = numEyes;
+    UpdateConstantBuffer(m_CameraConstants, &constants, sizeof(constants));
+}
+
+// same color for both eyes so that single- and multi-pass output match
+static const float EyeClearColor[] = {0.17f, 0.17f, 0.17f, 1.0f};
+
+void OpenVRInterface::BeginPass(ITextureView* pRTV, ITextureView* pDSV, uint32_t x, uint32_t width, uint32_t height, bool clearColor)
 {
-    const int eyeIdx = (eye == vr::Eye_Left) ? 0 : 1;
-    auto      pRTV   = m_EyeTargets[eyeIdx].Color->GetDefaultView(TEXTURE_VIEW_RENDER_TARGET);
-    auto      pDSV   = m_EyeTargets[eyeIdx].Depth->GetDefaultView(TEXTURE_VIEW_DEPTH_STENCIL);
+    m_PassX      = x;
+    m_PassWidth  = width;
+    m_PassHeight = height;
+
     m_pImmediateContext->SetRenderTargets(1, &pRTV, pDSV, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    SetPassViewport(m_pImmediateContext);
 
-    const float clearColor[] = {
-        eye == vr::Eye_Left ? 1.f : 0.17f,
-        eye == vr::Eye_Left ? 0.17f : 1.f,
-        eye == vr::Eye_Left ? 0.17f : 0.17f,
-        1.0f};
-    m_pImmediateContext->ClearRenderTarget(pRTV, clearColor, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    // clears cover the whole texture, there is no viewport to limit them to
+    if (clearColor)
+        m_pImmediateContext->ClearRenderTarget(pRTV, EyeClearColor, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
     m_pImmediateContext->ClearDepthStencil(pDSV, CLEAR_DEPTH_FLAG, 1.0f, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+}
+
+void OpenVRInterface::SetPassViewport(IDeviceContext* pContext)
+{
+    Viewport viewport(static_cast<float>(m_PassX), 0, static_cast<float>(m_PassWidth * m_NumViews), static_cast<float>(m_PassHeight));
+    pContext->SetViewports(1, &viewport, 0, 0);
+}
 
-    //// Get eye matrices
-    // auto     eyeToHead     = m_pHMD->GetEyeToHeadTransform(eye);
-    //float4x4 matEyeToHead  = ConvertSteamVRMatrix(eyeToHead);
-    //float4x4 matProjection = ConvertProjectionMatrix(m_pHMD->GetProjectionMatrix(eye, 0.025f, 1000.0f));
+void OpenVRInterface::UpdateConstantBuffer(IBuffer* pBuffer, const void* pData, Uint32 size)
+{
+    m_pImmediateContext->UpdateBuffer(pBuffer, 0, size, pData, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
 
-    auto MVP = GetCurrentViewProjectionMatrix(eye, m_pHMD, m_HMDMatrix);
-    // Render controllers
-    RenderController(m_LeftControllerMatrix * MVP);
-    RenderController(m_RightControllerMatrix * MVP);
+    // the SRB may not be committed again, and deferred contexts only verify the state
+    StateTransitionDesc barrier{pBuffer, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_CONSTANT_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE};
+    m_pImmediateContext->TransitionResourceStates(1, &barrier);
 }
 
-void OpenVRInterface::RenderController(const float4x4& matrix)
+void OpenVRInterface::LatchPoses()
 {
-    ModelConstants constants;
-    constants.WorldViewProj   = matrix;
-    constants.NormalTransform = matrix;
-    constants.Color           = float4(0.f, 0.f, 0.f, 1.0f);
+    if (m_PosesLatched)
+        return;
+    m_PosesLatched = true;
 
+    ScopedCpuTimer timer(m_Profiler, m_Stages.LatchPoses);
+    if (m_Desc.LateLatchPoses)
     {
-        MapHelper<ModelConstants> CBConstants(m_pImmediateContext, m_Constants, MAP_WRITE, MAP_FLAG_DISCARD);
-        *CBConstants = constants;
+        // same target time as WaitGetPoses(), but predicted from newer tracking data
+        vr::TrackedDevicePose_t trackedDevicePoses[vr::k_unMaxTrackedDeviceCount];
+        const float             secondsToPhotons = m_pRuntime->GetPredictedSecondsToPhotons();
+        m_pRuntime->GetDeviceToAbsoluteTrackingPose(secondsToPhotons, trackedDevicePoses, vr::k_unMaxTrackedDeviceCount);
+        UpdateDevicePoses(trackedDevicePoses);
+        m_Pacer.SetPoseLatency(secondsToPhotons);
+
+        const double latchedMs = m_Profiler.NowMs();
+        m_Profiler.AddCpuSample(m_Stages.LatchedLatencySaving, m_PosesFetchedMs, latchedMs - m_PosesFetchedMs);
+    }
+
+    PoseConstants constants;
+    for (uint32_t eye = 0; eye < 2; ++eye)
+        constants.ViewProj[eye] = m_Camera.GetViewProj(eye);
+    constants.DevicePose[0] = float4x4::Identity();
+    for (size_t i = 0; i < m_DeviceDraws.size(); ++i)
+    {
+        // devices without a valid pose are drawn at the origin
+        const uint32_t slot         = m_DeviceDraws[i].Slot;
+        constants.DevicePose[1 + i] = m_Devices.IsPoseValid(slot) ? m_Devices.GetPose(slot) : float4x4::Identity();
+    }
+    UpdateConstantBuffer(m_PoseConstants, &constants, sizeof(constants));
+}
+
+void OpenVRInterface::RenderEye(vr::EVREye eye)
+{
+    const uint32_t eyeIdx = (eye == vr::Eye_Left) ? 0 : 1;
+    RenderViews(eyeIdx, 1);
+    if (m_Reprojector)
+        m_Reprojector->Capture(m_pImmediateContext, *m_EyeTargets, eyeIdx, 1, m_Camera, m_ViewportWidth, m_ViewportHeight);
+}
+
+void OpenVRInterface::RenderStereo()
+{
+    // the viewport covers both halves, the vertex shader places each instance in its eye's half
+    RenderViews(0, 2);
+    if (m_Reprojector)
+        m_Reprojector->Capture(m_pImmediateContext, *m_EyeTargets, 0, 2, m_Camera, m_ViewportWidth, m_ViewportHeight);
+}
+
+void OpenVRInterface::RenderViews(uint32_t firstEye, uint32_t numEyes)
+{
+    auto           pRTV      = m_EyeTargets->GetRTV(firstEye);
+    const uint32_t viewportX = m_EyeTargets->GetViewportX(firstEye, m_ViewportWidth);
+    if (!m_Foveation)
+    {
+        // packed eyes share the color target, the right eye must not clear the left one
+        auto pDSV = m_EyeTargets->GetDSV();
+        BeginPass(pRTV, pDSV, viewportX, m_ViewportWidth, m_ViewportHeight, viewportX == 0);
+        UpdateCameraConstants(firstEye, numEyes);
+        RenderScene(pRTV, pDSV);
+        m_EyeTargets->EndEye(m_pImmediateContext, firstEye + numEyes - 1);
+        return;
+    }
+
+    // the foveation targets are per eye in multi-pass mode, like the eye targets without packing
+    const uint32_t target = firstEye;
+
+    // the scene is drawn once per pass with the same draw data, the inset pass relies on
+    // clipping to drop what lies outside of it
+    for (uint32_t pass = 0; pass < FoveatedRenderer::PASS_COUNT; ++pass)
+    {
+        const auto passId   = static_cast<FoveatedRenderer::PASS>(pass);
+        auto       pPassRTV = m_Foveation->GetRTV(passId, target);
+        auto       pPassDSV = m_Foveation->GetDSV(passId);
+        BeginPass(pPassRTV, pPassDSV, 0, m_Foveation->GetPassWidth(passId), m_Foveation->GetPassHeight(passId));
+
+        const float4 clipTransforms[2] = {m_Foveation->GetClipTransform(passId, 0), m_Foveation->GetClipTransform(passId, 1)};
+        UpdateCameraConstants(firstEye, numEyes, clipTransforms);
+        RenderScene(pPassRTV, pPassDSV);
+    }
+
+    // the composite writes every pixel of the eye viewport, so the eye target is not cleared
+    m_PassX      = viewportX;
+    m_PassWidth  = m_ViewportWidth;
+    m_PassHeight = m_ViewportHeight;
+    m_pImmediateContext->SetRenderTargets(1, &pRTV, nullptr, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    SetPassViewport(m_pImmediateContext);
+    m_Foveation->Composite(m_pImmediateContext, target, firstEye);
+    m_Encoder.Invalidate();
+}
+
+void OpenVRInterface::UpdateScene(const SceneSnapshot& scene)
+{
+    // rebuilding the static hierarchy is expensive, but only happens when the set changes
+    if (scene.StaticProps != m_StaticProps)
+    {
+        m_StaticProps = scene.StaticProps;
+        if (m_StaticProps)
+            m_Scene.SetStaticObjects(m_StaticProps->data(), static_cast<uint32_t>(m_StaticProps->size()));
+        else
+            m_Scene.SetStaticObjects(nullptr, 0);
+        m_SceneTick            = ~uint64_t{0};
+        m_StaticObjectsChanged = true;
+    }
+
+    // the simulation usually ticks slower than the display, most frames reuse the dynamic objects
+    if (scene.TickIndex == m_SceneTick)
+        return;
+    m_SceneTick             = scene.TickIndex;
+    m_DynamicObjectsChanged = true;
+
+    m_Scene.SetDynamicObjects(scene.Props.data(), static_cast<uint32_t>(scene.Props.size()));
+}
+
+void OpenVRInterface::CullScene()
+{
+    // uses the WaitGetPoses() head pose, the late-latched one differs by a few milliseconds of motion
+    m_VisibleObjects.clear();
+    m_CullStats = m_Scene.Cull(m_Camera.GetCullFrustum(), m_VisibleObjects);
+}
+
+void OpenVRInterface::GetLodView(float3& viewPos, float& pixelsPerUnit) const
+{
+    // between the eyes, with the sharper of the two projections at the full eye viewport
+    const float4x4& leftEye  = m_Camera.GetInvView(0);
+    const float4x4& rightEye = m_Camera.GetInvView(1);
+    viewPos                  = float3(leftEye._41 + rightEye._41, leftEye._42 + rightEye._42, leftEye._43 + rightEye._43) * 0.5f;
+
+    pixelsPerUnit = 0;
+    for (uint32_t eye = 0; eye < 2; ++eye)
+    {
+        const float4x4& proj = m_Camera.GetProj(eye);
+        pixelsPerUnit        = std::max(pixelsPerUnit, 0.5f * std::max(proj._11 * m_ViewportWidth, proj._22 * m_ViewportHeight));
+    }
+}
+
+void OpenVRInterface::SelectLods()
+{
+    float3 viewPos;
+    float  pixelsPerUnit;
+    GetLodView(viewPos, pixelsPerUnit);
+    m_LodStats = m_Scene.SelectLods(viewPos, pixelsPerUnit, m_Desc.MeshLods, m_VisibleObjects);
+}
+
+void OpenVRInterface::CullSceneOnGpu()
+{
+    // static objects only change with the snapshot's set, dynamic ones with the simulation tick
+    const uint32_t numStatic  = m_Scene.GetNumStaticObjects();
+    const uint32_t numObjects = m_Scene.GetNumObjects();
+    const uint32_t first      = m_StaticObjectsChanged ? 0 : numStatic;
+    if (m_StaticObjectsChanged || m_DynamicObjectsChanged)
+    {
+        m_GpuObjects.resize(numObjects - first);
+        for (uint32_t objIdx = first; objIdx < numObjects; ++objIdx)
+        {
+            GpuCuller::Object& object = m_GpuObjects[objIdx - first];
+            object.MeshId             = m_Scene.GetMeshId(objIdx);
+            object.World              = m_Meshes[object.MeshId].Dequantize * m_Scene.GetWorld(objIdx);
+            object.NormalTransform    = m_Scene.GetNormalTransform(objIdx);
+            object.Color              = m_Scene.GetColor(objIdx);
+            object.Sphere             = m_Scene.GetBoundingSphere(objIdx);
+            object.PoseIndex          = 0;
+            object.Flags              = 0;
+        }
+        m_GpuCuller->SetObjects(m_pImmediateContext, m_GpuObjects.data(), first, numObjects - first);
+        m_StaticObjectsChanged  = false;
+        m_DynamicObjectsChanged = false;
+    }
+
+    // the tracked devices follow every frame; they are placed by the pose buffer, so they are not tested
+    m_VisibleObjects.clear();
+    m_GpuObjects.resize(m_DeviceDraws.size());
+    for (Uint32 deviceDrawIdx = 0; deviceDrawIdx < m_DeviceDraws.size(); ++deviceDrawIdx)
+    {
+        const ModelConstants constants = GetDrawConstants(deviceDrawIdx);
+        GpuCuller::Object&   object    = m_GpuObjects[deviceDrawIdx];
+        object.MeshId                  = CubeMeshId;
+        object.World                   = constants.World;
+        object.NormalTransform         = constants.NormalTransform;
+        object.Color                   = constants.Color;
+        object.Sphere                  = float4(0, 0, 0, 0);
+        object.PoseIndex               = constants.PoseIndex;
+        object.Flags                   = GpuCuller::ObjectFlagAlwaysVisible;
+    }
+    const uint32_t numDevices = static_cast<uint32_t>(m_DeviceDraws.size());
+    m_GpuCuller->SetObjects(m_pImmediateContext, m_GpuObjects.data(), numObjects, numDevices);
+
+    GpuCuller::View view;
+    view.ViewProj[0] = m_Camera.GetViewProj(0);
+    view.ViewProj[1] = m_Camera.GetViewProj(1);
+    view.Lods        = m_Desc.MeshLods;
+    GetLodView(view.Position, view.PixelsPerUnit);
+    m_GpuCuller->Cull(m_pImmediateContext, *m_Geometry, m_Meshes, numObjects + numDevices, view);
+
+    // the compute passes changed the pipeline state behind the encoder
+    m_Encoder.Invalidate();
+
+    // the visible count arrives a few frames late, the level statistics are not gathered
+    m_CullStats            = {};
+    m_CullStats.NumVisible = m_GpuCuller->GetNumVisible();
+    m_CullStats.NumCulled  = numObjects + numDevices - std::min(m_CullStats.NumVisible, numObjects + numDevices);
+    m_LodStats             = {};
+}
+
+void OpenVRInterface::UpdateInstances()
+{
+    for (InstanceBatch* pBatch : m_InstanceBatches)
+        pBatch->Clear();
+    for (Uint32 drawIdx = 0; drawIdx < GetNumDraws(); ++drawIdx)
+    {
+        const uint32_t meshId = GetDrawMeshId(drawIdx);
+        if (m_Meshes[meshId].Geometry != GeometryArena::InvalidHandle)
+            m_InstanceBatches[m_MeshFirstBatch[meshId] + GetDrawLod(drawIdx)]->Add(GetDrawConstants(drawIdx));
     }
 
-    IBuffer* pVBs[] = {m_CubeVertexBuffer};
-    m_pImmediateContext->SetVertexBuffers(0, 1, pVBs, nullptr, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-    m_pImmediateContext->SetIndexBuffer(m_CubeIndexBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+    m_InstanceBuffer->Upload(m_pImmediateContext, *m_Geometry, m_InstanceBatches.data(), static_cast<Uint32>(m_InstanceBatches.size()));
+}
 
-    m_pImmediateContext->SetPipelineState(m_PSO);
-    m_SRB->GetVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_Constants);
-    m_pImmediateContext->CommitShaderResources(m_SRB, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+uint32_t OpenVRInterface::GetDrawMeshId(Uint32 drawIdx) const
+{
+    return drawIdx < m_VisibleObjects.size() ? m_Scene.GetMeshId(m_VisibleObjects[drawIdx]) : CubeMeshId;
+}
 
-    DrawIndexedAttribs drawAttrs{36, VT_UINT32, DRAW_FLAG_VERIFY_ALL};
-    m_pImmediateContext->DrawIndexed(drawAttrs);
+uint32_t OpenVRInterface::GetDrawLod(Uint32 drawIdx) const
+{
+    return drawIdx < m_VisibleObjects.size() ? m_Scene.GetLod(m_VisibleObjects[drawIdx]) : 0;
 }
 
-void OpenVRInterface::RenderModel(const float4x4& modelMat, const float4x4& viewProj)
+OpenVRInterface::ModelConstants OpenVRInterface::GetDrawConstants(Uint32 drawIdx) const
 {
+    const float4x4& dequantize = m_Meshes[GetDrawMeshId(drawIdx)].Dequantize;
+
     ModelConstants constants;
-    constants.WorldViewProj   = modelMat * viewProj;
-    constants.NormalTransform = (modelMat * viewProj).Inverse().Transpose();
-    constants.Color           = float4(0.5f, 0.8f, 0.3f, 1.0f);
+    if (drawIdx < m_VisibleObjects.size())
     {
-        MapHelper<ModelConstants> CBConstants(m_pImmediateContext, m_Constants, MAP_WRITE, MAP_FLAG_DISCARD);
-        *CBConstants = constants;
+        const uint32_t objIdx     = m_VisibleObjects[drawIdx];
+        constants.World           = dequantize * m_Scene.GetWorld(objIdx);
+        constants.NormalTransform = m_Scene.GetNormalTransform(objIdx);
+        constants.Color           = m_Scene.GetColor(objIdx);
+        constants.PoseIndex       = 0;
+        return constants;
     }
-    IBuffer* pVBs[] = {m_CubeVertexBuffer};
-    m_pImmediateContext->SetVertexBuffers(0, 1, pVBs, nullptr, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-    m_pImmediateContext->SetIndexBuffer(m_CubeIndexBuffer, 0, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-    m_pImmediateContext->SetPipelineState(m_PSO);
-    m_SRB->GetVariableByName(SHADER_TYPE_VERTEX, "Constants")->Set(m_Constants);
-    m_pImmediateContext->CommitShaderResources(m_SRB, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
-    
-    DrawIndexedAttribs drawAttrs{36, VT_UINT32, DRAW_FLAG_VERIFY_ALL};
-    m_pImmediateContext->DrawIndexed(drawAttrs);
+
+    // devices sit at their pose, which is only known once the poses are latched
+    const Uint32 deviceDrawIdx = drawIdx - static_cast<Uint32>(m_VisibleObjects.size());
+    constants.World           = dequantize;
+    constants.NormalTransform = float4x4::Identity();
+    constants.Color           = m_DeviceDraws[deviceDrawIdx].Color;
+    constants.PoseIndex       = 1 + deviceDrawIdx;
+    return constants;
 }
 
+void OpenVRInterface::BuildDrawQueue()
+{
+    float3 viewPos;
+    float  pixelsPerUnit;
+    GetLodView(viewPos, pixelsPerUnit);
 
-void OpenVRInterface::SubmitTextures()
+    m_DrawQueue.Begin(m_FrameArena, GetNumDraws());
+    for (Uint32 drawIdx = 0; drawIdx < GetNumDraws(); ++drawIdx)
+    {
+        float    depth       = 0;
+        uint32_t material    = 0;
+        bool     transparent = false;
+        if (drawIdx < m_VisibleObjects.size())
+        {
+            // to the nearest point of the bounding sphere, like the levels of detail
+            const uint32_t objIdx = m_VisibleObjects[drawIdx];
+            const float4   sphere = m_Scene.GetBoundingSphere(objIdx);
+            depth                 = length(float3(sphere.x, sphere.y, sphere.z) - viewPos) - sphere.w;
+            material              = m_Scene.GetMaterialId(objIdx);
+            transparent           = m_Scene.GetColor(objIdx).w < 1.0f;
+        }
+        else
+        {
+            // at the WaitGetPoses() pose, a few milliseconds from where the latched pose draws them
+            const uint32_t slot = m_DeviceDraws[drawIdx - m_VisibleObjects.size()].Slot;
+            if (m_Devices.IsPoseValid(slot))
+            {
+                const float4x4& pose = m_Devices.GetPose(slot);
+                depth                = length(float3(pose._41, pose._42, pose._43) - viewPos);
+            }
+        }
+
+        const RenderQueue::DRAW_PASS pass     = transparent ? RenderQueue::DRAW_PASS_TRANSPARENT : RenderQueue::DRAW_PASS_OPAQUE;
+        const DRAW_PIPELINE          pipeline = transparent ? DRAW_PIPELINE_TRANSPARENT : DRAW_PIPELINE_OPAQUE;
+        m_DrawQueue.Push(pass, pipeline, material, GetDrawMeshId(drawIdx), GetDrawLod(drawIdx), depth, drawIdx);
+    }
+
+    m_DrawQueue.Finish(m_SortThreads.get(), m_Desc.SortDraws);
+}
+
+void OpenVRInterface::UpdateDrawConstants()
 {
-    vr::Texture_t tex[2];
-    tex[0].eType = tex[1].eType = vr::TextureType_DirectX;
-    tex[0].eColorSpace = tex[1].eColorSpace = vr::ColorSpace_Gamma;
+    // constants do not depend on the eye, so both eyes draw from the same offsets; they are written
+    // in submission order, so the draws read them front to back
+    const Uint32 numPackets = m_DrawQueue.GetNumPackets();
+    m_FrameConstants->Begin(m_pImmediateContext, Uint64{m_FrameConstants->GetAlignedSize(sizeof(ModelConstants))} * numPackets);
+
+    m_DrawConstantOffsets.clear();
+    for (Uint32 packetIdx = 0; packetIdx < numPackets; ++packetIdx)
+        m_DrawConstantOffsets.push_back(m_FrameConstants->Allocate(GetDrawConstants(m_DrawQueue.GetPacket(packetIdx).DrawIdx)));
+
+    m_FrameConstants->End();
+
+    if (m_FrameConstants->WasRecreated())
+    {
+        // D3D11.1 binds constant buffer ranges in multiples of 256 bytes
+        m_pModelConstantsVar->SetBufferRange(m_FrameConstants->GetBuffer(), 0, m_FrameConstants->GetAlignedSize(sizeof(ModelConstants)), 0, SET_SHADER_RESOURCE_FLAG_ALLOW_OVERWRITE);
+    }
+}
+
+void OpenVRInterface::RenderScene(ITextureView* pRTV, ITextureView* pDSV)
+{
+    // deferred command lists are submitted after recording, so they latch later
+    if (m_RecordContexts.empty())
+        LatchPoses();
+
+    if (m_Desc.Instancing)
+    {
+        m_Encoder.SetPipelineState(m_InstancedPSO);
+        m_Encoder.CommitShaderResources(m_InstancedSRB);
+        if (m_GpuCuller)
+        {
+            m_GpuCuller->Draw(m_Encoder, *m_Geometry);
+            return;
+        }
+        m_InstanceBuffer->Draw(m_Encoder, *m_Geometry, m_InstanceBatches.data(), static_cast<Uint32>(m_InstanceBatches.size()));
+        return;
+    }
+
+    if (!m_RecordContexts.empty())
+    {
+        RenderSceneDeferred(pRTV, pDSV);
+        return;
+    }
 
-    for (int eye = 0; eye < 2; ++eye)
+    if (m_Desc.RingBufferConstants)
     {
-        tex[eye].handle = reinterpret_cast<void*>(m_EyeTargets[eye].Color->GetNativeHandle());
-        vr::VRCompositor()->Submit(static_cast<vr::EVREye>(eye), &tex[eye]);
+        for (Uint32 packetIdx = 0; packetIdx < m_DrawConstantOffsets.size(); ++packetIdx)
+            DrawMesh(m_Encoder, m_SRB, m_pModelConstantsVar, m_DrawConstantOffsets[packetIdx], m_DrawQueue.GetPacket(packetIdx));
+        return;
     }
+
+    for (Uint32 packetIdx = 0; packetIdx < m_DrawQueue.GetNumPackets(); ++packetIdx)
+    {
+        const RenderQueue::Packet& packet = m_DrawQueue.GetPacket(packetIdx);
+        DrawMesh(GetDrawConstants(packet.DrawIdx), GetDrawPipeline(packet.Pipeline), GetDrawMeshId(packet.DrawIdx), GetDrawLod(packet.DrawIdx));
+    }
+}
+
+void OpenVRInterface::RenderSceneDeferred(ITextureView* pRTV, ITextureView* pDSV)
+{
+    // deferred contexts only verify states, everything they use is transitioned here;
+    // the render targets already are by the clears, the constant buffers by their updates and
+    // the geometry arena when meshes were uploaded, except the pose buffer which is only written after recording
+    StateTransitionDesc barrier{m_PoseConstants, RESOURCE_STATE_UNKNOWN, RESOURCE_STATE_CONSTANT_BUFFER, STATE_TRANSITION_FLAG_UPDATE_STATE};
+    m_pImmediateContext->TransitionResourceStates(1, &barrier);
+
+    // chunks of the sorted packets, so each command list only changes state where the order does
+    const Uint32 numPackets = m_DrawQueue.GetNumPackets();
+    const Uint32 numChunks  = static_cast<Uint32>(m_RecordContexts.size());
+    m_RecordThreads->ParallelFor(numChunks, [&](uint32_t chunk) {
+        RecordChunk(m_RecordContexts[chunk], pRTV, pDSV, chunk * numPackets / numChunks, (chunk + 1) * numPackets / numChunks);
+    });
+
+    // the command lists only reference the pose buffer, so it can still be written after recording
+    LatchPoses();
+
+    ScopedCpuTimer timer(m_Profiler, m_Stages.ExecuteCommandLists);
+    for (Uint32 chunk = 0; chunk < numChunks; ++chunk)
+        m_CommandLists[chunk] = m_RecordContexts[chunk].CommandList;
+    m_pImmediateContext->ExecuteCommandLists(numChunks, m_CommandLists.data());
+    for (RecordContext& context : m_RecordContexts)
+        context.CommandList.Release();
+
+    // executing command lists resets the immediate context state
+    m_Encoder.Invalidate();
+}
+
+void OpenVRInterface::RecordChunk(RecordContext& context, ITextureView* pRTV, ITextureView* pDSV, Uint32 firstPacket, Uint32 endPacket)
+{
+    ScopedCpuTimer timer(m_Profiler, m_Stages.RecordChunk);
+
+    IDeviceContext* pContext = context.pContext;
+    pContext->Begin(0);
+    pContext->SetRenderTargets(1, &pRTV, pDSV, RESOURCE_STATE_TRANSITION_MODE_VERIFY);
+    SetPassViewport(pContext);
+
+    // dynamic buffer memory belongs to the context that mapped it, so each thread writes its own constants
+    context.Constants->Begin(pContext, Uint64{context.Constants->GetAlignedSize(sizeof(ModelConstants))} * (endPacket - firstPacket));
+    context.DrawConstantOffsets.clear();
+    for (Uint32 packetIdx = firstPacket; packetIdx < endPacket; ++packetIdx)
+        context.DrawConstantOffsets.push_back(context.Constants->Allocate(GetDrawConstants(m_DrawQueue.GetPacket(packetIdx).DrawIdx)));
+    context.Constants->End();
+
+    if (context.Constants->WasRecreated())
+        context.pModelConstantsVar->SetBufferRange(context.Constants->GetBuffer(), 0, context.Constants->GetAlignedSize(sizeof(ModelConstants)), 0, SET_SHADER_RESOURCE_FLAG_ALLOW_OVERWRITE);
+
+    // every command list starts with empty state
+    context.Encoder->Invalidate();
+    for (Uint32 packetIdx = firstPacket; packetIdx < endPacket; ++packetIdx)
+        DrawMesh(*context.Encoder, context.SRB, context.pModelConstantsVar, context.DrawConstantOffsets[packetIdx - firstPacket], m_DrawQueue.GetPacket(packetIdx));
+
+    pContext->FinishCommandList(&context.CommandList);
 }
 
-float4x4 OpenVRInterface::ConvertSteamVRMatrix(const vr::HmdMatrix34_t& mat)
+void OpenVRInterface::RenderModel(const float4x4& modelMat, const float4& color)
 {
-    return float4x4(
-        mat.m[0][0], mat.m[1][0], -mat.m[2][0], 0.0,
-        mat.m[0][1], mat.m[1][1], -mat.m[2][1], 0.0,
-        mat.m[0][2], mat.m[1][2], -mat.m[2][2], 0.0,
-        mat.m[0][3], mat.m[1][3], -mat.m[2][3], 1.0f); // flip z-axis
+    ModelConstants constants;
+    constants.World           = m_Meshes[CubeMeshId].Dequantize * modelMat;
+    constants.NormalTransform = ComputeNormalTransform(modelMat);
+    constants.Color           = color;
+    DrawMesh(constants, m_PSO, CubeMeshId, 0);
 }
 
-float4x4 GetHMDMatrixProjectionEye(vr::Hmd_Eye nEye, vr::IVRSystem* m_pHMD)
+void OpenVRInterface::DrawMesh(const ModelConstants& constants, IPipelineState* pPSO, uint32_t meshId, uint32_t lod)
 {
-    if (!m_pHMD)
-        return float4x4();
+    {
+        ScopedCpuTimer            timer(m_Profiler, m_Stages.UpdateConstants);
+        MapHelper<ModelConstants> CBConstants(m_pImmediateContext, m_Constants, MAP_WRITE, MAP_FLAG_DISCARD);
+        *CBConstants = constants;
+    }
 
-    vr::HmdMatrix44_t mat = m_pHMD->GetProjectionMatrix(nEye, 0.025f, 1000.0f);
+    // m_Constants stays bound to the SRB, mapping it does not require a recommit
+    SubmitMeshDraw(m_Encoder, m_SRB, pPSO, meshId, lod);
+}
 
-    // Adjust for left-handed system by flipping Z axis
-    return float4x4(
-        mat.m[0][0], mat.m[1][0], mat.m[2][0], mat.m[3][0],
-        mat.m[0][1], mat.m[1][1], mat.m[2][1], mat.m[3][1],
-        -mat.m[0][2], -mat.m[1][2], -mat.m[2][2], -mat.m[3][2], // Flip Z components
-        mat.m[0][3], mat.m[1][3], mat.m[2][3], mat.m[3][3]);
+void OpenVRInterface::DrawMesh(CommandEncoder& encoder, IShaderResourceBinding* pSRB, IShaderResourceVariable* pConstantsVar, Uint32 constantsOffset, const RenderQueue::Packet& packet)
+{
+    encoder.SetBufferOffset(pConstantsVar, constantsOffset);
+    SubmitMeshDraw(encoder, pSRB, GetDrawPipeline(packet.Pipeline), GetDrawMeshId(packet.DrawIdx), GetDrawLod(packet.DrawIdx));
 }
 
-float4x4 GetHMDMatrixPoseEye(vr::Hmd_Eye nEye, vr::IVRSystem *m_pHMD)
+void OpenVRInterface::SubmitMeshDraw(CommandEncoder& encoder, IShaderResourceBinding* pSRB, IPipelineState* pPSO, uint32_t meshId, uint32_t lod)
 {
-    if (!m_pHMD)
-        return float4x4();
+    const GpuMesh& mesh = m_Meshes[meshId];
+    if (mesh.Geometry == GeometryArena::InvalidHandle)
+        return;
 
-    vr::HmdMatrix34_t matEyeRight = m_pHMD->GetEyeToHeadTransform(nEye);
-    float4x4          matrixObj(
-        matEyeRight.m[0][0], matEyeRight.m[1][0], matEyeRight.m[2][0], 0.0,
-        matEyeRight.m[0][1], matEyeRight.m[1][1], matEyeRight.m[2][1], 0.0,
-        matEyeRight.m[0][2], matEyeRight.m[1][2], matEyeRight.m[2][2], 0.0,
-        matEyeRight.m[0][3], matEyeRight.m[1][3], matEyeRight.m[2][3], 1.0f);
+    // all meshes share the arena's buffers, so the encoder drops the rebinds between draws
+    const GeometryArena::Range& range  = m_Geometry->GetRange(mesh.Geometry);
+    IBuffer*                    pVBs[] = {m_Geometry->GetVertexBuffer()};
+    encoder.SetVertexBuffers(1, pVBs, nullptr);
+    encoder.SetIndexBuffer(m_Geometry->GetIndexBuffer(range.IndexType));
 
-    return matrixObj;
+    encoder.SetPipelineState(pPSO);
+    encoder.CommitShaderResources(pSRB);
+
+    // one instance per eye
+    DrawIndexedAttribs drawAttrs{mesh.Lods[lod].NumIndices, range.IndexType, DRAW_FLAG_VERIFY_ALL, m_NumViews,
+                                 range.FirstIndex + mesh.Lods[lod].FirstIndex, range.BaseVertex};
+    encoder.DrawIndexed(drawAttrs);
 }
 
-float4x4 GetCurrentViewProjectionMatrix(vr::Hmd_Eye nEye, vr::IVRSystem* m_pHMD, float4x4 m_HMDMatrix)
+void OpenVRInterface::SubmitTextures()
 {
-    return GetHMDMatrixProjectionEye(nEye, m_pHMD) * GetHMDMatrixPoseEye(nEye, m_pHMD) * m_HMDMatrix.Inverse();
+    vr::Texture_t tex[2];
+    tex[0].eType = tex[1].eType = GetTextureType(m_pDevice->GetDeviceInfo().Type);
+    tex[0].eColorSpace = tex[1].eColorSpace = vr::ColorSpace_Gamma;
+
+    // packed eyes submit the same texture with their part of it as bounds
+    for (uint32_t eye = 0; eye < 2; ++eye)
+    {
+        const vr::VRTextureBounds_t bounds = m_EyeTargets->GetSubmitBounds(eye, m_ViewportWidth, m_ViewportHeight);
+        tex[eye].handle                    = reinterpret_cast<void*>(m_EyeTargets->GetSubmitTexture(eye)->GetNativeHandle());
+        m_pRuntime->Submit(static_cast<vr::EVREye>(eye), &tex[eye], &bounds);
+    }
 }
 
-float4x4 OpenVRInterface::ConvertProjectionMatrix(const vr::HmdMatrix44_t& mat)
+vr::ETextureType OpenVRInterface::GetTextureType(RENDER_DEVICE_TYPE deviceType)
 {
-    return float4x4(
-        mat.m[0][0], mat.m[0][1], mat.m[0][2], mat.m[0][3],
-        mat.m[1][0], mat.m[1][1], mat.m[1][2], mat.m[1][3],
-        mat.m[2][0], mat.m[2][1], mat.m[2][2], mat.m[2][3],
-        mat.m[3][0], mat.m[3][1], mat.m[3][2], mat.m[3][3]);
-}
\ No newline at end of file
+    // SteamVR only gets D3D11 textures from Main.cpp. Other backends are used with
+    // SimulatedVRRuntime, which only needs a non-null native handle.
+    switch (deviceType)
+    {
+        case RENDER_DEVICE_TYPE_D3D11: return vr::TextureType_DirectX;
+        case RENDER_DEVICE_TYPE_D3D12: return vr::TextureType_DirectX12;
+        case RENDER_DEVICE_TYPE_VULKAN: return vr::TextureType_Vulkan;
+        case RENDER_DEVICE_TYPE_GL:
+        case RENDER_DEVICE_TYPE_GLES: return vr::TextureType_OpenGL;
+        default: return vr::TextureType_Invalid;
+    }
+}
@@ -1,105 +1,599 @@
+#pragma once
+
 #include "RenderDevice.h"
 #include "DeviceContext.h"
 #include "openvr.h"
+#include <future>
+#include <memory>
 #include <stdexcept>
+#include <vector>
 #include "RefCntAutoPtr.hpp"
 #include "BasicMath.hpp"
 #include <cassert>
 #include "MapHelper.hpp"
 #include "GraphicsUtilities.h"
-#include "TexturedCube.hpp"
+#include "VRRuntime.h"
+#include "FrameProfiler.h"
+#include "InstanceBatch.h"
+#include "FrameConstantAllocator.h"
+#include "CommandEncoder.h"
+#include "ThreadPool.h"
+#include "SceneSnapshot.h"
+#include "TrackedDeviceRegistry.h"
+#include "StereoCamera.h"
+#include "Scene.h"
+#include "DynamicResolution.h"
+#include "FramePacer.h"
+#include "FoveatedRenderer.h"
+#include "RenderTargetManager.h"
+#include "Reprojector.h"
+#include "PipelineCache.h"
+#include "RenderQueue.h"
+#include "FrameArena.h"
+#include "AllocationTracker.h"
+#include "TextureStreamer.h"
+#include "Mesh.h"
+#include "GpuCuller.h"
 
 using namespace Diligent;
 
-float4x4 GetCurrentViewProjectionMatrix(vr::Hmd_Eye nEye, vr::IVRSystem* m_pHMD, float4x4 m_HMDMatrix);
-float4x4 GetHMDMatrixPoseEye(vr::Hmd_Eye nEye, vr::IVRSystem* m_pHMD);
-float4x4 GetHMDMatrixProjectionEye(vr::Hmd_Eye nEye, vr::IVRSystem* m_pHMD);
+enum class StereoMode
+{
+    // one pass per eye into separate targets
+    MultiPass,
+
+    // both eyes in one pass into a side-by-side target, every draw is instanced once per eye
+    SinglePassInstanced
+};
+
+struct OpenVRInterfaceDesc
+{
+    StereoMode Stereo = StereoMode::SinglePassInstanced;
+
+    // draw all instances of a mesh with one instanced call instead of one draw per object
+    bool Instancing = true;
+
+    // with instancing: write the batches' draws into an indirect arguments buffer and submit them
+    // with one multi-draw per index size, if the device supports indirect draws
+    bool IndirectDraws = true;
+
+    // with indirect draws: cull, select levels of detail and write the instances in compute passes
+    // from objects kept on the GPU, falls back to the CPU path if compute shaders are not supported
+    bool GpuCulling = false;
+
+    // all meshes share the arena's vertex and index buffers
+    GeometryArenaDesc Geometry;
+
+    // without instancing: sub-allocate per-draw constants from one buffer mapped once per frame
+    // instead of mapping the constant buffer with DISCARD for every draw
+    bool RingBufferConstants = true;
+
+    // without instancing: split the draw list into one chunk per deferred context and record
+    // the chunks on worker threads, the command lists are executed in order on the immediate context
+    IDeviceContext* const* ppDeferredContexts  = nullptr;
+    Uint32                 NumDeferredContexts = 0;
+
+    // without instancing: submit the draws in the order of their sort keys instead of scene order,
+    // so draws sharing a pipeline, material and mesh follow each other; opaque objects are drawn
+    // front to back and transparent ones, with a color alpha below 1, back to front after them
+    bool SortDraws = true;
+
+    // threads besides the render thread for the draw sort, which only splits large draw lists
+    Uint32 NumSortThreads = 0;
+
+    // initial size of the arena for the frame's transient data, like the draw packets; frames that
+    // do not fit grow it, so this only saves the first frames from falling back to the heap
+    size_t FrameArenaSize = 256 << 10;
+
+    // re-query the predicted poses right before the scene's draws are submitted, instead of
+    // using the WaitGetPoses() ones; all draws read the view and controller poses from one buffer
+    bool LateLatchPoses = true;
+
+    // render into a sub-rectangle of the eye targets that shrinks when the GPU is over budget
+    DynamicResolutionDesc DynamicResolution;
+
+    // delay the frame's work after WaitGetPoses() until the latest start that still meets the deadline
+    FramePacingDesc FramePacing;
+
+    // draw distant objects with simplified index buffers of their meshes
+    MeshLodDesc MeshLods;
+
+    // multisampling and eye packing of the eye targets
+    EyeTargetDesc EyeTargets;
+
+    // render the periphery at reduced resolution and only an inset around the lens centers at full
+    // resolution, then composite both into the eye targets
+    FoveationDesc Foveation;
+
+    // when the frame pacer expects a frame to miss its deadline, submit the last frame warped to the
+    // newest poses instead of rendering it
+    ReprojectionDesc Reprojection;
+
+    // shaders and pipeline states are stored between launches when a cache file is set
+    PipelineCacheDesc PipelineCache;
+
+    // create the pipeline states on worker threads; until they are ready, RenderFrame() only
+    // submits a loading view. Otherwise Initialize() waits for them
+    bool AsyncPipelineCreation = true;
+
+    // decode textures on worker threads and upload their mips over several frames, also while loading
+    TextureStreamerDesc TextureStreaming;
+};
 
 class OpenVRInterface
 {
 public:
-    OpenVRInterface(IRenderDevice* pDevice, IDeviceContext* pContext) :
+    OpenVRInterface(IRenderDevice* pDevice, IDeviceContext* pContext, IVRRuntime* pRuntime, const OpenVRInterfaceDesc& Desc = {}) :
+        m_Desc(Desc),
+        m_pRuntime(pRuntime),
+        m_Devices(pRuntime),
+        m_Camera(pRuntime),
         m_pDevice(pDevice),
-        m_pImmediateContext(pContext)
+        m_pImmediateContext(pContext),
+        m_Encoder(pContext),
+        m_Resolution(pDevice, Desc.DynamicResolution, Desc.FramePacing.Enabled),
+        m_Pacer(Desc.FramePacing),
+        m_Profiler(pDevice),
+        m_FrameArena(Desc.FrameArenaSize)
     {
     }
 
     void Initialize();
 
-    void RenderFrame();
+    // maps a .rmesh file and uploads it, scene props refer to it by the returned mesh ID; the cube
+    // is mesh 0. Render thread only, between frames
+    uint32_t LoadMesh(const char* Path);
+
+    // frees the mesh's range in the geometry arena; objects that still refer to it are not drawn,
+    // and its ID is not reused. The cube cannot be unloaded
+    void UnloadMesh(uint32_t meshId);
+
+    // packs the geometry arena after meshes were unloaded, so later loads do not have to grow it.
+    // Render thread only, between frames
+    void DefragmentGeometry();
+
+    const GpuMesh& GetMesh(uint32_t meshId) const { return m_Meshes[meshId]; }
+
+    GeometryArena::Stats GetGeometryStats() const { return m_Geometry->GetStats(); }
+
+    // waits for the compositor and, with frame pacing, until the frame's work should start; acquiring
+    // the scene snapshot after this call makes it as new as the poses. RenderFrame() calls it if the
+    // frame has not begun yet
+    void BeginFrame();
+
+    // renders the scene snapshot in addition to the controllers; the snapshot is only read during the call
+    void RenderFrame(const SceneSnapshot& Scene);
+
+    // the pipeline states are still being created, frames show the loading view
+    bool IsLoading() const { return !m_PipelinesReady; }
+
+    const PipelineCache& GetPipelineCache() const { return *m_PipelineCache; }
+
+    // from the start of pipeline creation in Initialize() until the last pipeline state was created
+    double GetPipelineCreationMs() const { return m_PipelineCreationMs; }
+
+    // nullptr unless texture streaming is enabled
+    TextureStreamer* GetTextureStreamer() { return m_Textures.get(); }
+
+    FrameProfiler& GetProfiler() { return m_Profiler; }
+
+    // submitted and filtered state changes of the last frame, summed over all contexts
+    const CommandEncoder::Stats& GetEncoderStats() const { return m_EncoderStats; }
+
+    // visible and culled scene objects of the last frame
+    const Scene::CullStats& GetCullStats() const { return m_CullStats; }
+
+    // triangles of the last frame's visible objects with and without levels of detail, per view
+    const Scene::LodStats& GetLodStats() const { return m_LodStats; }
+
+    // packets, pipeline changes and sort time of the last frame's draw queue, empty with instancing
+    const RenderQueue::Stats& GetDrawQueueStats() const { return m_DrawQueue.GetStats(); }
+
+    // peak use and overflows of the arena for the frames' transient data
+    const FrameArena::Stats& GetFrameArenaStats() const { return m_FrameArena.GetStats(); }
+
+    // dropped and reprojected frames, start delay and latency of the last frame
+    const FramePacer::Stats& GetPacingStats() const { return m_Pacer.GetStats(); }
+
+    // heap allocations made during the last frame, always zero unless AllocationTracker::IsAvailable()
+    const AllocationTracker::Counts& GetFrameAllocations() const { return m_FrameAllocations; }
+
+    // resolution scale of the last frame, relative to the recommended render target size
+    float GetResolutionScale() const { return m_Resolution.GetScale(); }
+
+    // frames the application reprojected instead of rendering them, zero when reprojection is off
+    Reprojector::Stats GetReprojectionStats() const { return m_Reprojector ? m_Reprojector->GetStats() : Reprojector::Stats{}; }
+
+    // false if reprojection is off or only corrects rotation
+    bool IsReprojectionPositional() const { return m_Reprojector && m_Reprojector->IsPositional(); }
+
+    // GPU memory of all eye render targets, including the foveation passes and the reprojection copies
+    uint64_t GetEyeTargetMemory() const
+    {
+        return m_EyeTargets->GetMemoryUsage() + (m_Foveation ? m_Foveation->GetMemoryUsage() : 0) +
+            (m_Reprojector ? m_Reprojector->GetMemoryUsage() : 0);
+    }
+
+    // scene pixels of the last frame with and without foveation, zero when it is off
+    FoveatedRenderer::Stats GetFoveationStats() const { return m_Foveation ? m_Foveation->GetStats() : FoveatedRenderer::Stats{}; }
 
 private:
-    struct RenderTarget
+    struct ProfilerStages
     {
-        RefCntAutoPtr<ITexture> Color;
-        RefCntAutoPtr<ITexture> Depth;
+        uint32_t Frame;
+        uint32_t WaitGetPoses;
+        uint32_t FramePacing;
+        uint32_t UpdateDevicePoses;
+        uint32_t UpdateScene;
+        uint32_t StreamTextures;
+        uint32_t Cull;
+        uint32_t SelectLods;
+        uint32_t GpuCull;
+        uint32_t SortDraws;
+        uint32_t RenderEye[2];
+        uint32_t RenderStereo;
+        uint32_t UpdateConstants;
+        uint32_t UpdateInstances;
+        uint32_t RecordChunk;
+        uint32_t ExecuteCommandLists;
+        uint32_t LatchPoses;
+        uint32_t LatchedLatencySaving;
+        uint32_t Reproject;
+        uint32_t SubmitTextures;
     };
 
-    struct ModelConstants
+    // per-draw constants have the same layout as the per-instance data
+    using ModelConstants = InstanceData;
+
+    // pipelines of the non-instanced draws, by their ID in the draw queue's keys
+    enum DRAW_PIPELINE : uint32_t
     {
-        float4x4 WorldViewProj;
-        float4x4 NormalTransform;
+        DRAW_PIPELINE_OPAQUE = 0,
+        DRAW_PIPELINE_TRANSPARENT
+    };
+
+    // per-thread recording state, nothing in here is shared between threads
+    struct RecordContext
+    {
+        IDeviceContext*                         pContext = nullptr;
+        RefCntAutoPtr<IShaderResourceBinding>   SRB;
+        IShaderResourceVariable*                pModelConstantsVar = nullptr;
+        std::unique_ptr<FrameConstantAllocator> Constants;
+        std::unique_ptr<CommandEncoder>         Encoder;
+        std::vector<Uint32>                     DrawConstantOffsets;
+        RefCntAutoPtr<ICommandList>             CommandList;
+    };
+
+    struct CameraConstants
+    {
+        float4   ClipTransform[2]; // scale in xy, offset in zw, per eye
+        uint32_t FirstEye;
+        uint32_t NumEyes;
+        uint32_t Padding[2];
+    };
+
+    // controllers and trackers are drawn with it
+    static constexpr uint32_t CubeMeshId = 0;
+
+    // controllers and trackers beyond this are not drawn, must match DevicePose[] in the shader
+    static constexpr Uint32 MaxDrawnDevices = 16;
+
+    // written once per frame when the poses are latched, shared by all passes and draws;
+    // DevicePose[0] is the tracking origin, DevicePose[1 + i] belongs to m_DeviceDraws[i]
+    struct PoseConstants
+    {
+        float4x4 ViewProj[2];
+        float4x4 DevicePose[1 + MaxDrawnDevices];
+    };
+
+    struct DeviceDraw
+    {
+        uint32_t Slot; // in m_Devices
         float4   Color;
     };
 
-    vr::IVRSystem*  m_pHMD = nullptr;
-    IRenderDevice*  m_pDevice;
-    IDeviceContext* m_pImmediateContext;
-    RenderTarget    m_EyeTargets[2];
+    const OpenVRInterfaceDesc m_Desc;
+
+    IVRRuntime*           m_pRuntime;
+    TrackedDeviceRegistry m_Devices;
+    StereoCamera          m_Camera;
+    IRenderDevice*        m_pDevice;
+    IDeviceContext*       m_pImmediateContext;
+    CommandEncoder        m_Encoder;
+
+    CommandEncoder::Stats m_EncoderStats;
+
+    std::vector<RecordContext>  m_RecordContexts;
+    std::vector<ICommandList*>  m_CommandLists;
+    std::unique_ptr<ThreadPool> m_RecordThreads;
+
+    // the targets have the maximum size per eye, each frame renders into the top left viewport of
+    // an eye; with foveation the scene is rendered into the foveation targets and the eye targets have no depth
+    std::unique_ptr<RenderTargetManager> m_EyeTargets;
+    uint32_t                             m_NumViews        = 1;
+    uint32_t                             m_EyeTargetWidth  = 0;
+    uint32_t                             m_EyeTargetHeight = 0;
+    uint32_t                             m_ViewportWidth   = 0;
+    uint32_t                             m_ViewportHeight  = 0;
+    DynamicResolution                    m_Resolution;
+
+    // also counts dropped and reprojected frames while pacing is off
+    FramePacer m_Pacer;
+
+    std::unique_ptr<FoveatedRenderer> m_Foveation;
+
+    // copies every rendered frame, nullptr unless reprojection is enabled
+    std::unique_ptr<Reprojector> m_Reprojector;
+
+    // viewport of the pass being rendered, the size is per eye
+    uint32_t m_PassX      = 0;
+    uint32_t m_PassWidth  = 0;
+    uint32_t m_PassHeight = 0;
+
+    FrameProfiler  m_Profiler;
+    ProfilerStages m_Stages = {};
+
+    // indexed by mesh ID, like the scene's meshes and the instance batches
+    std::unique_ptr<GeometryArena> m_Geometry;
+    std::vector<GpuMesh>           m_Meshes;
 
-    RefCntAutoPtr<IBuffer>                m_CubeVertexBuffer;
-    RefCntAutoPtr<IBuffer>                m_CubeIndexBuffer;
     RefCntAutoPtr<IBuffer>                m_Constants;
+    RefCntAutoPtr<IBuffer>                m_CameraConstants;
+    RefCntAutoPtr<IBuffer>                m_PoseConstants;
     RefCntAutoPtr<IPipelineState>         m_PSO;
+    RefCntAutoPtr<IPipelineState>         m_TransparentPSO; // compatible with m_PSO's SRBs
     RefCntAutoPtr<IShaderResourceBinding> m_SRB;
+    IShaderResourceVariable*              m_pModelConstantsVar = nullptr;
+    RefCntAutoPtr<IPipelineState>         m_InstancedPSO;
+    RefCntAutoPtr<IShaderResourceBinding> m_InstancedSRB;
+
+    // one batch per mesh and level of detail, the levels of a mesh follow its first batch
+    std::unique_ptr<InstanceBuffer>             m_InstanceBuffer;
+    std::vector<std::unique_ptr<InstanceBatch>> m_MeshInstances;
+    std::vector<InstanceBatch*>                 m_InstanceBatches;
+    std::vector<uint32_t>                       m_MeshFirstBatch;
+
+    // replaces the culling and the instance batches when set; scene objects are uploaded when they change
+    std::unique_ptr<GpuCuller>     m_GpuCuller;
+    std::vector<GpuCuller::Object> m_GpuObjects;
+    bool                           m_StaticObjectsChanged  = true;
+    bool                           m_DynamicObjectsChanged = true;
+
+    std::unique_ptr<FrameConstantAllocator> m_FrameConstants;
+    std::vector<Uint32>                     m_DrawConstantOffsets; // indexed like the draw queue's packets
 
-    float4x4 m_HMDMatrix             = float4x4::Identity();
-    float4x4 m_LeftControllerMatrix  = float4x4::Identity();
-    float4x4 m_RightControllerMatrix = float4x4::Identity();
+    // transient data of the current frame, reset at its end
+    FrameArena                m_FrameArena;
+    AllocationTracker::Counts m_FrameAllocations;
+
+    // without instancing, the draws in submission order; the packets' pipelines are DRAW_PIPELINE values
+    RenderQueue                 m_DrawQueue;
+    std::unique_ptr<ThreadPool> m_SortThreads;
+
+    // nothing that uses the pipeline states may run before m_PipelinesReady is set
+    std::unique_ptr<PipelineCache> m_PipelineCache;
+    std::future<void>              m_PipelineCreation;
+    bool                           m_PipelinesReady     = false;
+    double                         m_PipelineCreationMs = 0;
+
+    std::unique_ptr<TextureStreamer> m_Textures;
+
+    // objects of the last consumed snapshot, and the ones visible this frame
+    Scene                                         m_Scene;
+    std::shared_ptr<const std::vector<SceneProp>> m_StaticProps;
+    uint64_t                                      m_SceneTick = ~uint64_t{0};
+    std::vector<uint32_t>                         m_VisibleObjects;
+    Scene::CullStats                              m_CullStats;
+    Scene::LodStats                               m_LodStats;
+
+    float4x4 m_HMDMatrix = float4x4::Identity();
+    uint32_t m_HMDSlot   = TrackedDeviceRegistry::InvalidSlot;
+
+    std::vector<DeviceDraw> m_DeviceDraws;
+
+    bool   m_PosesLatched   = false;
+    double m_PosesFetchedMs = 0;
+
+    // the frame between BeginFrame() and EndFrame(), its work starts after the pacing delay
+    bool                    m_FrameBegun = false;
+    vr::TrackedDevicePose_t m_FramePoses[vr::k_unMaxTrackedDeviceCount];
+    double                  m_FrameStartMs = 0;
+    double                  m_WorkStartMs  = 0;
 
     void CreateEyeResources(uint32_t width, uint32_t height);
 
     void CreateCubeResources();
 
-    void UpdateDevicePoses(vr::TrackedDevicePose_t* poses);
+    uint32_t AddMesh(GpuMesh&& mesh);
+
+    // transparent pipelines blend with the target and do not write depth
+    void CreateCubePSO(bool instanced, bool transparent, IShaderSourceInputStreamFactory* pShaderSourceFactory, IPipelineState** ppPSO);
+
+    // creates every pipeline state and the bindings that depend on them, in parallel; runs on
+    // its own thread with asynchronous creation
+    void CreatePipelines();
+
+    // completes pipeline creation once it has finished, returns false while it is still running
+    bool FinishPipelineCreation();
+
+    // clears the eye targets and submits them, keeps the runtime's frame loop going while loading
+    void RenderLoadingFrame();
+
+    // submits the last rendered frame warped to the newest poses instead of rendering one
+    void ReprojectFrame();
+
+    // profiles and resets what BeginFrame() started
+    void EndFrame();
+
+    void CreateRecordContexts();
+
+    // picks up device and eye changes, slots and draws only change here at the start of a frame
+    void UpdateDevices();
+
+    void RebuildDeviceDraws();
+
+    void UpdateDevicePoses(const vr::TrackedDevicePose_t* poses);
+
+    void UpdateScene(const SceneSnapshot& scene);
+
+    // culls once for both eyes, against the frustum that contains both
+    void CullScene();
+
+    // also once for both eyes, from between them
+    void SelectLods();
+
+    // the view position and pixels per unit at unit distance the levels of detail are selected for
+    void GetLodView(float3& viewPos, float& pixelsPerUnit) const;
+
+    // culling, level selection and instance writes in one go, with the GPU culler
+    void CullSceneOnGpu();
+
+    // pClipTransforms holds one transform per eye, the view is not transformed without them
+    void UpdateCameraConstants(uint32_t firstEye, uint32_t numEyes, const float4* pClipTransforms = nullptr);
+
+    // binds the pass's targets, sets its viewport and clears them; the color target is kept when
+    // another eye was already rendered into it
+    void BeginPass(ITextureView* pRTV, ITextureView* pDSV, uint32_t x, uint32_t width, uint32_t height, bool clearColor = true);
+
+    // the current pass's viewport, both eyes side by side in single-pass mode; must follow SetRenderTargets()
+    void SetPassViewport(IDeviceContext* pContext);
+
+    void UpdateConstantBuffer(IBuffer* pBuffer, const void* pData, Uint32 size);
+
+    // writes the pose buffer once per frame, right before the first commands reading it are submitted
+    void LatchPoses();
 
     void RenderEye(vr::EVREye eye);
 
-    void RenderController(const float4x4& matrix);
+    void RenderStereo();
 
-    void RenderModel(const float4x4& modelMat, const float4x4& viewProj);
+    // renders numEyes eyes in one pass, directly or through the foveation passes
+    void RenderViews(uint32_t firstEye, uint32_t numEyes);
 
+    void RenderScene(ITextureView* pRTV, ITextureView* pDSV);
 
-    void SubmitTextures();
+    void RenderSceneDeferred(ITextureView* pRTV, ITextureView* pDSV);
+
+    // records the draw queue's packets [firstPacket, endPacket)
+    void RecordChunk(RecordContext& context, ITextureView* pRTV, ITextureView* pDSV, Uint32 firstPacket, Uint32 endPacket);
+
+    void UpdateInstances();
+
+    // one packet per draw, sorted unless SortDraws is off
+    void BuildDrawQueue();
+
+    void UpdateDrawConstants();
+
+    Uint32 GetNumDraws() const { return static_cast<Uint32>(m_VisibleObjects.size() + m_DeviceDraws.size()); }
+
+    uint32_t GetDrawMeshId(Uint32 drawIdx) const;
+    uint32_t GetDrawLod(Uint32 drawIdx) const;
 
-    static float4x4 ConvertSteamVRMatrix(const vr::HmdMatrix34_t& mat);
+    // the world transform includes the mesh's dequantization
+    ModelConstants GetDrawConstants(Uint32 drawIdx) const;
 
-    static float4x4 ConvertProjectionMatrix(const vr::HmdMatrix44_t& mat);
+    void RenderModel(const float4x4& modelMat, const float4& color);
+
+    void DrawMesh(const ModelConstants& constants, IPipelineState* pPSO, uint32_t meshId, uint32_t lod);
+
+    // draws a packet of the draw queue
+    void DrawMesh(CommandEncoder& encoder, IShaderResourceBinding* pSRB, IShaderResourceVariable* pConstantsVar, Uint32 constantsOffset, const RenderQueue::Packet& packet);
+
+    void SubmitMeshDraw(CommandEncoder& encoder, IShaderResourceBinding* pSRB, IPipelineState* pPSO, uint32_t meshId, uint32_t lod);
+
+    IPipelineState* GetDrawPipeline(uint32_t pipeline) const { return pipeline == DRAW_PIPELINE_TRANSPARENT ? m_TransparentPSO : m_PSO; }
+
+    void SubmitTextures();
+
+    static vr::ETextureType GetTextureType(RENDER_DEVICE_TYPE deviceType);
 
     const char* VSSource = R"(
 struct VSInput
 {
-    float3 Pos   : ATTRIB0;
-    float3 Norm  : ATTRIB1;
+    // quantized, see QuantizedVertex; the dequantization is part of World
+    float4 Pos    : ATTRIB0;
+    float2 Norm   : ATTRIB1;
+    float2 UV     : ATTRIB12;
+#if INSTANCED
+    float4 World0 : ATTRIB2;
+    float4 World1 : ATTRIB3;
+    float4 World2 : ATTRIB4;
+    float4 World3 : ATTRIB5;
+    float4 Normal0 : ATTRIB6;
+    float4 Normal1 : ATTRIB7;
+    float4 Normal2 : ATTRIB8;
+    float4 Normal3 : ATTRIB9;
+    float4 Color  : ATTRIB10;
+    uint   PoseIndex : ATTRIB11;
+#endif
+    uint   InstID : SV_InstanceID;
 };
 
 struct PSInput
 {
-    float4 Pos   : SV_POSITION;
-    float3 Norm  : NORMAL;
+    float4 Pos      : SV_POSITION;
+    float3 Norm     : NORMAL;
+    float4 Color    : COLOR;
+    float  ClipDist : SV_ClipDistance0;
 };
 
-cbuffer Constants
+cbuffer CameraConstants
 {
-    float4x4 WorldViewProj;
-    float4x4 NormalTransform;
+    float4 ClipTransform[2];
+    uint FirstEye;
+    uint NumEyes;
+};
+
+cbuffer PoseConstants
+{
+    row_major float4x4 ViewProj[2];
+    row_major float4x4 DevicePose[17];
+};
+
+float3 DecodeOctahedral(float2 e)
+{
+    float3 n = float3(e, 1.0 - abs(e.x) - abs(e.y));
+    float  t = saturate(-n.z);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+#if !INSTANCED
+cbuffer ModelConstants
+{
+    row_major float4x4 World;
+    row_major float4x4 NormalTransform;
     float4 Color;
+    uint   PoseIndex;
 };
+#endif
 
 void main(in VSInput VSIn, out PSInput PSOut)
 {
-    PSOut.Pos = mul(float4(VSIn.Pos, 1.0), WorldViewProj);
-    PSOut.Norm = mul(VSIn.Norm, (float3x3)NormalTransform);
+#if INSTANCED
+    float4x4 World           = float4x4(VSIn.World0, VSIn.World1, VSIn.World2, VSIn.World3);
+    float4x4 NormalTransform = float4x4(VSIn.Normal0, VSIn.Normal1, VSIn.Normal2, VSIn.Normal3);
+    float4   Color           = VSIn.Color;
+    uint     PoseIndex       = VSIn.PoseIndex;
+#endif
+    uint eye = FirstEye + VSIn.InstID % NumEyes;
+
+    // device poses are rigid, so they transform normals as well
+    float4x4 Pose = DevicePose[PoseIndex];
+    float4   pos  = mul(mul(mul(float4(VSIn.Pos.xyz, 1.0), World), Pose), ViewProj[eye]);
+    pos.xy = pos.xy * ClipTransform[eye].xy + ClipTransform[eye].zw * pos.w;
+    PSOut.ClipDist = 1.0;
+    if (NumEyes > 1)
+    {
+        // squeeze into this eye's half of the side-by-side target and clip against the other half
+        pos.x = pos.x * 0.5 + (eye == 0 ? -0.5 : 0.5) * pos.w;
+        PSOut.ClipDist = eye == 0 ? -pos.x : pos.x;
+    }
+
+    PSOut.Pos   = pos;
+    PSOut.Norm  = mul(mul(DecodeOctahedral(VSIn.Norm), (float3x3)NormalTransform), (float3x3)Pose);
+    PSOut.Color = Color;
 }
 )";
 
@@ -108,17 +602,13 @@ struct PSInput
 {
     float4 Pos   : SV_POSITION;
     float3 Norm  : NORMAL;
+    float4 Color : COLOR;
 };
 
-cbuffer Constants
-{
-    float4x4 WorldViewProj;
-    float4x4 NormalTransform;
-    float4 Color;
-};
+// the alpha only matters to the transparent pipeline, which blends with it
 float4 main(in PSInput PSIn) : SV_TARGET
 {
-    return float4(Color.rgb, 1.f);
+    return PSIn.Color;
 }
 )";
 };
\ No newline at end of file
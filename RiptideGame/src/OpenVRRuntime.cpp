@@ -0,0 +1,101 @@
+#include "OpenVRRuntime.h"
+#include <stdexcept>
+#include <string>
+
+OpenVRRuntime::~OpenVRRuntime()
+{
+    if (m_pHMD)
+        vr::VR_Shutdown();
+}
+
+void OpenVRRuntime::Initialize()
+{
+    vr::EVRInitError eError = vr::VRInitError_None;
+    m_pHMD                  = vr::VR_Init(&eError, vr::VRApplication_Scene);
+    if (eError != vr::VRInitError_None)
+    {
+        m_pHMD = nullptr;
+        throw std::runtime_error(std::string("VR_Init failed: ") + vr::VR_GetVRInitErrorAsEnglishDescription(eError));
+    }
+
+    m_pCompositor = vr::VRCompositor();
+    if (!m_pCompositor)
+        throw std::runtime_error("Failed to obtain VR compositor");
+
+    // display timing does not change while the HMD is connected
+    const float displayFrequency = m_pHMD->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_DisplayFrequency_Float);
+    if (displayFrequency > 0.f)
+        m_FrameDuration = 1.f / displayFrequency;
+    m_VSyncToPhotons = m_pHMD->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_SecondsFromVsyncToPhotons_Float);
+}
+
+void OpenVRRuntime::GetRecommendedRenderTargetSize(uint32_t* pWidth, uint32_t* pHeight)
+{
+    m_pHMD->GetRecommendedRenderTargetSize(pWidth, pHeight);
+}
+
+vr::HmdMatrix44_t OpenVRRuntime::GetProjectionMatrix(vr::EVREye eye, float nearZ, float farZ)
+{
+    return m_pHMD->GetProjectionMatrix(eye, nearZ, farZ);
+}
+
+vr::HmdMatrix34_t OpenVRRuntime::GetEyeToHeadTransform(vr::EVREye eye)
+{
+    return m_pHMD->GetEyeToHeadTransform(eye);
+}
+
+vr::ETrackedDeviceClass OpenVRRuntime::GetTrackedDeviceClass(vr::TrackedDeviceIndex_t deviceIdx)
+{
+    return m_pHMD->GetTrackedDeviceClass(deviceIdx);
+}
+
+vr::ETrackedControllerRole OpenVRRuntime::GetControllerRoleForTrackedDeviceIndex(vr::TrackedDeviceIndex_t deviceIdx)
+{
+    return m_pHMD->GetControllerRoleForTrackedDeviceIndex(deviceIdx);
+}
+
+uint32_t OpenVRRuntime::GetStringTrackedDeviceProperty(vr::TrackedDeviceIndex_t deviceIdx, vr::ETrackedDeviceProperty prop, char* pValue, uint32_t bufferSize)
+{
+    vr::ETrackedPropertyError error = vr::TrackedProp_Success;
+    const uint32_t            length = m_pHMD->GetStringTrackedDeviceProperty(deviceIdx, prop, pValue, bufferSize, &error);
+    return error == vr::TrackedProp_Success ? length : 0;
+}
+
+bool OpenVRRuntime::PollNextEvent(vr::VREvent_t* pEvent)
+{
+    return m_pHMD->PollNextEvent(pEvent, sizeof(vr::VREvent_t));
+}
+
+vr::EVRCompositorError OpenVRRuntime::WaitGetPoses(vr::TrackedDevicePose_t* pRenderPoses, uint32_t numPoses)
+{
+    return m_pCompositor->WaitGetPoses(pRenderPoses, numPoses, nullptr, 0);
+}
+
+float OpenVRRuntime::GetFrameDuration()
+{
+    return m_FrameDuration;
+}
+
+float OpenVRRuntime::GetPredictedSecondsToPhotons()
+{
+    float secondsSinceLastVSync = 0.f;
+    m_pHMD->GetTimeSinceLastVsync(&secondsSinceLastVSync, nullptr);
+    return m_FrameDuration - secondsSinceLastVSync + m_VSyncToPhotons;
+}
+
+void OpenVRRuntime::GetDeviceToAbsoluteTrackingPose(float predictedSecondsToPhotons, vr::TrackedDevicePose_t* pPoses, uint32_t numPoses)
+{
+    m_pHMD->GetDeviceToAbsoluteTrackingPose(m_pCompositor->GetTrackingSpace(), predictedSecondsToPhotons, pPoses, numPoses);
+}
+
+bool OpenVRRuntime::GetFrameTiming(vr::Compositor_FrameTiming* pTiming, uint32_t framesAgo)
+{
+    // the compositor checks the size against its version of the struct
+    pTiming->m_nSize = sizeof(vr::Compositor_FrameTiming);
+    return m_pCompositor->GetFrameTiming(pTiming, framesAgo);
+}
+
+vr::EVRCompositorError OpenVRRuntime::Submit(vr::EVREye eye, const vr::Texture_t* pTexture, const vr::VRTextureBounds_t* pBounds)
+{
+    return m_pCompositor->Submit(eye, pTexture, pBounds);
+}
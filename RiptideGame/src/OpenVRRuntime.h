@@ -0,0 +1,48 @@
+#pragma once
+
+#include "VRRuntime.h"
+
+class OpenVRRuntime final : public IVRRuntime
+{
+public:
+    OpenVRRuntime() = default;
+    ~OpenVRRuntime() override;
+
+    OpenVRRuntime(const OpenVRRuntime&) = delete;
+    OpenVRRuntime& operator=(const OpenVRRuntime&) = delete;
+
+    void Initialize();
+
+    void GetRecommendedRenderTargetSize(uint32_t* pWidth, uint32_t* pHeight) override;
+
+    vr::HmdMatrix44_t GetProjectionMatrix(vr::EVREye eye, float nearZ, float farZ) override;
+
+    vr::HmdMatrix34_t GetEyeToHeadTransform(vr::EVREye eye) override;
+
+    vr::ETrackedDeviceClass GetTrackedDeviceClass(vr::TrackedDeviceIndex_t deviceIdx) override;
+
+    vr::ETrackedControllerRole GetControllerRoleForTrackedDeviceIndex(vr::TrackedDeviceIndex_t deviceIdx) override;
+
+    uint32_t GetStringTrackedDeviceProperty(vr::TrackedDeviceIndex_t deviceIdx, vr::ETrackedDeviceProperty prop, char* pValue, uint32_t bufferSize) override;
+
+    bool PollNextEvent(vr::VREvent_t* pEvent) override;
+
+    vr::EVRCompositorError WaitGetPoses(vr::TrackedDevicePose_t* pRenderPoses, uint32_t numPoses) override;
+
+    float GetFrameDuration() override;
+
+    float GetPredictedSecondsToPhotons() override;
+
+    void GetDeviceToAbsoluteTrackingPose(float predictedSecondsToPhotons, vr::TrackedDevicePose_t* pPoses, uint32_t numPoses) override;
+
+    bool GetFrameTiming(vr::Compositor_FrameTiming* pTiming, uint32_t framesAgo) override;
+
+    vr::EVRCompositorError Submit(vr::EVREye eye, const vr::Texture_t* pTexture, const vr::VRTextureBounds_t* pBounds) override;
+
+private:
+    vr::IVRSystem*     m_pHMD        = nullptr;
+    vr::IVRCompositor* m_pCompositor = nullptr;
+
+    float m_FrameDuration  = 1.f / 90.f;
+    float m_VSyncToPhotons = 0.f;
+};
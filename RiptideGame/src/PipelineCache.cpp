@@ -0,0 +1,143 @@
+#include "PipelineCache.h"
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+#include "ArchiverFactoryLoader.h"
+#include "DataBlobImpl.hpp"
+
+PipelineCache::PipelineCache(IRenderDevice* pDevice, const PipelineCacheDesc& Desc) :
+    m_pDevice(pDevice),
+    m_ContentVersion(Desc.ContentVersion)
+{
+    if (Desc.FilePath == nullptr)
+        return;
+
+#if EXPLICITLY_LOAD_ARCHIVER_FACTORY_DLL
+    auto GetArchiverFactory = LoadArchiverFactory();
+    if (!GetArchiverFactory)
+        throw std::runtime_error("Failed to load archiver factory");
+#endif
+
+    RenderStateCacheCreateInfo cacheCI;
+    cacheCI.pDevice          = pDevice;
+    cacheCI.pArchiverFactory = GetArchiverFactory();
+    cacheCI.LogLevel         = RENDER_STATE_CACHE_LOG_LEVEL_DISABLED;
+    CreateRenderStateCache(cacheCI, &m_Cache);
+    if (!m_Cache)
+        throw std::runtime_error("Failed to create render state cache");
+
+    m_FilePath = std::string(Desc.FilePath) + "_" + GetDeviceTypeName(pDevice->GetDeviceInfo().Type) + ".bin";
+    Load();
+}
+
+void PipelineCache::Load()
+{
+    // a missing file is a cold start, not an error
+    std::ifstream file(m_FilePath, std::ios::binary | std::ios::ate);
+    if (!file)
+        return;
+
+    const std::streamsize size = file.tellg();
+    if (size <= 0)
+        return;
+
+    RefCntAutoPtr<DataBlobImpl> pData = DataBlobImpl::Create(static_cast<size_t>(size));
+    file.seekg(0);
+    if (!file.read(static_cast<char*>(pData->GetDataPtr()), size))
+        return;
+
+    // fails for other versions and corrupted files, the cache then starts out empty
+    m_Loaded = m_Cache->Load(pData, m_ContentVersion);
+    if (!m_Loaded)
+        m_Cache->Reset();
+}
+
+void PipelineCache::CreateShader(const ShaderCreateInfo& ShaderCI, IShader** ppShader)
+{
+    if (!m_Cache)
+    {
+        m_pDevice->CreateShader(ShaderCI, ppShader);
+        ++m_ShaderMisses;
+        return;
+    }
+
+    if (m_Cache->CreateShader(ShaderCI, ppShader))
+        ++m_ShaderHits;
+    else
+        ++m_ShaderMisses;
+}
+
+void PipelineCache::CreateGraphicsPipelineState(const GraphicsPipelineStateCreateInfo& PSOCreateInfo, IPipelineState** ppPSO)
+{
+    if (!m_Cache)
+    {
+        m_pDevice->CreateGraphicsPipelineState(PSOCreateInfo, ppPSO);
+        ++m_PipelineMisses;
+        return;
+    }
+
+    if (m_Cache->CreateGraphicsPipelineState(PSOCreateInfo, ppPSO))
+        ++m_PipelineHits;
+    else
+        ++m_PipelineMisses;
+}
+
+void PipelineCache::CreateComputePipelineState(const ComputePipelineStateCreateInfo& PSOCreateInfo, IPipelineState** ppPSO)
+{
+    if (!m_Cache)
+    {
+        m_pDevice->CreateComputePipelineState(PSOCreateInfo, ppPSO);
+        ++m_PipelineMisses;
+        return;
+    }
+
+    if (m_Cache->CreateComputePipelineState(PSOCreateInfo, ppPSO))
+        ++m_PipelineHits;
+    else
+        ++m_PipelineMisses;
+}
+
+void PipelineCache::Save()
+{
+    if (!m_Cache || (m_ShaderMisses == 0 && m_PipelineMisses == 0))
+        return;
+
+    RefCntAutoPtr<IDataBlob> pData;
+    if (!m_Cache->WriteToBlob(m_ContentVersion, &pData) || !pData)
+        throw std::runtime_error("Failed to serialize the pipeline cache");
+
+    // written next to the old file and swapped in, so a failed write never leaves a truncated cache
+    const std::string tempPath = m_FilePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(static_cast<const char*>(pData->GetConstDataPtr()), static_cast<std::streamsize>(pData->GetSize()));
+        if (!file)
+            throw std::runtime_error("Failed to write pipeline cache " + tempPath);
+    }
+    std::remove(m_FilePath.c_str());
+    if (std::rename(tempPath.c_str(), m_FilePath.c_str()) != 0)
+        throw std::runtime_error("Failed to replace pipeline cache " + m_FilePath);
+}
+
+PipelineCache::Stats PipelineCache::GetStats() const
+{
+    Stats stats;
+    stats.ShaderHits     = m_ShaderHits;
+    stats.ShaderMisses   = m_ShaderMisses;
+    stats.PipelineHits   = m_PipelineHits;
+    stats.PipelineMisses = m_PipelineMisses;
+    return stats;
+}
+
+const char* PipelineCache::GetDeviceTypeName(RENDER_DEVICE_TYPE DeviceType)
+{
+    switch (DeviceType)
+    {
+        case RENDER_DEVICE_TYPE_D3D11: return "d3d11";
+        case RENDER_DEVICE_TYPE_D3D12: return "d3d12";
+        case RENDER_DEVICE_TYPE_VULKAN: return "vk";
+        case RENDER_DEVICE_TYPE_GL: return "gl";
+        case RENDER_DEVICE_TYPE_GLES: return "gles";
+        default: return "unknown";
+    }
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+#include "RenderDevice.h"
+#include "RefCntAutoPtr.hpp"
+#include "RenderStateCache.h"
+
+using namespace Diligent;
+
+struct PipelineCacheDesc
+{
+    // cache file without extension, every device type has its own file next to it;
+    // nullptr compiles everything on every launch
+    const char* FilePath = nullptr;
+
+    // caches written with another version are discarded, bump when the cached states change
+    // in ways their descriptions do not show
+    Uint32 ContentVersion = 1;
+};
+
+// Shaders and pipeline states that persist between launches. Built on Diligent's render state cache,
+// which keys shaders by their source, macros and compile options, and pipelines by their
+// description and shaders; a warm start creates them from the stored bytecode without compiling.
+// Creation is thread-safe, so pipelines can be created on several threads at once.
+class PipelineCache
+{
+public:
+    struct Stats
+    {
+        // found in the loaded cache, or compiled and added to it
+        uint32_t ShaderHits     = 0;
+        uint32_t ShaderMisses   = 0;
+        uint32_t PipelineHits   = 0;
+        uint32_t PipelineMisses = 0;
+    };
+
+    PipelineCache(IRenderDevice* pDevice, const PipelineCacheDesc& Desc);
+
+    void CreateShader(const ShaderCreateInfo& ShaderCI, IShader** ppShader);
+
+    // the shaders must come from CreateShader(), the cache stores pipelines by their shaders
+    void CreateGraphicsPipelineState(const GraphicsPipelineStateCreateInfo& PSOCreateInfo, IPipelineState** ppPSO);
+    void CreateComputePipelineState(const ComputePipelineStateCreateInfo& PSOCreateInfo, IPipelineState** ppPSO);
+
+    // writes the cache file if anything was compiled since it was loaded
+    void Save();
+
+    // true if a cache file of the current version was found, i.e. a warm start
+    bool WasLoaded() const { return m_Loaded; }
+
+    Stats GetStats() const;
+
+private:
+    static const char* GetDeviceTypeName(RENDER_DEVICE_TYPE DeviceType);
+
+    void Load();
+
+    IRenderDevice*                   m_pDevice;
+    const Uint32                     m_ContentVersion;
+    std::string                      m_FilePath;
+    RefCntAutoPtr<IRenderStateCache> m_Cache;
+    bool                             m_Loaded = false;
+
+    std::atomic<uint32_t> m_ShaderHits{0};
+    std::atomic<uint32_t> m_ShaderMisses{0};
+    std::atomic<uint32_t> m_PipelineHits{0};
+    std::atomic<uint32_t> m_PipelineMisses{0};
+};
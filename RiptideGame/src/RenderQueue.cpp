@@ -0,0 +1,115 @@
+#include "RenderQueue.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+// the top NumBits of the float, non-negative floats order like their bit patterns
+static uint32_t GetDepthBits(float Depth, uint32_t NumBits)
+{
+    const float clamped = Depth > 0 ? Depth : 0.0f;
+    uint32_t    bits;
+    memcpy(&bits, &clamped, sizeof(bits));
+    return bits >> (32 - NumBits);
+}
+
+uint64_t RenderQueue::MakeKey(DRAW_PASS Pass, uint32_t Pipeline, uint32_t Material, uint32_t MeshId, uint32_t Lod, float Depth)
+{
+    const uint64_t pass = uint64_t{Pass & 0xFu} << 60;
+    if (Pass != DRAW_PASS_TRANSPARENT)
+    {
+        return pass | uint64_t{Pipeline & 0xFFu} << 52 | uint64_t{Material & 0xFFFFu} << 36 | uint64_t{MeshId & 0xFFFFu} << 20 |
+            uint64_t{Lod & 0xFu} << 16 | GetDepthBits(Depth, 16);
+    }
+
+    const uint64_t farToNear = 0xFFFFFFu - GetDepthBits(Depth, 24);
+    return pass | farToNear << 36 | uint64_t{Pipeline & 0xFFu} << 28 | uint64_t{Material & 0xFFFu} << 16 | uint64_t{MeshId & 0xFFFu} << 4 | (Lod & 0xFu);
+}
+
+void RenderQueue::Begin(FrameArena& Arena, uint32_t MaxPackets)
+{
+    m_pPackets   = Arena.Allocate<Packet>(MaxPackets);
+    m_pScratch   = Arena.Allocate<Packet>(MaxPackets);
+    m_NumPackets = 0;
+    m_MaxPackets = MaxPackets;
+}
+
+void RenderQueue::Finish(ThreadPool* pThreads, bool SortPackets)
+{
+    m_Stats            = {};
+    m_Stats.NumPackets = m_NumPackets;
+    if (SortPackets)
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+        Sort(pThreads);
+        m_Stats.SortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    for (uint32_t i = 0; i < m_NumPackets; ++i)
+    {
+        if (i == 0 || m_pPackets[i].Pipeline != m_pPackets[i - 1].Pipeline)
+            ++m_Stats.NumPipelineChanges;
+    }
+}
+
+void RenderQueue::Sort(ThreadPool* pThreads)
+{
+    const uint32_t numPackets = m_NumPackets;
+
+    // digits every key shares would not move anything, most of the pass and pipeline bits are skipped
+    uint64_t anyBits = 0;
+    uint64_t allBits = ~uint64_t{0};
+    for (uint32_t i = 0; i < numPackets; ++i)
+    {
+        anyBits |= m_pPackets[i].Key;
+        allBits &= m_pPackets[i].Key;
+    }
+    const uint64_t varyingBits = anyBits ^ allBits;
+
+    uint32_t numTasks = 1;
+    if (pThreads != nullptr)
+        numTasks = std::max(1u, std::min(pThreads->GetNumThreads() + 1, numPackets / MinPacketsPerTask));
+    m_Offsets.resize(numTasks * RadixSize);
+
+    auto RunTasks = [&](const auto& Task) {
+        if (numTasks == 1)
+            Task(0);
+        else
+            pThreads->ParallelFor(numTasks, Task);
+    };
+
+    Packet* pSrc = m_pPackets;
+    Packet* pDst = m_pScratch;
+    for (uint32_t shift = 0; shift < 64; shift += RadixBits)
+    {
+        if (((varyingBits >> shift) & (RadixSize - 1)) == 0)
+            continue;
+
+        RunTasks([&](uint32_t task) {
+            uint32_t* pCounts = &m_Offsets[task * RadixSize];
+            std::fill(pCounts, pCounts + RadixSize, 0u);
+            for (uint32_t i = task * numPackets / numTasks; i < (task + 1) * numPackets / numTasks; ++i)
+                ++pCounts[(pSrc[i].Key >> shift) & (RadixSize - 1)];
+        });
+
+        // digit-major, then task order, so each task scatters after the earlier tasks' equal digits and the sort stays stable
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < RadixSize; ++digit)
+        {
+            for (uint32_t task = 0; task < numTasks; ++task)
+            {
+                const uint32_t count                = m_Offsets[task * RadixSize + digit];
+                m_Offsets[task * RadixSize + digit] = offset;
+                offset += count;
+            }
+        }
+
+        RunTasks([&](uint32_t task) {
+            uint32_t* pOffsets = &m_Offsets[task * RadixSize];
+            for (uint32_t i = task * numPackets / numTasks; i < (task + 1) * numPackets / numTasks; ++i)
+                pDst[pOffsets[(pSrc[i].Key >> shift) & (RadixSize - 1)]++] = pSrc[i];
+        });
+        std::swap(pSrc, pDst);
+    }
+    m_pPackets = pSrc;
+    m_pScratch = pDst;
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <vector>
+#include "FrameArena.h"
+#include "ThreadPool.h"
+
+// One frame's draws as packets with a 64-bit sort key, sorted with a stable LSD radix sort and
+// executed in key order, so draws sharing state follow each other. Keys compare as integers:
+//
+//   opaque:      pass:4 | pipeline:8 | material:16 | mesh:16 | lod:4 | depth:16
+//   transparent: pass:4 | inverted depth:24 | pipeline:8 | material:12 | mesh:12 | lod:4
+//
+// Opaque draws are grouped by state and go front to back within a group for early depth rejection,
+// transparent ones go back to front for blending. IDs wider than their field only group less well.
+// The packets live in the frame arena, so they are only valid until it is reset.
+class RenderQueue
+{
+public:
+    // in the order they are executed
+    enum DRAW_PASS : uint32_t
+    {
+        DRAW_PASS_OPAQUE = 0,
+        DRAW_PASS_TRANSPARENT,
+        DRAW_PASS_COUNT
+    };
+
+    struct Packet
+    {
+        uint64_t Key;
+        uint32_t DrawIdx;  // what the packet draws, up to the caller
+        uint32_t Pipeline; // kept outside the key for the statistics
+    };
+
+    struct Stats
+    {
+        uint32_t NumPackets         = 0;
+        uint32_t NumPipelineChanges = 0; // when executed in the current order, including the first bind
+        double   SortMs             = 0;
+    };
+
+    // Depth is the distance from the viewer, negative distances count as 0
+    static uint64_t MakeKey(DRAW_PASS Pass, uint32_t Pipeline, uint32_t Material, uint32_t MeshId, uint32_t Lod, float Depth);
+
+    // starts the frame's queue with room for MaxPackets
+    void Begin(FrameArena& Arena, uint32_t MaxPackets);
+
+    void Push(DRAW_PASS Pass, uint32_t Pipeline, uint32_t Material, uint32_t MeshId, uint32_t Lod, float Depth, uint32_t DrawIdx)
+    {
+        assert(m_NumPackets < m_MaxPackets);
+        m_pPackets[m_NumPackets++] = {MakeKey(Pass, Pipeline, Material, MeshId, Lod, Depth), DrawIdx, Pipeline};
+    }
+
+    // sorts the packets unless SortPackets is false, packets with equal keys keep their push order;
+    // splits the sort over pThreads' threads when there are enough packets, pThreads may be nullptr
+    void Finish(ThreadPool* pThreads, bool SortPackets = true);
+
+    uint32_t      GetNumPackets() const { return m_NumPackets; }
+    const Packet& GetPacket(uint32_t Idx) const { return m_pPackets[Idx]; }
+
+    // of the last Finish()
+    const Stats& GetStats() const { return m_Stats; }
+
+private:
+    // fewer packets per task cost more in synchronization than the task saves
+    static constexpr uint32_t MinPacketsPerTask = 4096;
+    static constexpr uint32_t RadixBits         = 8;
+    static constexpr uint32_t RadixSize         = 1u << RadixBits;
+
+    void Sort(ThreadPool* pThreads);
+
+    Packet*  m_pPackets   = nullptr;
+    Packet*  m_pScratch   = nullptr;
+    uint32_t m_NumPackets = 0;
+    uint32_t m_MaxPackets = 0;
+
+    // one histogram per task, turned into the tasks' scatter offsets
+    std::vector<uint32_t> m_Offsets;
+
+    Stats m_Stats;
+};
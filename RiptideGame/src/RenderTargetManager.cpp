@@ -0,0 +1,107 @@
+#include "RenderTargetManager.h"
+#include <stdexcept>
+#include "GraphicsAccessories.hpp"
+
+uint64_t GetTextureMemorySize(const TextureDesc& Desc)
+{
+    const TextureFormatAttribs& fmtAttribs = GetTextureFormatAttribs(Desc.Format);
+    return uint64_t{Desc.Width} * Desc.Height * Desc.ArraySize * Desc.SampleCount * fmtAttribs.GetElementSize();
+}
+
+RenderTargetManager::RenderTargetManager(IRenderDevice*       pDevice,
+                                         const EyeTargetDesc& Desc,
+                                         uint32_t             NumViews,
+                                         uint32_t             EyeWidth,
+                                         uint32_t             EyeHeight,
+                                         TEXTURE_FORMAT       ColorFormat,
+                                         TEXTURE_FORMAT       DepthFormat,
+                                         bool                 NeedsDepth) :
+    m_Desc(Desc),
+    m_NumViews(NumViews),
+    m_Packed(NumViews > 1 || Desc.PackEyes),
+    m_EyeWidth(EyeWidth),
+    m_EyeHeight(EyeHeight)
+{
+    if (m_Desc.SampleCount == 0 || (m_Desc.SampleCount & (m_Desc.SampleCount - 1)) != 0)
+        throw std::runtime_error("Eye target sample count must be a power of two");
+
+    TextureDesc colorDesc;
+    colorDesc.Name      = "Eye color";
+    colorDesc.Type      = RESOURCE_DIM_TEX_2D;
+    colorDesc.Width     = m_Packed ? 2 * EyeWidth : EyeWidth;
+    colorDesc.Height    = EyeHeight;
+    colorDesc.Format    = ColorFormat;
+    colorDesc.BindFlags = BIND_RENDER_TARGET | BIND_SHADER_RESOURCE;
+
+    const uint32_t numColorTargets = GetNumSubmitTextures();
+    for (uint32_t target = 0; target < numColorTargets; ++target)
+    {
+        pDevice->CreateTexture(colorDesc, nullptr, &m_Color[target]);
+        m_MemoryUsage += GetTextureMemorySize(colorDesc);
+    }
+
+    TextureDesc msDesc = colorDesc;
+    msDesc.Name        = "Eye color multisampled";
+    msDesc.SampleCount = m_Desc.SampleCount;
+    msDesc.BindFlags   = BIND_RENDER_TARGET;
+    if (m_Desc.SampleCount > 1)
+    {
+        pDevice->CreateTexture(msDesc, nullptr, &m_MultisampledColor);
+        m_MemoryUsage += GetTextureMemorySize(msDesc);
+    }
+
+    if (NeedsDepth)
+    {
+        TextureDesc depthDesc = msDesc;
+        depthDesc.Name        = "Eye depth";
+        depthDesc.Format      = DepthFormat;
+        depthDesc.BindFlags   = BIND_DEPTH_STENCIL;
+        pDevice->CreateTexture(depthDesc, nullptr, &m_Depth);
+        m_MemoryUsage += GetTextureMemorySize(depthDesc);
+    }
+}
+
+ITextureView* RenderTargetManager::GetRTV(uint32_t Eye) const
+{
+    ITexture* pTarget = m_MultisampledColor ? m_MultisampledColor.RawPtr() : m_Color[GetTextureIndex(Eye)].RawPtr();
+    return pTarget->GetDefaultView(TEXTURE_VIEW_RENDER_TARGET);
+}
+
+ITextureView* RenderTargetManager::GetDSV() const
+{
+    return m_Depth ? m_Depth->GetDefaultView(TEXTURE_VIEW_DEPTH_STENCIL) : nullptr;
+}
+
+uint32_t RenderTargetManager::GetViewportX(uint32_t Eye, uint32_t ViewportWidth) const
+{
+    // single-pass covers both eyes with one viewport
+    return m_Packed && m_NumViews == 1 ? Eye * ViewportWidth : 0;
+}
+
+void RenderTargetManager::EndEye(IDeviceContext* pContext, uint32_t Eye)
+{
+    if (!m_MultisampledColor || (m_Packed && Eye == 0))
+        return;
+
+    // resolves the whole texture, outside the viewport this only copies stale pixels
+    ResolveTextureSubresourceAttribs resolveAttribs;
+    resolveAttribs.SrcTextureTransitionMode = RESOURCE_STATE_TRANSITION_MODE_TRANSITION;
+    resolveAttribs.DstTextureTransitionMode = RESOURCE_STATE_TRANSITION_MODE_TRANSITION;
+    pContext->ResolveTextureSubresource(m_MultisampledColor, m_Color[GetTextureIndex(Eye)], resolveAttribs);
+}
+
+ITexture* RenderTargetManager::GetSubmitTexture(uint32_t Eye) const
+{
+    return m_Color[GetTextureIndex(Eye)];
+}
+
+vr::VRTextureBounds_t RenderTargetManager::GetSubmitBounds(uint32_t Eye, uint32_t ViewportWidth, uint32_t ViewportHeight) const
+{
+    // only the viewport was rendered; packed eyes are next to each other at the viewport width
+    const float maxV = static_cast<float>(ViewportHeight) / static_cast<float>(m_EyeHeight);
+    if (!m_Packed)
+        return {0.0f, 0.0f, static_cast<float>(ViewportWidth) / static_cast<float>(m_EyeWidth), maxV};
+
+    const float eyeU = static_cast<float>(ViewportWidth) / static_cast<float>(2 * m_EyeWidth);
+    return {Eye * eyeU, 0.0f, (Eye + 1) * eyeU, maxV};
+}
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include "DeviceContext.h"
+#include "RefCntAutoPtr.hpp"
+#include "openvr.h"
+
+using namespace Diligent;
+
+struct EyeTargetDesc
+{
+    // multisampled rendering into a transient target that is resolved into the submitted one;
+    // 1 renders into the submitted targets directly
+    uint32_t SampleCount = 1;
+
+    // multi-pass: place both eyes side by side in one texture like in single-pass mode,
+    // one submitted texture instead of two
+    bool PackEyes = false;
+};
+
+// bytes of GPU memory the texture takes, without alignment or padding
+uint64_t GetTextureMemorySize(const TextureDesc& Desc);
+
+// Owns the eye render targets. Only the textures handed to the runtime exist per eye, everything
+// else is transient and shared: the eyes are rendered one after the other, so one depth buffer and
+// one multisampled color target serve both, the latter resolved after each eye.
+class RenderTargetManager
+{
+public:
+    // NumViews eyes are rendered side by side in one pass; without depth, the scene is rendered
+    // elsewhere and only written into the eye targets
+    RenderTargetManager(IRenderDevice*       pDevice,
+                        const EyeTargetDesc& Desc,
+                        uint32_t             NumViews,
+                        uint32_t             EyeWidth,
+                        uint32_t             EyeHeight,
+                        TEXTURE_FORMAT       ColorFormat,
+                        TEXTURE_FORMAT       DepthFormat,
+                        bool                 NeedsDepth);
+
+    // views to render the eye into, the multisampled target if there is one; nullptr if there is no depth
+    ITextureView* GetRTV(uint32_t Eye) const;
+    ITextureView* GetDSV() const;
+
+    // left edge of the eye's viewport, eyes packed into one texture are placed next to each other
+    uint32_t GetViewportX(uint32_t Eye, uint32_t ViewportWidth) const;
+
+    uint32_t GetSampleCount() const { return m_Desc.SampleCount; }
+
+    // textures the eyes are submitted in, one when they are packed
+    uint32_t GetNumSubmitTextures() const { return m_Packed ? 1 : 2; }
+    uint32_t GetTextureIndex(uint32_t Eye) const { return m_Packed ? 0 : Eye; }
+
+    // shared by both eyes and multisampled like the color, nullptr if there is no depth
+    ITexture* GetDepthTexture() const { return m_Depth; }
+
+    // resolves the multisampled target once no further eye is rendered into it, i.e. after every
+    // eye with a texture per eye, and after the right eye when they are packed; Eye is the last
+    // eye rendered, on the immediate context
+    void EndEye(IDeviceContext* pContext, uint32_t Eye);
+
+    ITexture*             GetSubmitTexture(uint32_t Eye) const;
+    vr::VRTextureBounds_t GetSubmitBounds(uint32_t Eye, uint32_t ViewportWidth, uint32_t ViewportHeight) const;
+
+    uint64_t GetMemoryUsage() const { return m_MemoryUsage; }
+
+private:
+    const EyeTargetDesc m_Desc;
+    const uint32_t      m_NumViews;
+    const bool          m_Packed;
+    uint32_t            m_EyeWidth  = 0;
+    uint32_t            m_EyeHeight = 0;
+
+    // submitted, one per eye unless the eyes are packed
+    RefCntAutoPtr<ITexture> m_Color[2];
+
+    // shared by both eyes
+    RefCntAutoPtr<ITexture> m_MultisampledColor;
+    RefCntAutoPtr<ITexture> m_Depth;
+
+    uint64_t m_MemoryUsage = 0;
+};
@@ -0,0 +1,290 @@
+#include "Reprojector.h"
+#include <stdexcept>
+#include "MapHelper.hpp"
+
+static const char* WarpVSSource = R"(
+struct PSInput
+{
+    float4 Pos : SV_POSITION;
+    float2 UV  : TEX_COORD;
+};
+
+// one triangle covering the viewport, UV spans the viewport
+void main(in uint VertID : SV_VertexID, out PSInput PSOut)
+{
+    PSOut.UV  = float2((VertID << 1) & 2, VertID & 2);
+    PSOut.Pos = float4(PSOut.UV * float2(2.0, -2.0) + float2(-1.0, 1.0), 0.0, 1.0);
+}
+)";
+
+static const char* WarpPSSource = R"(
+struct PSInput
+{
+    float4 Pos : SV_POSITION;
+    float2 UV  : TEX_COORD;
+};
+
+cbuffer WarpConstants
+{
+    row_major float4x4 NewToOld[2];
+    row_major float4x4 OldToNew[2];
+    float4             TargetUV;
+    uint               FirstEye;
+    uint               NumEyes;
+};
+
+Texture2D    g_Color;
+SamplerState g_Color_sampler;
+#if POSITIONAL
+Texture2D<float> g_Depth;
+SamplerState     g_Depth_sampler;
+#endif
+
+// steps towards the source pixel, each converges further unless the depth changes between them
+static const uint Iterations = 3;
+
+// NDC to target UV, clamped to the eye's region so neither filtering nor disocclusions pick up the other eye
+float2 ToTargetUV(float2 NDC, uint LocalEye)
+{
+    float2 eyeUV = float2(0.5 + 0.5 * NDC.x, 0.5 - 0.5 * NDC.y);
+    float2 uv    = float2(LocalEye + eyeUV.x, eyeUV.y) * TargetUV.xy;
+    float2 lo    = float2(LocalEye * TargetUV.x, 0.0) + TargetUV.zw;
+    float2 hi    = float2((LocalEye + 1) * TargetUV.x, TargetUV.y) - TargetUV.zw;
+    return clamp(uv, lo, hi);
+}
+
+float4 main(in PSInput PSIn) : SV_TARGET
+{
+    uint   localEye = min(uint(PSIn.UV.x * NumEyes), NumEyes - 1);
+    float2 eyeUV    = float2(PSIn.UV.x * NumEyes - localEye, PSIn.UV.y);
+    uint   eye      = FirstEye + localEye;
+
+    // NDC y points up, UV v down
+    float2 ndc = float2(2.0 * eyeUV.x - 1.0, 1.0 - 2.0 * eyeUV.y);
+
+    // rotation only, the far plane stands in for infinity
+    float4 src    = mul(float4(ndc, 1.0, 1.0), NewToOld[eye]);
+    float2 srcNDC = src.xy / src.w;
+
+#if POSITIONAL
+    // the depth is only known at the source, so the source pixel is moved until it lands on this one
+    [unroll]
+    for (uint i = 0; i < Iterations; ++i)
+    {
+        float  depth = g_Depth.SampleLevel(g_Depth_sampler, ToTargetUV(srcNDC, localEye), 0.0);
+        float4 moved = mul(float4(srcNDC, depth, 1.0), OldToNew[eye]);
+        srcNDC += ndc - moved.xy / moved.w;
+    }
+#endif
+
+    return float4(g_Color.SampleLevel(g_Color_sampler, ToTargetUV(srcNDC, localEye), 0.0).rgb, 1.0);
+}
+)";
+
+Reprojector::Reprojector(IRenderDevice* pDevice, const ReprojectionDesc& Desc, const RenderTargetManager& Targets) :
+    m_Desc(Desc),
+    m_NumTargets(Targets.GetNumSubmitTextures())
+{
+    TextureDesc colorDesc = Targets.GetSubmitTexture(0)->GetDesc();
+    colorDesc.Name        = "Reprojection color";
+    colorDesc.BindFlags   = BIND_SHADER_RESOURCE;
+    m_ColorFormat         = colorDesc.Format;
+
+    // the warp reads single samples of depth
+    ITexture* pDepth = Targets.GetDepthTexture();
+    m_HasDepth       = m_Desc.Positional && pDepth != nullptr && pDepth->GetDesc().SampleCount == 1;
+
+    TextureDesc depthDesc;
+    if (m_HasDepth)
+    {
+        depthDesc           = pDepth->GetDesc();
+        depthDesc.Name      = "Reprojection depth";
+        depthDesc.BindFlags = BIND_DEPTH_STENCIL | BIND_SHADER_RESOURCE;
+    }
+
+    for (uint32_t target = 0; target < m_NumTargets; ++target)
+    {
+        pDevice->CreateTexture(colorDesc, nullptr, &m_Color[target]);
+        m_MemoryUsage += GetTextureMemorySize(colorDesc);
+
+        if (m_HasDepth)
+        {
+            pDevice->CreateTexture(depthDesc, nullptr, &m_Depth[target]);
+            m_MemoryUsage += GetTextureMemorySize(depthDesc);
+        }
+    }
+
+    BufferDesc CBDesc;
+    CBDesc.Name           = "Reprojection CB";
+    CBDesc.Size           = sizeof(WarpConstants);
+    CBDesc.Usage          = USAGE_DYNAMIC;
+    CBDesc.BindFlags      = BIND_UNIFORM_BUFFER;
+    CBDesc.CPUAccessFlags = CPU_ACCESS_WRITE;
+    pDevice->CreateBuffer(CBDesc, nullptr, &m_Constants);
+}
+
+void Reprojector::CreatePipeline(PipelineCache& Cache)
+{
+    GraphicsPipelineStateCreateInfo PSOCreateInfo;
+    PSOCreateInfo.PSODesc.Name = "Reprojection PSO";
+
+    ShaderCreateInfo ShaderCI;
+    ShaderCI.SourceLanguage                  = SHADER_SOURCE_LANGUAGE_HLSL;
+    ShaderCI.Desc.UseCombinedTextureSamplers = true;
+    ShaderCI.EntryPoint                      = "main";
+
+    ShaderMacro Macros[] = {{"POSITIONAL", m_HasDepth ? "1" : "0"}};
+    ShaderCI.Macros      = {Macros, _countof(Macros)};
+
+    RefCntAutoPtr<IShader> pVS;
+    {
+        ShaderCI.Desc.ShaderType = SHADER_TYPE_VERTEX;
+        ShaderCI.Desc.Name       = "Reprojection VS";
+        ShaderCI.Source          = WarpVSSource;
+        Cache.CreateShader(ShaderCI, &pVS);
+    }
+
+    RefCntAutoPtr<IShader> pPS;
+    {
+        ShaderCI.Desc.ShaderType = SHADER_TYPE_PIXEL;
+        ShaderCI.Desc.Name       = "Reprojection PS";
+        ShaderCI.Source          = WarpPSSource;
+        Cache.CreateShader(ShaderCI, &pPS);
+    }
+
+    // overwrites every pixel of the eye viewport, no depth
+    PSOCreateInfo.PSODesc.PipelineType                          = PIPELINE_TYPE_GRAPHICS;
+    PSOCreateInfo.GraphicsPipeline.NumRenderTargets             = 1;
+    PSOCreateInfo.GraphicsPipeline.RTVFormats[0]                = m_ColorFormat;
+    PSOCreateInfo.GraphicsPipeline.DSVFormat                    = TEX_FORMAT_UNKNOWN;
+    PSOCreateInfo.GraphicsPipeline.PrimitiveTopology            = PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    PSOCreateInfo.GraphicsPipeline.RasterizerDesc.CullMode      = CULL_MODE_NONE;
+    PSOCreateInfo.GraphicsPipeline.DepthStencilDesc.DepthEnable = False;
+
+    PSOCreateInfo.pVS = pVS;
+    PSOCreateInfo.pPS = pPS;
+
+    ShaderResourceVariableDesc Variables[] = {
+        {SHADER_TYPE_PIXEL, "WarpConstants", SHADER_RESOURCE_VARIABLE_TYPE_STATIC},
+        {SHADER_TYPE_PIXEL, "g_Color", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE},
+        {SHADER_TYPE_PIXEL, "g_Depth", SHADER_RESOURCE_VARIABLE_TYPE_MUTABLE}};
+    PSOCreateInfo.PSODesc.ResourceLayout.Variables    = Variables;
+    PSOCreateInfo.PSODesc.ResourceLayout.NumVariables = m_HasDepth ? 3 : 2;
+
+    // depth is not filtered across edges
+    const SamplerDesc    linearClamp{FILTER_TYPE_LINEAR, FILTER_TYPE_LINEAR, FILTER_TYPE_LINEAR,
+                                  TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP};
+    const SamplerDesc    pointClamp{FILTER_TYPE_POINT, FILTER_TYPE_POINT, FILTER_TYPE_POINT,
+                                 TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP, TEXTURE_ADDRESS_CLAMP};
+    ImmutableSamplerDesc Samplers[] = {
+        {SHADER_TYPE_PIXEL, "g_Color", linearClamp},
+        {SHADER_TYPE_PIXEL, "g_Depth", pointClamp}};
+    PSOCreateInfo.PSODesc.ResourceLayout.ImmutableSamplers    = Samplers;
+    PSOCreateInfo.PSODesc.ResourceLayout.NumImmutableSamplers = m_HasDepth ? 2 : 1;
+
+    Cache.CreateGraphicsPipelineState(PSOCreateInfo, &m_PSO);
+    if (m_PSO == nullptr)
+        throw std::runtime_error("Failed to create reprojection pipeline state");
+
+    m_PSO->GetStaticVariableByName(SHADER_TYPE_PIXEL, "WarpConstants")->Set(m_Constants);
+
+    // the copies never change, so every SRB is set up once
+    for (uint32_t target = 0; target < m_NumTargets; ++target)
+    {
+        m_PSO->CreateShaderResourceBinding(&m_SRBs[target], true);
+        m_SRBs[target]->GetVariableByName(SHADER_TYPE_PIXEL, "g_Color")->Set(m_Color[target]->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE));
+        if (m_HasDepth)
+            m_SRBs[target]->GetVariableByName(SHADER_TYPE_PIXEL, "g_Depth")->Set(m_Depth[target]->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE));
+    }
+}
+
+void Reprojector::Capture(IDeviceContext* pContext, const RenderTargetManager& Targets, uint32_t FirstEye, uint32_t NumEyes,
+                          const StereoCamera& Camera, uint32_t ViewportWidth, uint32_t ViewportHeight)
+{
+    const uint32_t lastEye = FirstEye + NumEyes - 1;
+    const uint32_t target  = Targets.GetTextureIndex(lastEye);
+
+    // the depth of the pass's eyes, the next pass clears all of it
+    if (m_HasDepth)
+    {
+        const uint32_t     x = Targets.GetViewportX(FirstEye, ViewportWidth);
+        const Box          region(x, x + NumEyes * ViewportWidth, 0, ViewportHeight);
+        CopyTextureAttribs copyAttribs{Targets.GetDepthTexture(), RESOURCE_STATE_TRANSITION_MODE_TRANSITION, m_Depth[target], RESOURCE_STATE_TRANSITION_MODE_TRANSITION};
+        copyAttribs.pSrcBox = &region;
+        copyAttribs.DstX    = x;
+        pContext->CopyTexture(copyAttribs);
+    }
+
+    // packed eyes are copied together after the right one
+    if (m_NumTargets == 1 && lastEye == 0)
+        return;
+
+    const uint32_t     eyesPerTarget = 2 / m_NumTargets;
+    const Box          region(0, eyesPerTarget * ViewportWidth, 0, ViewportHeight);
+    CopyTextureAttribs copyAttribs{Targets.GetSubmitTexture(lastEye), RESOURCE_STATE_TRANSITION_MODE_TRANSITION, m_Color[target], RESOURCE_STATE_TRANSITION_MODE_TRANSITION};
+    copyAttribs.pSrcBox = &region;
+    pContext->CopyTexture(copyAttribs);
+
+    // the right eye is rendered last in every mode
+    if (lastEye == 1)
+    {
+        for (uint32_t eye = 0; eye < 2; ++eye)
+            m_ViewProj[eye] = Camera.GetViewProj(eye);
+        m_ViewportWidth  = ViewportWidth;
+        m_ViewportHeight = ViewportHeight;
+        m_HasHistory     = true;
+    }
+}
+
+bool Reprojector::ShouldReproject(bool WillMissDeadline)
+{
+    // a late frame is shown later, a reprojected one on time but with the old frame's animation;
+    // the limit makes sure the scene keeps moving
+    if (!m_Desc.Enabled || !m_HasHistory || !WillMissDeadline || m_ConsecutiveFrames >= m_Desc.MaxConsecutiveFrames)
+    {
+        m_ConsecutiveFrames = 0;
+        return false;
+    }
+
+    ++m_ConsecutiveFrames;
+    ++m_Stats.NumReprojectedFrames;
+    return true;
+}
+
+void Reprojector::Warp(IDeviceContext* pContext, const RenderTargetManager& Targets, const StereoCamera& Camera)
+{
+    const uint32_t eyesPerTarget = 2 / m_NumTargets;
+    for (uint32_t target = 0; target < m_NumTargets; ++target)
+    {
+        const uint32_t firstEye = target * eyesPerTarget;
+        ITexture*      pTarget  = Targets.GetSubmitTexture(firstEye);
+        {
+            MapHelper<WarpConstants> constants(pContext, m_Constants, MAP_WRITE, MAP_FLAG_DISCARD);
+            for (uint32_t eye = 0; eye < 2; ++eye)
+            {
+                // row vectors, the left matrix is applied first
+                const float4x4& newViewProj = Camera.GetViewProj(eye);
+                constants->NewToOld[eye]    = newViewProj.Inverse() * m_ViewProj[eye];
+                constants->OldToNew[eye]    = m_ViewProj[eye].Inverse() * newViewProj;
+            }
+
+            const TextureDesc& texDesc   = pTarget->GetDesc();
+            const float        texWidth  = static_cast<float>(texDesc.Width);
+            const float        texHeight = static_cast<float>(texDesc.Height);
+            constants->TargetUV          = float4(m_ViewportWidth / texWidth, m_ViewportHeight / texHeight, 0.5f / texWidth, 0.5f / texHeight);
+            constants->FirstEye          = firstEye;
+            constants->NumEyes           = eyesPerTarget;
+        }
+
+        ITextureView* pRTV = pTarget->GetDefaultView(TEXTURE_VIEW_RENDER_TARGET);
+        pContext->SetRenderTargets(1, &pRTV, nullptr, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        Viewport viewport(0, 0, static_cast<float>(eyesPerTarget * m_ViewportWidth), static_cast<float>(m_ViewportHeight));
+        pContext->SetViewports(1, &viewport, 0, 0);
+
+        pContext->SetPipelineState(m_PSO);
+        pContext->CommitShaderResources(m_SRBs[target], RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+
+        DrawAttribs drawAttrs{3, DRAW_FLAG_VERIFY_ALL};
+        pContext->Draw(drawAttrs);
+    }
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "RenderDevice.h"
+#include "DeviceContext.h"
+#include "RefCntAutoPtr.hpp"
+#include "BasicMath.hpp"
+#include "StereoCamera.h"
+#include "RenderTargetManager.h"
+#include "PipelineCache.h"
+
+using namespace Diligent;
+
+struct ReprojectionDesc
+{
+    // when a frame is expected to miss its deadline, submit the last one warped to the newest poses instead
+    bool Enabled = false;
+
+    // also correct for head translation with the last frame's depth; rotation only without eye
+    // target depth, i.e. with foveation or multisampling
+    bool Positional = true;
+
+    // reprojected frames in a row before a frame is rendered regardless of the estimate
+    uint32_t MaxConsecutiveFrames = 1;
+};
+
+// Application-side reprojection. Keeps a copy of the last rendered eye targets, their depth and
+// the views they were rendered with; a frame that would miss its deadline skips rendering and
+// warps that copy to the newest views in one full-screen pass per eye target instead. Rotation
+// is warped exactly; with depth, the source pixel is found by a few fixed-point iterations, as the
+// depth at the destination is not known. Disoccluded areas are filled from the nearest source pixels.
+class Reprojector
+{
+public:
+    struct Stats
+    {
+        uint64_t NumReprojectedFrames = 0;
+    };
+
+    Reprojector(IRenderDevice* pDevice, const ReprojectionDesc& Desc, const RenderTargetManager& Targets);
+
+    // creates the warp pipeline, may run on any thread before the first Warp()
+    void CreatePipeline(PipelineCache& Cache);
+
+    // after each pass of a rendered frame, once its eyes are resolved: copies their depth before the next
+    // pass clears it, and the color once no further eye is rendered into the target. Camera holds the
+    // views the frame was rendered with
+    void Capture(IDeviceContext* pContext, const RenderTargetManager& Targets, uint32_t FirstEye, uint32_t NumEyes,
+                 const StereoCamera& Camera, uint32_t ViewportWidth, uint32_t ViewportHeight);
+
+    // whether this frame is warped instead of rendered; counts it if so
+    bool ShouldReproject(bool WillMissDeadline);
+
+    // writes the captured frame, warped to the camera's views, into the eye targets at the captured
+    // viewport; changes the render targets, pipeline and resources behind the caller's back
+    void Warp(IDeviceContext* pContext, const RenderTargetManager& Targets, const StereoCamera& Camera);
+
+    // false if only rotation is corrected
+    bool IsPositional() const { return m_HasDepth; }
+
+    // of the captured frame, the warped one is submitted with it
+    uint32_t GetViewportWidth() const { return m_ViewportWidth; }
+    uint32_t GetViewportHeight() const { return m_ViewportHeight; }
+
+    const Stats& GetStats() const { return m_Stats; }
+
+    uint64_t GetMemoryUsage() const { return m_MemoryUsage; }
+
+private:
+    struct WarpConstants
+    {
+        float4x4 NewToOld[2]; // clip space of the new view to the one the frame was rendered in
+        float4x4 OldToNew[2];
+        float4   TargetUV; // UV size of one eye's viewport in xy, half a texel in zw
+        uint32_t FirstEye;
+        uint32_t NumEyes;
+        uint32_t Padding[2];
+    };
+
+    const ReprojectionDesc m_Desc;
+    const uint32_t         m_NumTargets;
+    bool                   m_HasDepth = false;
+    TEXTURE_FORMAT         m_ColorFormat;
+
+    // copies of the eye targets and of their depth, indexed like them
+    RefCntAutoPtr<ITexture> m_Color[2];
+    RefCntAutoPtr<ITexture> m_Depth[2];
+
+    // of the captured frame
+    bool     m_HasHistory = false;
+    float4x4 m_ViewProj[2];
+    uint32_t m_ViewportWidth  = 0;
+    uint32_t m_ViewportHeight = 0;
+
+    uint32_t m_ConsecutiveFrames = 0;
+
+    RefCntAutoPtr<IBuffer>                m_Constants;
+    RefCntAutoPtr<IPipelineState>         m_PSO;
+    RefCntAutoPtr<IShaderResourceBinding> m_SRBs[2];
+
+    Stats    m_Stats;
+    uint64_t m_MemoryUsage = 0;
+};
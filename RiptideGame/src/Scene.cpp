@@ -0,0 +1,323 @@
+#include "Scene.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include "Simd.h"
+
+uint32_t Scene::AddMesh(const BoundBox& LocalBounds, const MeshLod* pLods, uint32_t NumLods)
+{
+    const float3   center   = (LocalBounds.Min + LocalBounds.Max) * 0.5f;
+    const uint32_t firstLod = static_cast<uint32_t>(m_MeshLods.size());
+    if (NumLods > 0)
+        m_MeshLods.insert(m_MeshLods.end(), pLods, pLods + NumLods);
+    else
+        m_MeshLods.push_back({0.f, 0});
+
+    m_Meshes.push_back({center, length(LocalBounds.Max - center), firstLod, std::max(NumLods, 1u)});
+    return static_cast<uint32_t>(m_Meshes.size() - 1);
+}
+
+void Scene::SetStaticObjects(const SceneProp* pProps, uint32_t NumProps)
+{
+    m_NumStatic = NumProps;
+    Resize(NumProps);
+    for (uint32_t i = 0; i < NumProps; ++i)
+        SetObject(i, pProps[i]);
+
+    // the objects are stored again in hierarchy order, so every node covers a contiguous range
+    const std::vector<uint32_t> order = BuildHierarchy();
+    for (uint32_t i = 0; i < NumProps; ++i)
+        SetObject(i, pProps[order[i]]);
+}
+
+void Scene::SetDynamicObjects(const SceneProp* pProps, uint32_t NumProps)
+{
+    Resize(m_NumStatic + NumProps);
+    for (uint32_t i = 0; i < NumProps; ++i)
+        SetObject(m_NumStatic + i, pProps[i]);
+}
+
+void Scene::Resize(uint32_t NumObjects)
+{
+    m_World.resize(NumObjects);
+    m_NormalTransform.resize(NumObjects);
+    m_Color.resize(NumObjects);
+    m_MeshId.resize(NumObjects);
+    m_MaterialId.resize(NumObjects);
+    m_Lod.resize(NumObjects);
+    m_CenterX.resize(NumObjects);
+    m_CenterY.resize(NumObjects);
+    m_CenterZ.resize(NumObjects);
+    m_Radius.resize(NumObjects);
+}
+
+void Scene::SetObject(uint32_t Idx, const SceneProp& Prop)
+{
+    if (Prop.MeshId >= m_Meshes.size())
+        throw std::runtime_error("Scene object refers to an unknown mesh");
+
+    m_World[Idx]           = Prop.World;
+    m_NormalTransform[Idx] = Prop.NormalTransform;
+    m_Color[Idx]           = Prop.Color;
+    m_MeshId[Idx]          = Prop.MeshId;
+    m_MaterialId[Idx]      = Prop.MaterialId;
+
+    // the sphere is scaled by the largest axis scale, so it stays conservative under non-uniform scale
+    const MeshBounds& mesh = m_Meshes[Prop.MeshId];
+    const float4x4&   w    = Prop.World;
+    const float3      c    = mesh.Center;
+    m_CenterX[Idx]         = c.x * w.m[0][0] + c.y * w.m[1][0] + c.z * w.m[2][0] + w.m[3][0];
+    m_CenterY[Idx]         = c.x * w.m[0][1] + c.y * w.m[1][1] + c.z * w.m[2][1] + w.m[3][1];
+    m_CenterZ[Idx]         = c.x * w.m[0][2] + c.y * w.m[1][2] + c.z * w.m[2][2] + w.m[3][2];
+
+    float maxScaleSq = 0;
+    for (int row = 0; row < 3; ++row)
+        maxScaleSq = std::max(maxScaleSq, w.m[row][0] * w.m[row][0] + w.m[row][1] * w.m[row][1] + w.m[row][2] * w.m[row][2]);
+    m_Radius[Idx] = mesh.Radius * std::sqrt(maxScaleSq);
+}
+
+std::vector<uint32_t> Scene::BuildHierarchy()
+{
+    m_Nodes.clear();
+
+    std::vector<uint32_t> order(m_NumStatic);
+    std::iota(order.begin(), order.end(), 0u);
+    if (m_NumStatic > 0)
+    {
+        m_Nodes.reserve(2 * (m_NumStatic / MaxLeafObjects + 1));
+        BuildNode(order, 0, m_NumStatic);
+    }
+    return order;
+}
+
+uint32_t Scene::BuildNode(std::vector<uint32_t>& Order, uint32_t First, uint32_t Count)
+{
+    const uint32_t nodeIdx = static_cast<uint32_t>(m_Nodes.size());
+    m_Nodes.emplace_back();
+
+    float3 boundsMin(FLT_MAX, FLT_MAX, FLT_MAX), boundsMax(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    float3 centersMin = boundsMin, centersMax = boundsMax;
+    for (uint32_t i = First; i < First + Count; ++i)
+    {
+        const uint32_t objIdx = Order[i];
+        const float3   center(m_CenterX[objIdx], m_CenterY[objIdx], m_CenterZ[objIdx]);
+        const float3   radius(m_Radius[objIdx], m_Radius[objIdx], m_Radius[objIdx]);
+        boundsMin  = min(boundsMin, center - radius);
+        boundsMax  = max(boundsMax, center + radius);
+        centersMin = min(centersMin, center);
+        centersMax = max(centersMax, center);
+    }
+
+    BVHNode node;
+    node.Center     = (boundsMin + boundsMax) * 0.5f;
+    node.Extents    = (boundsMax - boundsMin) * 0.5f;
+    node.First      = First;
+    node.Count      = Count;
+    node.RightChild = 0;
+    if (Count > MaxLeafObjects)
+    {
+        // median split along the axis the centers are spread the most
+        const float3 spread = centersMax - centersMin;
+        const int    axis   = spread.x >= spread.y && spread.x >= spread.z ? 0 : (spread.y >= spread.z ? 1 : 2);
+
+        const std::vector<float>& centers = axis == 0 ? m_CenterX : (axis == 1 ? m_CenterY : m_CenterZ);
+        const uint32_t            half    = Count / 2;
+        std::nth_element(Order.begin() + First, Order.begin() + First + half, Order.begin() + First + Count,
+                         [&centers](uint32_t a, uint32_t b) { return centers[a] < centers[b]; });
+
+        BuildNode(Order, First, half);
+        node.RightChild = BuildNode(Order, First + half, Count - half);
+    }
+    m_Nodes[nodeIdx] = node;
+    return nodeIdx;
+}
+
+Scene::CullStats Scene::Cull(const ViewFrustum& Frustum, std::vector<uint32_t>& Visible) const
+{
+    FrustumPlanes planes;
+    LoadPlanes(Frustum, planes);
+
+    CullStats    stats;
+    const size_t firstVisible = Visible.size();
+    Visible.reserve(firstVisible + GetNumObjects());
+
+    if (!m_Nodes.empty())
+    {
+        // the hierarchy is balanced, its depth is at most log2 of the number of static objects
+        uint32_t stack[64];
+        uint32_t stackSize = 0;
+        stack[stackSize++] = 0;
+        while (stackSize > 0)
+        {
+            const uint32_t nodeIdx = stack[--stackSize];
+            const BVHNode& node    = m_Nodes[nodeIdx];
+            ++stats.NumNodesVisited;
+
+            switch (TestBox(planes, node.Center, node.Extents))
+            {
+                case Containment::Outside:
+                    break;
+
+                case Containment::Inside:
+                    for (uint32_t objIdx = node.First; objIdx < node.First + node.Count; ++objIdx)
+                        Visible.push_back(objIdx);
+                    break;
+
+                case Containment::Intersecting:
+                    if (node.RightChild == 0)
+                    {
+                        CullSpheres(planes, node.First, node.First + node.Count, Visible);
+                    }
+                    else
+                    {
+                        stack[stackSize++] = node.RightChild;
+                        stack[stackSize++] = nodeIdx + 1;
+                    }
+                    break;
+            }
+        }
+    }
+
+    CullSpheres(planes, m_NumStatic, GetNumObjects(), Visible);
+
+    stats.NumVisible = static_cast<uint32_t>(Visible.size() - firstVisible);
+    stats.NumCulled  = GetNumObjects() - stats.NumVisible;
+    return stats;
+}
+
+Scene::LodStats Scene::SelectLods(const float3& ViewPosition, float PixelsPerUnit, const MeshLodDesc& Desc, const std::vector<uint32_t>& Visible)
+{
+    LodStats stats;
+    for (uint32_t objIdx : Visible)
+    {
+        const MeshBounds& mesh = m_Meshes[m_MeshId[objIdx]];
+        const MeshLod*    lods = &m_MeshLods[mesh.FirstLod];
+
+        // errors scale with the object like its bounding sphere; inside the sphere everything is at full detail
+        const float3 toCenter(m_CenterX[objIdx] - ViewPosition.x, m_CenterY[objIdx] - ViewPosition.y, m_CenterZ[objIdx] - ViewPosition.z);
+        const float  distance   = length(toCenter) - m_Radius[objIdx];
+        const float  errorScale = mesh.Radius > 0 && distance > 0 ? PixelsPerUnit * m_Radius[objIdx] / (mesh.Radius * distance) : FLT_MAX;
+
+        // the previous level is refined until it is within the error, and only coarsened with some margin
+        uint32_t lod = Desc.Enabled ? std::min(m_Lod[objIdx], mesh.NumLods - 1) : 0;
+        while (lod > 0 && lods[lod].Error * errorScale > Desc.MaxPixelError)
+            --lod;
+        while (Desc.Enabled && lod + 1 < mesh.NumLods && lods[lod + 1].Error * errorScale <= Desc.MaxPixelError * (1.0f - Desc.Hysteresis))
+            ++lod;
+        m_Lod[objIdx] = lod;
+
+        stats.NumFullTriangles += lods[0].NumTriangles;
+        stats.NumTriangles += lods[lod].NumTriangles;
+    }
+    return stats;
+}
+
+void Scene::LoadPlanes(const ViewFrustum& Frustum, FrustumPlanes& Planes)
+{
+    for (uint32_t i = 0; i < 8; ++i)
+    {
+        if (i < ViewFrustum::NUM_PLANES)
+        {
+            // the extracted planes point inwards but are not normalized
+            const Plane3D& plane  = Frustum.GetPlane(static_cast<ViewFrustum::PLANE_IDX>(i));
+            const float    invLen = 1.0f / length(plane.Normal);
+            Planes.NX[i]          = plane.Normal.x * invLen;
+            Planes.NY[i]          = plane.Normal.y * invLen;
+            Planes.NZ[i]          = plane.Normal.z * invLen;
+            Planes.D[i]           = plane.Distance * invLen;
+        }
+        else
+        {
+            Planes.NX[i] = Planes.NY[i] = Planes.NZ[i] = 0;
+            Planes.D[i]                                = 1;
+        }
+    }
+}
+
+Scene::Containment Scene::TestBox(const FrustumPlanes& Planes, const float3& Center, const float3& Extents)
+{
+#if RIPTIDE_SSE
+    // four planes at a time: outside if the box is behind any plane, inside if it is in front of all
+    const __m128 cx       = _mm_set1_ps(Center.x);
+    const __m128 cy       = _mm_set1_ps(Center.y);
+    const __m128 cz       = _mm_set1_ps(Center.z);
+    const __m128 ex       = _mm_set1_ps(Extents.x);
+    const __m128 ey       = _mm_set1_ps(Extents.y);
+    const __m128 ez       = _mm_set1_ps(Extents.z);
+    const __m128 signMask = _mm_set1_ps(-0.0f);
+    const __m128 zero     = _mm_setzero_ps();
+
+    __m128 outside   = zero;
+    __m128 notInside = zero;
+    for (int i = 0; i < 8; i += 4)
+    {
+        const __m128 nx = _mm_load_ps(Planes.NX + i);
+        const __m128 ny = _mm_load_ps(Planes.NY + i);
+        const __m128 nz = _mm_load_ps(Planes.NZ + i);
+
+        const __m128 dist   = _mm_add_ps(_mm_add_ps(_mm_mul_ps(nx, cx), _mm_mul_ps(ny, cy)), _mm_add_ps(_mm_mul_ps(nz, cz), _mm_load_ps(Planes.D + i)));
+        const __m128 radius = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_andnot_ps(signMask, nx), ex), _mm_mul_ps(_mm_andnot_ps(signMask, ny), ey)),
+                                         _mm_mul_ps(_mm_andnot_ps(signMask, nz), ez));
+
+        outside   = _mm_or_ps(outside, _mm_cmplt_ps(_mm_add_ps(dist, radius), zero));
+        notInside = _mm_or_ps(notInside, _mm_cmplt_ps(_mm_sub_ps(dist, radius), zero));
+    }
+
+    if (_mm_movemask_ps(outside) != 0)
+        return Containment::Outside;
+    return _mm_movemask_ps(notInside) != 0 ? Containment::Intersecting : Containment::Inside;
+#else
+    Containment result = Containment::Inside;
+    for (uint32_t i = 0; i < ViewFrustum::NUM_PLANES; ++i)
+    {
+        const float dist   = Planes.NX[i] * Center.x + Planes.NY[i] * Center.y + Planes.NZ[i] * Center.z + Planes.D[i];
+        const float radius = std::abs(Planes.NX[i]) * Extents.x + std::abs(Planes.NY[i]) * Extents.y + std::abs(Planes.NZ[i]) * Extents.z;
+        if (dist + radius < 0)
+            return Containment::Outside;
+        if (dist - radius < 0)
+            result = Containment::Intersecting;
+    }
+    return result;
+#endif
+}
+
+void Scene::CullSpheres(const FrustumPlanes& Planes, uint32_t First, uint32_t End, std::vector<uint32_t>& Visible) const
+{
+    uint32_t objIdx = First;
+#if RIPTIDE_SSE
+    // four spheres at a time
+    const __m128 zero = _mm_setzero_ps();
+    for (; objIdx + 4 <= End; objIdx += 4)
+    {
+        const __m128 cx     = _mm_loadu_ps(&m_CenterX[objIdx]);
+        const __m128 cy     = _mm_loadu_ps(&m_CenterY[objIdx]);
+        const __m128 cz     = _mm_loadu_ps(&m_CenterZ[objIdx]);
+        const __m128 radius = _mm_loadu_ps(&m_Radius[objIdx]);
+
+        __m128 inside = _mm_cmpeq_ps(zero, zero);
+        for (uint32_t i = 0; i < ViewFrustum::NUM_PLANES; ++i)
+        {
+            const __m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(Planes.NX[i]), cx), _mm_mul_ps(_mm_set1_ps(Planes.NY[i]), cy)),
+                                           _mm_add_ps(_mm_mul_ps(_mm_set1_ps(Planes.NZ[i]), cz), _mm_set1_ps(Planes.D[i])));
+            inside            = _mm_and_ps(inside, _mm_cmpge_ps(_mm_add_ps(dist, radius), zero));
+        }
+
+        const int mask = _mm_movemask_ps(inside);
+        for (uint32_t lane = 0; lane < 4; ++lane)
+        {
+            if (mask & (1 << lane))
+                Visible.push_back(objIdx + lane);
+        }
+    }
+#endif
+    for (; objIdx < End; ++objIdx)
+    {
+        bool inside = true;
+        for (uint32_t i = 0; i < ViewFrustum::NUM_PLANES && inside; ++i)
+            inside = Planes.NX[i] * m_CenterX[objIdx] + Planes.NY[i] * m_CenterY[objIdx] + Planes.NZ[i] * m_CenterZ[objIdx] + Planes.D[i] + m_Radius[objIdx] >= 0;
+        if (inside)
+            Visible.push_back(objIdx);
+    }
+}
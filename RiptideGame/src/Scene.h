@@ -0,0 +1,151 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "BasicMath.hpp"
+#include "AdvancedMath.hpp"
+#include "SceneSnapshot.h"
+
+using namespace Diligent;
+
+struct MeshLodDesc
+{
+    // off: every mesh is drawn at full detail
+    bool Enabled = true;
+
+    // the coarsest level whose error projects to at most this many pixels is drawn
+    float MaxPixelError = 1.0f;
+
+    // a coarser level is only picked once its error is this fraction below MaxPixelError, so
+    // objects near the switching distance do not pop back and forth
+    float Hysteresis = 0.25f;
+};
+
+// Renderable objects in structure-of-arrays form. Static objects come first, in the order of a
+// bounding volume hierarchy that is built when they are set; dynamic objects follow and are tested
+// one by one. Both are culled against a single frustum with SSE box and sphere tests.
+class Scene
+{
+public:
+    struct CullStats
+    {
+        uint32_t NumVisible      = 0;
+        uint32_t NumCulled       = 0;
+        uint32_t NumNodesVisited = 0;
+    };
+
+    struct LodStats
+    {
+        // of the visible objects, at full detail and at their selected levels
+        uint64_t NumFullTriangles = 0;
+        uint64_t NumTriangles     = 0;
+    };
+
+    struct MeshLod
+    {
+        float    Error; // in the mesh's units
+        uint32_t NumTriangles;
+    };
+
+    // objects refer to meshes by the returned ID; the levels of detail go from full to least detail,
+    // a mesh without them has a single level
+    uint32_t AddMesh(const BoundBox& LocalBounds, const MeshLod* pLods = nullptr, uint32_t NumLods = 0);
+
+    // replaces the static objects and rebuilds the hierarchy; drops the dynamic objects, which
+    // have to be set again
+    void SetStaticObjects(const SceneProp* pProps, uint32_t NumProps);
+
+    void SetDynamicObjects(const SceneProp* pProps, uint32_t NumProps);
+
+    uint32_t GetNumObjects() const { return static_cast<uint32_t>(m_World.size()); }
+    uint32_t GetNumStaticObjects() const { return m_NumStatic; }
+
+    // appends the indices of the objects whose bounding spheres intersect the frustum
+    CullStats Cull(const ViewFrustum& Frustum, std::vector<uint32_t>& Visible) const;
+
+    // picks a level of detail for every visible object, once for both eyes: errors are projected
+    // from ViewPosition to the nearest point of the object's bounding sphere, PixelsPerUnit is the
+    // size in pixels of one unit at unit distance
+    LodStats SelectLods(const float3& ViewPosition, float PixelsPerUnit, const MeshLodDesc& Desc, const std::vector<uint32_t>& Visible);
+
+    const float4x4& GetWorld(uint32_t Idx) const { return m_World[Idx]; }
+    const float4x4& GetNormalTransform(uint32_t Idx) const { return m_NormalTransform[Idx]; }
+    const float4&   GetColor(uint32_t Idx) const { return m_Color[Idx]; }
+    uint32_t        GetMeshId(uint32_t Idx) const { return m_MeshId[Idx]; }
+    uint32_t        GetMaterialId(uint32_t Idx) const { return m_MaterialId[Idx]; }
+
+    // world space center in xyz, radius in w
+    float4 GetBoundingSphere(uint32_t Idx) const { return float4(m_CenterX[Idx], m_CenterY[Idx], m_CenterZ[Idx], m_Radius[Idx]); }
+
+    // of the last SelectLods(), 0 before; kept between frames for the hysteresis
+    uint32_t GetLod(uint32_t Idx) const { return m_Lod[Idx]; }
+
+private:
+    static constexpr uint32_t MaxLeafObjects = 8;
+
+    struct MeshBounds
+    {
+        float3   Center;
+        float    Radius;
+        uint32_t FirstLod; // in m_MeshLods
+        uint32_t NumLods;
+    };
+
+    // depth-first order, the left child follows its parent; the objects of a subtree are contiguous
+    struct BVHNode
+    {
+        float3   Center;
+        float3   Extents;
+        uint32_t First;
+        uint32_t Count;
+        uint32_t RightChild; // 0 for leaves
+    };
+
+    // normalized planes in SoA form, padded to 8 with planes everything is inside of
+    struct FrustumPlanes
+    {
+        alignas(16) float NX[8];
+        alignas(16) float NY[8];
+        alignas(16) float NZ[8];
+        alignas(16) float D[8];
+    };
+
+    enum class Containment
+    {
+        Outside,
+        Intersecting,
+        Inside
+    };
+
+    void Resize(uint32_t NumObjects);
+    void SetObject(uint32_t Idx, const SceneProp& Prop);
+
+    // returns the object order the hierarchy was built for
+    std::vector<uint32_t> BuildHierarchy();
+    uint32_t              BuildNode(std::vector<uint32_t>& Order, uint32_t First, uint32_t Count);
+
+    static void        LoadPlanes(const ViewFrustum& Frustum, FrustumPlanes& Planes);
+    static Containment TestBox(const FrustumPlanes& Planes, const float3& Center, const float3& Extents);
+    void               CullSpheres(const FrustumPlanes& Planes, uint32_t First, uint32_t End, std::vector<uint32_t>& Visible) const;
+
+    std::vector<MeshBounds> m_Meshes;
+    std::vector<MeshLod>    m_MeshLods;
+
+    uint32_t m_NumStatic = 0;
+
+    std::vector<float4x4> m_World;
+    std::vector<float4x4> m_NormalTransform;
+    std::vector<float4>   m_Color;
+    std::vector<uint32_t> m_MeshId;
+    std::vector<uint32_t> m_MaterialId;
+    std::vector<uint32_t> m_Lod;
+
+    // world space bounding spheres
+    std::vector<float> m_CenterX;
+    std::vector<float> m_CenterY;
+    std::vector<float> m_CenterZ;
+    std::vector<float> m_Radius;
+
+    // over the static objects only
+    std::vector<BVHNode> m_Nodes;
+};
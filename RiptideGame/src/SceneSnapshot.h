@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "BasicMath.hpp"
+
+using namespace Diligent;
+
+struct SceneProp
+{
+    float4x4 World;
+
+    // inverse transpose of World's upper 3x3, see ComputeNormalTransform(); computed by the producer
+    // so the render thread does not have to
+    float4x4 NormalTransform;
+
+    float4 Color;
+
+    uint32_t MeshId     = 0;
+    uint32_t MaterialId = 0;
+};
+
+// The inverse transpose of an affine transform's upper 3x3 is its cofactor matrix divided by the
+// determinant, which only takes three cross products instead of a general 4x4 inverse
+inline float4x4 ComputeNormalTransform(const float4x4& World)
+{
+    const float3 row0(World.m[0][0], World.m[0][1], World.m[0][2]);
+    const float3 row1(World.m[1][0], World.m[1][1], World.m[1][2]);
+    const float3 row2(World.m[2][0], World.m[2][1], World.m[2][2]);
+
+    const float3 cof0   = cross(row1, row2);
+    const float3 cof1   = cross(row2, row0);
+    const float3 cof2   = cross(row0, row1);
+    const float  invDet = 1.0f / dot(row0, cof0);
+
+    return float4x4(
+        cof0.x * invDet, cof0.y * invDet, cof0.z * invDet, 0,
+        cof1.x * invDet, cof1.y * invDet, cof1.z * invDet, 0,
+        cof2.x * invDet, cof2.y * invDet, cof2.z * invDet, 0,
+        0, 0, 0, 1);
+}
+
+// Immutable state of the simulated scene at one simulation tick, as seen by the renderer
+struct SceneSnapshot
+{
+    // renderers only re-read the scene when the tick changes
+    uint64_t TickIndex = 0;
+    double   Time      = 0;
+
+    // moved every tick
+    std::vector<SceneProp> Props;
+
+    // never moved, shared by every snapshot until the set changes; the renderer indexes them
+    // spatially whenever it sees a different set
+    std::shared_ptr<const std::vector<SceneProp>> StaticProps;
+};
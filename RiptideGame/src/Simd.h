@@ -0,0 +1,9 @@
+#pragma once
+
+// SSE is part of every x64 target; code using it keeps a scalar fallback for other architectures
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#    define RIPTIDE_SSE 1
+#    include <xmmintrin.h>
+#else
+#    define RIPTIDE_SSE 0
+#endif
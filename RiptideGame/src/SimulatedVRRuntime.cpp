@@ -0,0 +1,357 @@
+#include "SimulatedVRRuntime.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+// an hour at 90 Hz, and the frames a recording may skip at once; larger frame numbers are taken
+// as corruption rather than allocating the frames in between
+static constexpr uint32_t MaxRecordedFrames   = 90 * 60 * 60;
+static constexpr uint32_t MaxRecordedFrameGap = 90 * 10;
+
+static vr::TrackedDevicePose_t MakeInvalidPose()
+{
+    vr::TrackedDevicePose_t pose = {};
+    pose.eTrackingResult         = vr::TrackingResult_Uninitialized;
+    pose.bPoseIsValid            = false;
+    pose.bDeviceIsConnected      = false;
+    return pose;
+}
+
+static vr::TrackedDevicePose_t MakeValidPose(const vr::HmdMatrix34_t& mat)
+{
+    vr::TrackedDevicePose_t pose   = {};
+    pose.mDeviceToAbsoluteTracking = mat;
+    pose.eTrackingResult           = vr::TrackingResult_Running_OK;
+    pose.bPoseIsValid              = true;
+    pose.bDeviceIsConnected        = true;
+    return pose;
+}
+
+// rotation around +y followed by a translation, in SteamVR's right-handed tracking space
+static vr::HmdMatrix34_t MakeYawTranslation(float yaw, float x, float y, float z)
+{
+    const float c = std::cos(yaw);
+    const float s = std::sin(yaw);
+
+    vr::HmdMatrix34_t mat = {{{c, 0.f, s, x},
+                              {0.f, 1.f, 0.f, y},
+                              {-s, 0.f, c, z}}};
+    return mat;
+}
+
+SimulatedVRRuntime::SimulatedVRRuntime(const SimulatedHMDDesc& Desc) :
+    m_Desc(Desc),
+    m_NumDevices(FirstTrackerIdx + Desc.NumTrackers)
+{
+    if (m_Desc.RefreshRate <= 0.f)
+        throw std::runtime_error("Simulated HMD refresh rate must be positive");
+    if (m_Desc.NumTrackers > MaxTrackers)
+        throw std::runtime_error("Too many simulated trackers");
+
+    for (vr::TrackedDeviceIndex_t deviceIdx = 0; deviceIdx < m_NumDevices; ++deviceIdx)
+    {
+        vr::VREvent_t event      = {};
+        event.eventType          = vr::VREvent_TrackedDeviceActivated;
+        event.trackedDeviceIndex = deviceIdx;
+        m_Events.push_back(event);
+    }
+
+    if (m_Desc.PoseRecordingPath != nullptr)
+        LoadPoseRecording(m_Desc.PoseRecordingPath);
+}
+
+void SimulatedVRRuntime::GetRecommendedRenderTargetSize(uint32_t* pWidth, uint32_t* pHeight)
+{
+    *pWidth  = m_Desc.RenderWidth;
+    *pHeight = m_Desc.RenderHeight;
+}
+
+vr::HmdMatrix44_t SimulatedVRRuntime::GetProjectionMatrix(vr::EVREye eye, float nearZ, float farZ)
+{
+    // same composition SteamVR uses for GetProjectionRaw() tangents
+    const float left   = eye == vr::Eye_Left ? -m_Desc.FovTanOuter : -m_Desc.FovTanInner;
+    const float right  = eye == vr::Eye_Left ? m_Desc.FovTanInner : m_Desc.FovTanOuter;
+    const float top    = -m_Desc.FovTanUp;
+    const float bottom = m_Desc.FovTanDown;
+
+    const float idx = 1.0f / (right - left);
+    const float idy = 1.0f / (bottom - top);
+    const float idz = 1.0f / (farZ - nearZ);
+    const float sx  = right + left;
+    const float sy  = bottom + top;
+
+    vr::HmdMatrix44_t mat = {{{2.f * idx, 0.f, sx * idx, 0.f},
+                              {0.f, 2.f * idy, sy * idy, 0.f},
+                              {0.f, 0.f, -farZ * idz, -farZ * nearZ * idz},
+                              {0.f, 0.f, -1.f, 0.f}}};
+    return mat;
+}
+
+vr::HmdMatrix34_t SimulatedVRRuntime::GetEyeToHeadTransform(vr::EVREye eye)
+{
+    const float offset = (eye == vr::Eye_Left ? -0.5f : 0.5f) * m_Desc.IPD;
+    return MakeYawTranslation(0.f, offset, 0.f, 0.f);
+}
+
+vr::ETrackedDeviceClass SimulatedVRRuntime::GetTrackedDeviceClass(vr::TrackedDeviceIndex_t deviceIdx)
+{
+    if (deviceIdx == vr::k_unTrackedDeviceIndex_Hmd)
+        return vr::TrackedDeviceClass_HMD;
+    if (deviceIdx == LeftControllerIdx || deviceIdx == RightControllerIdx)
+        return vr::TrackedDeviceClass_Controller;
+    if (deviceIdx >= FirstTrackerIdx && deviceIdx < m_NumDevices)
+        return vr::TrackedDeviceClass_GenericTracker;
+    return vr::TrackedDeviceClass_Invalid;
+}
+
+vr::ETrackedControllerRole SimulatedVRRuntime::GetControllerRoleForTrackedDeviceIndex(vr::TrackedDeviceIndex_t deviceIdx)
+{
+    if (deviceIdx == LeftControllerIdx)
+        return vr::TrackedControllerRole_LeftHand;
+    if (deviceIdx == RightControllerIdx)
+        return vr::TrackedControllerRole_RightHand;
+    return vr::TrackedControllerRole_Invalid;
+}
+
+uint32_t SimulatedVRRuntime::GetStringTrackedDeviceProperty(vr::TrackedDeviceIndex_t deviceIdx, vr::ETrackedDeviceProperty prop, char* pValue, uint32_t bufferSize)
+{
+    if (deviceIdx >= m_NumDevices)
+        return 0;
+
+    std::string value;
+    switch (prop)
+    {
+        case vr::Prop_TrackingSystemName_String: value = "simulated"; break;
+        case vr::Prop_ModelNumber_String: value = deviceIdx == vr::k_unTrackedDeviceIndex_Hmd ? "Simulated HMD" : deviceIdx < FirstTrackerIdx ? "Simulated Controller" : "Simulated Tracker"; break;
+        case vr::Prop_SerialNumber_String: value = "SIM-" + std::to_string(deviceIdx); break;
+        default: return 0;
+    }
+
+    // like OpenVR, the required size is returned if the buffer is too small
+    const uint32_t length = static_cast<uint32_t>(value.size()) + 1;
+    if (pValue != nullptr && bufferSize >= length)
+        memcpy(pValue, value.c_str(), length);
+    return length;
+}
+
+bool SimulatedVRRuntime::PollNextEvent(vr::VREvent_t* pEvent)
+{
+    if (m_Events.empty())
+        return false;
+
+    *pEvent = m_Events.front();
+    m_Events.pop_front();
+    return true;
+}
+
+vr::EVRCompositorError SimulatedVRRuntime::WaitGetPoses(vr::TrackedDevicePose_t* pRenderPoses, uint32_t numPoses)
+{
+    const Clock::time_point calledTime   = Clock::now();
+    uint32_t                missedVSyncs = 0;
+    if (m_Desc.ThrottleToVSync)
+    {
+        const auto period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(GetFramePeriod()));
+        const auto now    = Clock::now();
+        if (!m_Started)
+        {
+            m_NextVSync = now;
+            m_Started   = true;
+        }
+        else if (now > m_NextVSync)
+        {
+            // the application overran one or more refresh intervals
+            const auto missed = (now - m_NextVSync) / period + 1;
+            m_MissedVSyncs += missed;
+            m_NextVSync += missed * period;
+            missedVSyncs = static_cast<uint32_t>(missed);
+        }
+
+        std::this_thread::sleep_until(m_NextVSync);
+        m_NextVSync += period;
+    }
+
+    if (m_FrameIndex > 0)
+        FinishFrameTiming(calledTime, missedVSyncs);
+
+    // poses are a function of the frame index only, so runs are repeatable
+    SamplePoses(static_cast<double>(m_FrameIndex) * GetFramePeriod(), pRenderPoses, numPoses);
+    m_LastPosesTime = Clock::now();
+
+    vr::Compositor_FrameTiming& timing = m_FrameTimings[m_FrameIndex % NumFrameTimings];
+    timing                             = {};
+    timing.m_nSize                     = sizeof(vr::Compositor_FrameTiming);
+    timing.m_nFrameIndex               = static_cast<uint32_t>(m_FrameIndex);
+    timing.m_flSystemTimeInSeconds     = std::chrono::duration<double>(m_LastPosesTime.time_since_epoch()).count();
+
+    m_EyeSubmitted[0] = m_EyeSubmitted[1] = false;
+    ++m_FrameIndex;
+    return vr::VRCompositorError_None;
+}
+
+void SimulatedVRRuntime::FinishFrameTiming(Clock::time_point WaitCalledTime, uint32_t MissedVSyncs)
+{
+    auto ToFrameMs = [this](Clock::time_point Time) {
+        return static_cast<float>(std::chrono::duration<double, std::milli>(Time - m_LastPosesTime).count());
+    };
+
+    // a frame that is not ready at its vsync leaves the previous one on the display until it is
+    vr::Compositor_FrameTiming& timing = m_FrameTimings[(m_FrameIndex - 1) % NumFrameTimings];
+    timing.m_nNumFramePresents         = 1;
+    timing.m_nNumDroppedFrames         = MissedVSyncs;
+    timing.m_nReprojectionFlags        = MissedVSyncs > 0 ? vr::VRCompositor_ReprojectionReason_Cpu : 0;
+    timing.m_flWaitGetPosesCalledMs    = ToFrameMs(WaitCalledTime);
+    if (m_EyeSubmitted[vr::Eye_Left] && m_EyeSubmitted[vr::Eye_Right])
+        timing.m_flNewFrameReadyMs = ToFrameMs(m_LastSubmitTime);
+}
+
+bool SimulatedVRRuntime::GetFrameTiming(vr::Compositor_FrameTiming* pTiming, uint32_t framesAgo)
+{
+    if (framesAgo >= m_FrameIndex || framesAgo >= NumFrameTimings)
+        return false;
+
+    *pTiming = m_FrameTimings[(m_FrameIndex - 1 - framesAgo) % NumFrameTimings];
+    return true;
+}
+
+float SimulatedVRRuntime::GetFrameDuration()
+{
+    return static_cast<float>(GetFramePeriod());
+}
+
+float SimulatedVRRuntime::GetPredictedSecondsToPhotons()
+{
+    const double sinceVSync = std::chrono::duration<double>(Clock::now() - m_LastPosesTime).count();
+    return static_cast<float>(GetFramePeriod() - sinceVSync + m_Desc.SecondsFromVSyncToPhotons);
+}
+
+void SimulatedVRRuntime::GetDeviceToAbsoluteTrackingPose(float predictedSecondsToPhotons, vr::TrackedDevicePose_t* pPoses, uint32_t numPoses)
+{
+    if (m_FrameIndex == 0)
+    {
+        SamplePoses(0.0, pPoses, numPoses);
+        return;
+    }
+
+    // the frame of the last WaitGetPoses() is sampled at its vsync and lit a frame period plus the display latency later
+    const double sinceVSync     = std::chrono::duration<double>(Clock::now() - m_LastPosesTime).count();
+    const double photonsDelay   = GetFramePeriod() + m_Desc.SecondsFromVSyncToPhotons;
+    const double lastFrameTime  = static_cast<double>(m_FrameIndex - 1) * GetFramePeriod();
+    const double predictionTime = lastFrameTime + sinceVSync + predictedSecondsToPhotons - photonsDelay;
+    SamplePoses(std::max(predictionTime, 0.0), pPoses, numPoses);
+}
+
+void SimulatedVRRuntime::SamplePoses(double time, vr::TrackedDevicePose_t* pPoses, uint32_t numPoses) const
+{
+    DevicePoses poses;
+    if (!m_RecordedPoses.empty())
+    {
+        // recorded poses are not interpolated, round to the nearest frame
+        const uint64_t frame = static_cast<uint64_t>(time / GetFramePeriod() + 0.5);
+        poses                = m_RecordedPoses[frame % m_RecordedPoses.size()];
+    }
+    else
+        GenerateSyntheticPoses(time, poses);
+
+    for (uint32_t deviceIdx = 0; deviceIdx < numPoses; ++deviceIdx)
+        pPoses[deviceIdx] = deviceIdx < m_NumDevices ? poses[deviceIdx] : MakeInvalidPose();
+}
+
+vr::EVRCompositorError SimulatedVRRuntime::Submit(vr::EVREye eye, const vr::Texture_t* pTexture, const vr::VRTextureBounds_t* pBounds)
+{
+    if (eye != vr::Eye_Left && eye != vr::Eye_Right)
+        return vr::VRCompositorError_IndexOutOfRange;
+
+    if (pTexture == nullptr || pTexture->handle == nullptr)
+        return vr::VRCompositorError_InvalidTexture;
+
+    if (pBounds != nullptr)
+    {
+        auto InRange = [](float v) { return v >= 0.f && v <= 1.f; };
+        if (!InRange(pBounds->uMin) || !InRange(pBounds->uMax) || !InRange(pBounds->vMin) || !InRange(pBounds->vMax) ||
+            pBounds->uMin == pBounds->uMax || pBounds->vMin == pBounds->vMax)
+            return vr::VRCompositorError_InvalidBounds;
+    }
+
+    if (m_EyeSubmitted[eye])
+        return vr::VRCompositorError_AlreadySubmitted;
+
+    m_EyeSubmitted[eye] = true;
+    if (m_EyeSubmitted[vr::Eye_Left] && m_EyeSubmitted[vr::Eye_Right])
+    {
+        ++m_SubmittedFrames;
+        m_LastSubmitTime = Clock::now();
+    }
+
+    return vr::VRCompositorError_None;
+}
+
+void SimulatedVRRuntime::LoadPoseRecording(const char* Path)
+{
+    std::ifstream file(Path);
+    if (!file)
+        throw std::runtime_error(std::string("Failed to open pose recording ") + Path);
+
+    m_RecordedPoses.clear();
+
+    std::string line;
+    uint32_t    lineNum = 0;
+    while (std::getline(file, line))
+    {
+        ++lineNum;
+        if (line.empty() || line[0] == '#')
+            continue;
+
+        std::istringstream ss(line);
+
+        uint32_t          frame = 0, deviceIdx = 0;
+        vr::HmdMatrix34_t mat   = {};
+        ss >> frame >> deviceIdx;
+        for (int row = 0; row < 3; ++row)
+        {
+            for (int col = 0; col < 4; ++col)
+                ss >> mat.m[row][col];
+        }
+        if (!ss || deviceIdx >= m_NumDevices || frame >= MaxRecordedFrames || frame > m_RecordedPoses.size() + MaxRecordedFrameGap)
+            throw std::runtime_error(std::string("Malformed pose recording ") + Path + " at line " + std::to_string(lineNum));
+
+        if (frame >= m_RecordedPoses.size())
+        {
+            DevicePoses invalid;
+            invalid.fill(MakeInvalidPose());
+            m_RecordedPoses.resize(frame + 1, invalid);
+        }
+        m_RecordedPoses[frame][deviceIdx] = MakeValidPose(mat);
+    }
+
+    if (m_RecordedPoses.empty())
+        throw std::runtime_error(std::string("Pose recording ") + Path + " contains no frames");
+}
+
+void SimulatedVRRuntime::GenerateSyntheticPoses(double time, DevicePoses& poses) const
+{
+    const float t = static_cast<float>(time);
+
+    // seated user slowly looking around, hands circling in front of the head
+    poses[vr::k_unTrackedDeviceIndex_Hmd] = MakeValidPose(MakeYawTranslation(0.35f * std::sin(0.5f * t), 0.02f * std::sin(1.3f * t), 1.2f, 0.f));
+
+    const float handPhase     = 1.7f * t;
+    poses[LeftControllerIdx]  = MakeValidPose(MakeYawTranslation(0.f, -0.2f + 0.1f * std::cos(handPhase), 1.0f + 0.1f * std::sin(handPhase), -0.4f));
+    poses[RightControllerIdx] = MakeValidPose(MakeYawTranslation(0.f, 0.2f - 0.1f * std::cos(handPhase), 1.0f - 0.1f * std::sin(handPhase), -0.4f));
+
+    // trackers spread around the body between hips and feet, swaying slightly
+    for (uint32_t tracker = 0; tracker < m_Desc.NumTrackers; ++tracker)
+    {
+        const float angle  = 6.2831853f * static_cast<float>(tracker) / static_cast<float>(m_Desc.NumTrackers);
+        const float height = 0.1f + 0.8f * static_cast<float>(tracker % 3) / 2.f;
+        const float sway   = 0.03f * std::sin(t + angle);
+
+        poses[FirstTrackerIdx + tracker] = MakeValidPose(MakeYawTranslation(angle, 0.15f * std::sin(angle) + sway, height, 0.15f * std::cos(angle)));
+    }
+    for (uint32_t deviceIdx = m_NumDevices; deviceIdx < MaxDevices; ++deviceIdx)
+        poses[deviceIdx] = MakeInvalidPose();
+}
@@ -0,0 +1,122 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <deque>
+#include <vector>
+#include "VRRuntime.h"
+
+struct SimulatedHMDDesc
+{
+    uint32_t RenderWidth  = 1440;
+    uint32_t RenderHeight = 1600;
+
+    // fake compositor cadence; without throttling WaitGetPoses returns immediately
+    float RefreshRate     = 90.f;
+    bool  ThrottleToVSync = true;
+
+    // display latency after vsync, part of the predicted seconds to photons
+    float SecondsFromVSyncToPhotons = 0.011f;
+
+    float IPD = 0.064f;
+
+    // generic trackers after the controllers, e.g. for full-body tracking
+    uint32_t NumTrackers = 0;
+
+    // tangents of the half-angles of each eye's field of view (inner side is narrower)
+    float FovTanOuter = 1.39f;
+    float FovTanInner = 1.25f;
+    float FovTanUp    = 1.47f;
+    float FovTanDown  = 1.47f;
+
+    // optional text file with recorded poses, see LoadPoseRecording()
+    const char* PoseRecordingPath = nullptr;
+};
+
+// Headless stand-in for SteamVR: device 0 is the HMD, 1 and 2 are the left and right controllers,
+// followed by SimulatedHMDDesc::NumTrackers generic trackers. All devices are reported as activated
+// through PollNextEvent() before the first frame.
+class SimulatedVRRuntime final : public IVRRuntime
+{
+public:
+    static constexpr vr::TrackedDeviceIndex_t LeftControllerIdx  = 1;
+    static constexpr vr::TrackedDeviceIndex_t RightControllerIdx = 2;
+    static constexpr vr::TrackedDeviceIndex_t FirstTrackerIdx    = 3;
+    static constexpr uint32_t                 MaxTrackers        = 13;
+    static constexpr uint32_t                 MaxDevices         = FirstTrackerIdx + MaxTrackers;
+
+    explicit SimulatedVRRuntime(const SimulatedHMDDesc& Desc);
+
+    void GetRecommendedRenderTargetSize(uint32_t* pWidth, uint32_t* pHeight) override;
+
+    vr::HmdMatrix44_t GetProjectionMatrix(vr::EVREye eye, float nearZ, float farZ) override;
+
+    vr::HmdMatrix34_t GetEyeToHeadTransform(vr::EVREye eye) override;
+
+    vr::ETrackedDeviceClass GetTrackedDeviceClass(vr::TrackedDeviceIndex_t deviceIdx) override;
+
+    vr::ETrackedControllerRole GetControllerRoleForTrackedDeviceIndex(vr::TrackedDeviceIndex_t deviceIdx) override;
+
+    uint32_t GetStringTrackedDeviceProperty(vr::TrackedDeviceIndex_t deviceIdx, vr::ETrackedDeviceProperty prop, char* pValue, uint32_t bufferSize) override;
+
+    bool PollNextEvent(vr::VREvent_t* pEvent) override;
+
+    vr::EVRCompositorError WaitGetPoses(vr::TrackedDevicePose_t* pRenderPoses, uint32_t numPoses) override;
+
+    float GetFrameDuration() override;
+
+    // WaitGetPoses() returning counts as the vsync
+    float GetPredictedSecondsToPhotons() override;
+
+    // poses at the simulated time the prediction points to; predicting the current frame's photons
+    // yields the WaitGetPoses() poses, as the simulation has no tracking error to correct
+    void GetDeviceToAbsoluteTrackingPose(float predictedSecondsToPhotons, vr::TrackedDevicePose_t* pPoses, uint32_t numPoses) override;
+
+    // a frame that misses vsyncs is reported with them as dropped frames and CPU reprojection; there
+    // is no GPU, so the GPU times are zero
+    bool GetFrameTiming(vr::Compositor_FrameTiming* pTiming, uint32_t framesAgo) override;
+
+    vr::EVRCompositorError Submit(vr::EVREye eye, const vr::Texture_t* pTexture, const vr::VRTextureBounds_t* pBounds) override;
+
+    // Each non-empty line is "<frame> <device> m00 m01 m02 m03 m10 ... m23" (row-major HmdMatrix34_t),
+    // lines starting with '#' are ignored. Playback loops over the recorded frames. Frames past an hour
+    // at 90 Hz, or more than ten seconds after the last recorded one, are rejected as malformed.
+    void LoadPoseRecording(const char* Path);
+
+    uint64_t GetFrameIndex() const { return m_FrameIndex; }
+    uint64_t GetSubmittedFrameCount() const { return m_SubmittedFrames; }
+    uint64_t GetMissedVSyncCount() const { return m_MissedVSyncs; }
+
+private:
+    using DevicePoses = std::array<vr::TrackedDevicePose_t, MaxDevices>;
+    using Clock       = std::chrono::steady_clock;
+
+    void GenerateSyntheticPoses(double time, DevicePoses& poses) const;
+
+    void SamplePoses(double time, vr::TrackedDevicePose_t* pPoses, uint32_t numPoses) const;
+
+    double GetFramePeriod() const { return 1.0 / m_Desc.RefreshRate; }
+
+    // completes the timing of the frame before the one WaitGetPoses() is starting
+    void FinishFrameTiming(Clock::time_point WaitCalledTime, uint32_t MissedVSyncs);
+
+    SimulatedHMDDesc m_Desc;
+    uint32_t         m_NumDevices;
+
+    std::deque<vr::VREvent_t> m_Events;
+
+    std::vector<DevicePoses> m_RecordedPoses;
+
+    Clock::time_point m_NextVSync;
+    Clock::time_point m_LastPosesTime;
+    Clock::time_point m_LastSubmitTime;
+    bool              m_Started = false;
+
+    static constexpr uint32_t                                NumFrameTimings = 16;
+    std::array<vr::Compositor_FrameTiming, NumFrameTimings> m_FrameTimings = {};
+
+    uint64_t m_FrameIndex      = 0;
+    uint64_t m_SubmittedFrames = 0;
+    uint64_t m_MissedVSyncs    = 0;
+    bool     m_EyeSubmitted[2] = {};
+};
@@ -0,0 +1,70 @@
+#include "SimulationThread.h"
+#include "AllocationTracker.h"
+#include <chrono>
+#include <stdexcept>
+
+SimulationThread::SimulationThread(double TickRate, UpdateFunction Update) :
+    m_TickRate(TickRate),
+    m_Update(std::move(Update))
+{
+    if (m_TickRate <= 0)
+        throw std::runtime_error("Simulation tick rate must be positive");
+}
+
+SimulationThread::~SimulationThread()
+{
+    Stop();
+}
+
+void SimulationThread::Start()
+{
+    if (m_Running.exchange(true))
+        return;
+    m_Thread = std::thread(&SimulationThread::Run, this);
+}
+
+void SimulationThread::Stop()
+{
+    m_Running.store(false);
+    if (m_Thread.joinable())
+        m_Thread.join();
+}
+
+void SimulationThread::Run()
+{
+    // ticks are not part of the render thread's frames
+    AllocationTracker::IgnoreCurrentThread();
+
+    using Clock = std::chrono::steady_clock;
+
+    const double deltaTime = 1.0 / m_TickRate;
+    const auto   period    = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(deltaTime));
+
+    // fixed time step, so the simulation does not depend on how often the renderer looks at it
+    uint64_t tick     = m_TickCount.load(std::memory_order_relaxed);
+    auto     nextTick = Clock::now();
+    while (m_Running.load(std::memory_order_relaxed))
+    {
+        const double time = static_cast<double>(tick) * deltaTime;
+
+        SceneSnapshot& scene = m_Snapshots.GetWriteBuffer();
+        scene.TickIndex      = tick + 1;
+        scene.Time           = time;
+        m_Update(time, deltaTime, scene);
+        m_Snapshots.Publish();
+
+        ++tick;
+        m_TickCount.store(tick, std::memory_order_relaxed);
+
+        // only the simulation's own cadence is waited for, never the renderer
+        nextTick += period;
+        const auto now = Clock::now();
+        if (now > nextTick)
+        {
+            m_LateTicks.fetch_add(1, std::memory_order_relaxed);
+            nextTick = now;
+        }
+        else
+            std::this_thread::sleep_until(nextTick);
+    }
+}
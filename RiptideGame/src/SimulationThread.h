@@ -0,0 +1,47 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include "SceneSnapshot.h"
+#include "TripleBuffer.h"
+
+// Runs the game simulation at a fixed tick rate on its own thread and publishes a scene snapshot
+// after every tick. The render thread picks up the latest complete snapshot without blocking.
+class SimulationThread
+{
+public:
+    // Scene is a recycled snapshot from an earlier tick and must be fully rewritten;
+    // TickIndex and Time are filled in by the thread
+    using UpdateFunction = std::function<void(double Time, double DeltaTime, SceneSnapshot& Scene)>;
+
+    SimulationThread(double TickRate, UpdateFunction Update);
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    void Start();
+    void Stop();
+
+    // render thread only: valid until the next call
+    const SceneSnapshot& AcquireLatest() { return m_Snapshots.AcquireLatest(); }
+
+    uint64_t GetTickCount() const { return m_TickCount.load(std::memory_order_relaxed); }
+
+    // ticks that started after their scheduled time because the previous one overran
+    uint64_t GetLateTickCount() const { return m_LateTicks.load(std::memory_order_relaxed); }
+
+private:
+    void Run();
+
+    const double   m_TickRate;
+    UpdateFunction m_Update;
+
+    TripleBuffer<SceneSnapshot> m_Snapshots;
+
+    std::thread           m_Thread;
+    std::atomic<bool>     m_Running{false};
+    std::atomic<uint64_t> m_TickCount{0};
+    std::atomic<uint64_t> m_LateTicks{0};
+};
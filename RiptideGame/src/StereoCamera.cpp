@@ -0,0 +1,145 @@
+#include "StereoCamera.h"
+#include <algorithm>
+#include <stdexcept>
+#include "TrackedDeviceRegistry.h"
+
+StereoCamera::StereoCamera(IVRRuntime* pRuntime, float NearZ, float FarZ) :
+    m_pRuntime(pRuntime),
+    m_NearZ(NearZ),
+    m_FarZ(FarZ)
+{
+    if (m_pRuntime == nullptr)
+        throw std::runtime_error("Stereo camera requires a runtime");
+
+    for (uint32_t eye = 0; eye < 2; ++eye)
+    {
+        m_View[eye]     = float4x4::Identity();
+        m_ViewProj[eye] = float4x4::Identity();
+        m_InvView[eye]  = float4x4::Identity();
+    }
+    m_CullViewProj = float4x4::Identity();
+}
+
+void StereoCamera::HandleEvent(const vr::VREvent_t& Event)
+{
+    switch (Event.eventType)
+    {
+        case vr::VREvent_IpdChanged:
+        case vr::VREvent_LensDistortionChanged:
+            m_EyesDirty = true;
+            break;
+
+        case vr::VREvent_PropertyChanged:
+            if (Event.trackedDeviceIndex == vr::k_unTrackedDeviceIndex_Hmd && Event.data.property.prop == vr::Prop_UserIpdMeters_Float)
+                m_EyesDirty = true;
+            break;
+
+        case vr::VREvent_TrackedDeviceActivated:
+            // a reconnected headset may not be the same one
+            if (Event.trackedDeviceIndex == vr::k_unTrackedDeviceIndex_Hmd)
+                m_EyesDirty = true;
+            break;
+
+        default:
+            break;
+    }
+}
+
+void StereoCamera::Update(const float4x4& HeadPose)
+{
+    if (m_EyesDirty)
+        UpdateEyes();
+
+    // row vectors: world -> head -> eye -> clip
+    const float4x4 headView = InverseRigid(HeadPose);
+    for (uint32_t eye = 0; eye < 2; ++eye)
+    {
+        m_View[eye]     = headView * m_HeadToEye[eye];
+        m_ViewProj[eye] = m_View[eye] * m_Proj[eye];
+        m_InvView[eye]  = m_EyeToHead[eye] * HeadPose;
+    }
+
+    m_CullViewProj = headView * m_CullProj;
+    ExtractViewFrustumPlanesFromMatrix(m_CullViewProj, m_CullFrustum, false);
+}
+
+float4x4 StereoCamera::InverseRigid(const float4x4& Mat)
+{
+    // transposed rotation, and the translation rotated back and negated
+    float4x4 inv = float4x4::Identity();
+    for (int row = 0; row < 3; ++row)
+    {
+        for (int col = 0; col < 3; ++col)
+            inv.m[row][col] = Mat.m[col][row];
+    }
+    for (int col = 0; col < 3; ++col)
+        inv.m[3][col] = -(Mat.m[3][0] * Mat.m[col][0] + Mat.m[3][1] * Mat.m[col][1] + Mat.m[3][2] * Mat.m[col][2]);
+    return inv;
+}
+
+void StereoCamera::UpdateEyes()
+{
+    m_EyesDirty = false;
+
+    float  left = 0, right = 0, bottom = 0, top = 0;
+    float3 eyeOffset[2];
+    for (uint32_t eye = 0; eye < 2; ++eye)
+    {
+        const vr::EVREye        vrEye = static_cast<vr::EVREye>(eye);
+        const vr::HmdMatrix44_t proj  = m_pRuntime->GetProjectionMatrix(vrEye, m_NearZ, m_FarZ);
+
+        // transposed for row vectors, with the z flip of the left-handed eye space
+        m_Proj[eye] = float4x4(
+            proj.m[0][0], proj.m[1][0], proj.m[2][0], proj.m[3][0],
+            proj.m[0][1], proj.m[1][1], proj.m[2][1], proj.m[3][1],
+            -proj.m[0][2], -proj.m[1][2], -proj.m[2][2], -proj.m[3][2],
+            proj.m[0][3], proj.m[1][3], proj.m[2][3], proj.m[3][3]);
+
+        const vr::HmdMatrix34_t  eyeToHead = m_pRuntime->GetEyeToHeadTransform(vrEye);
+        const vr::HmdMatrix34_t* pSrc      = &eyeToHead;
+        TrackedDeviceRegistry::ConvertPoses(&pSrc, &m_EyeToHead[eye], 1);
+        m_HeadToEye[eye] = InverseRigid(m_EyeToHead[eye]);
+        eyeOffset[eye]   = float3(m_EyeToHead[eye].m[3][0], m_EyeToHead[eye].m[3][1], m_EyeToHead[eye].m[3][2]);
+
+        // tangents of the frustum sides, where clip x or y equals -w or w (w = z * m23)
+        const float4x4& p         = m_Proj[eye];
+        const float     tanLeft   = (-p.m[2][3] - p.m[2][0]) / p.m[0][0];
+        const float     tanRight  = (p.m[2][3] - p.m[2][0]) / p.m[0][0];
+        const float     tanBottom = (-p.m[2][3] - p.m[2][1]) / p.m[1][1];
+        const float     tanTop    = (p.m[2][3] - p.m[2][1]) / p.m[1][1];
+
+        left   = std::min({left, tanLeft, tanRight});
+        right  = std::max({right, tanLeft, tanRight});
+        bottom = std::min({bottom, tanBottom, tanTop});
+        top    = std::max({top, tanBottom, tanTop});
+    }
+
+    // the combined frustum has the outermost tangents of both eyes, its apex is moved back from
+    // the head until each eye's apex, and therefore its whole frustum, is inside;
+    // this assumes parallel eye axes, which is what the runtime reports for common headsets
+    float apexDist = 0;
+    float minEyeZ  = eyeOffset[0].z;
+    float maxEyeZ  = eyeOffset[0].z;
+    for (const float3& offset : eyeOffset)
+    {
+        if (left < 0)
+            apexDist = std::max(apexDist, offset.x / left - offset.z);
+        if (right > 0)
+            apexDist = std::max(apexDist, offset.x / right - offset.z);
+        if (bottom < 0)
+            apexDist = std::max(apexDist, offset.y / bottom - offset.z);
+        if (top > 0)
+            apexDist = std::max(apexDist, offset.y / top - offset.z);
+        minEyeZ = std::min(minEyeZ, offset.z);
+        maxEyeZ = std::max(maxEyeZ, offset.z);
+    }
+
+    const float    nearZ = apexDist + minEyeZ + m_NearZ;
+    const float    farZ  = apexDist + maxEyeZ + m_FarZ;
+    const float4x4 cullProj(
+        2.f / (right - left), 0, 0, 0,
+        0, 2.f / (top - bottom), 0, 0,
+        -(right + left) / (right - left), -(top + bottom) / (top - bottom), farZ / (farZ - nearZ), 1,
+        0, 0, -nearZ * farZ / (farZ - nearZ), 0);
+    m_CullProj = float4x4::Translation(0, 0, apexDist) * cullProj;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "BasicMath.hpp"
+#include "AdvancedMath.hpp"
+#include "VRRuntime.h"
+
+using namespace Diligent;
+
+// Per-eye projection and eye-to-head transforms cached from the runtime, plus the view matrices
+// and the culling frustum derived from them once per head pose. The eye transforms only change
+// with the IPD or the lenses, they are re-queried after the runtime sends an event about it.
+class StereoCamera
+{
+public:
+    explicit StereoCamera(IVRRuntime* pRuntime, float NearZ = 0.025f, float FarZ = 1000.0f);
+
+    // marks the cached eye transforms stale, they are re-queried by the next Update()
+    void HandleEvent(const vr::VREvent_t& Event);
+
+    // HeadPose is the HMD's head-to-tracking transform as converted by TrackedDeviceRegistry
+    void Update(const float4x4& HeadPose);
+
+    const float4x4& GetProj(uint32_t Eye) const { return m_Proj[Eye]; }
+    const float4x4& GetView(uint32_t Eye) const { return m_View[Eye]; }
+    const float4x4& GetViewProj(uint32_t Eye) const { return m_ViewProj[Eye]; }
+
+    // eye-to-tracking transform, its last row is the eye position
+    const float4x4& GetInvView(uint32_t Eye) const { return m_InvView[Eye]; }
+
+    // one frustum that contains both eyes' frusta, so everything is culled once for both eyes
+    const ViewFrustum& GetCullFrustum() const { return m_CullFrustum; }
+    const float4x4&    GetCullViewProj() const { return m_CullViewProj; }
+
+    // inverse of a rotation and translation, much cheaper than a general 4x4 inverse
+    static float4x4 InverseRigid(const float4x4& Mat);
+
+private:
+    void UpdateEyes();
+
+    IVRRuntime* m_pRuntime;
+    const float m_NearZ;
+    const float m_FarZ;
+
+    // cached until the eyes change
+    bool     m_EyesDirty = true;
+    float4x4 m_Proj[2];
+    float4x4 m_EyeToHead[2];
+    float4x4 m_HeadToEye[2];
+    float4x4 m_CullProj; // head space to the clip space of the combined frustum
+
+    // per head pose
+    float4x4    m_View[2];
+    float4x4    m_ViewProj[2];
+    float4x4    m_InvView[2];
+    float4x4    m_CullViewProj;
+    ViewFrustum m_CullFrustum;
+};
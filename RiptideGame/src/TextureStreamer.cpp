@@ -0,0 +1,284 @@
+#include "TextureStreamer.h"
+#include <algorithm>
+#include "AllocationTracker.h"
+#include "GraphicsAccessories.hpp"
+
+TextureStreamer::TextureStreamer(IRenderDevice* pDevice, const TextureStreamerDesc& Desc) :
+    m_pDevice(pDevice),
+    m_Desc(Desc)
+{
+    const uint32_t numThreads = std::max(1u, m_Desc.NumDecodeThreads);
+    for (uint32_t i = 0; i < numThreads; ++i)
+        m_DecodeThreads.emplace_back(&TextureStreamer::DecodeLoop, this);
+}
+
+TextureStreamer::~TextureStreamer()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Shutdown = true;
+    }
+    m_JobAvailable.notify_all();
+    for (std::thread& thread : m_DecodeThreads)
+        thread.join();
+}
+
+TextureStreamer::Handle TextureStreamer::Request(const char* Path, bool IsSRGB)
+{
+    const Handle tex = static_cast<Handle>(m_Entries.size());
+
+    Entry entry;
+    entry.Path          = Path;
+    entry.IsSRGB        = IsSRGB;
+    entry.LastUsedFrame = m_FrameIndex;
+    m_Entries.push_back(std::move(entry));
+    ++m_Stats.NumTextures;
+
+    QueueDecode(tex);
+    return tex;
+}
+
+void TextureStreamer::MarkUsed(Handle Tex)
+{
+    m_Entries[Tex].LastUsedFrame = m_FrameIndex;
+}
+
+ITextureView* TextureStreamer::GetSRV(Handle Tex) const
+{
+    const Entry& entry = m_Entries[Tex];
+    return entry.Texture ? entry.Texture->GetDefaultView(TEXTURE_VIEW_SHADER_RESOURCE) : nullptr;
+}
+
+void TextureStreamer::QueueDecode(Handle Tex)
+{
+    Entry& entry        = m_Entries[Tex];
+    entry.DecodePending = true;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Jobs.push_back({Tex, entry.Path, entry.IsSRGB});
+    }
+    m_JobAvailable.notify_one();
+}
+
+void TextureStreamer::DecodeLoop()
+{
+    // decoding allocates whenever a file arrives, independently of the frames
+    AllocationTracker::IgnoreCurrentThread();
+
+    for (;;)
+    {
+        DecodeJob job;
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_JobAvailable.wait(lock, [this]() { return m_Shutdown || !m_Jobs.empty(); });
+            if (m_Shutdown)
+                return;
+            job = std::move(m_Jobs.front());
+            m_Jobs.pop_front();
+        }
+
+        // the loader decodes the file and generates the mips in system memory, nothing touches the GPU
+        TextureLoadInfo loadInfo;
+        loadInfo.Name         = job.Path.c_str();
+        loadInfo.IsSRGB       = job.IsSRGB;
+        loadInfo.GenerateMips = true;
+
+        RefCntAutoPtr<ITextureLoader> pLoader;
+        CreateTextureLoaderFromFile(job.Path.c_str(), IMAGE_FILE_FORMAT_UNKNOWN, loadInfo, &pLoader);
+
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Results.push_back({job.Tex, std::move(pLoader)});
+    }
+}
+
+void TextureStreamer::Update(IDeviceContext* pContext, FrameArena& Arena)
+{
+    ++m_FrameIndex;
+    m_Stats.UploadedBytes  = 0;
+    m_Stats.NumEvictedMips = 0;
+
+    std::vector<DecodeResult> results;
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        results.swap(m_Results);
+    }
+    for (DecodeResult& result : results)
+    {
+        Entry& entry        = m_Entries[result.Tex];
+        entry.DecodePending = false;
+        if (!result.Loader)
+        {
+            entry.Failed = true;
+            ++m_Stats.NumFailed;
+            continue;
+        }
+
+        entry.Loader = std::move(result.Loader);
+        if (!entry.Texture)
+        {
+            entry.FullDesc    = entry.Loader->GetTextureDesc();
+            entry.ResidentMip = entry.FullDesc.MipLevels;
+
+            // the first mip that fits into the tail size, or the last one
+            entry.TailMip = 0;
+            while (entry.TailMip + 1 < entry.FullDesc.MipLevels &&
+                   std::max(entry.FullDesc.Width >> entry.TailMip, entry.FullDesc.Height >> entry.TailMip) > m_Desc.MipTailSize)
+                ++entry.TailMip;
+        }
+    }
+
+    // textures in use that lost mips to eviction are decoded again
+    for (Handle tex = 0; tex < m_Entries.size(); ++tex)
+    {
+        const Entry& entry = m_Entries[tex];
+        if (entry.Texture && entry.ResidentMip > 0 && !entry.Loader && !entry.DecodePending && IsRecentlyUsed(entry))
+            QueueDecode(tex);
+    }
+
+    EvictStale(pContext, Arena);
+
+    // mip tails first, so every decoded texture becomes usable before any of them gains detail
+    auto BudgetLeft = [&]() { return m_Stats.UploadedBytes == 0 || m_Stats.UploadedBytes < m_Desc.UploadBudget; };
+    for (Entry& entry : m_Entries)
+    {
+        if (!BudgetLeft())
+            break;
+        if (entry.Loader && !entry.Texture)
+            SetResidentMip(pContext, entry, entry.TailMip);
+    }
+
+    // then one level per texture and round, the most recently used ones first
+    FrameVector<Entry*> streaming{FrameArenaAllocator<Entry*>(Arena)};
+    streaming.reserve(m_Entries.size());
+    for (Entry& entry : m_Entries)
+    {
+        if (entry.Loader && entry.Texture && IsRecentlyUsed(entry))
+            streaming.push_back(&entry);
+    }
+    std::sort(streaming.begin(), streaming.end(), [](const Entry* a, const Entry* b) { return a->LastUsedFrame > b->LastUsedFrame; });
+
+    bool progress = true;
+    while (progress && BudgetLeft())
+    {
+        progress = false;
+        for (Entry* pEntry : streaming)
+        {
+            if (!BudgetLeft())
+                break;
+            if (pEntry->ResidentMip == 0)
+                continue;
+
+            const uint64_t levelBytes = GetMipRangeSize(pEntry->FullDesc, pEntry->ResidentMip - 1, pEntry->ResidentMip);
+            if (m_Stats.ResidentBytes + levelBytes > m_Desc.MemoryBudget)
+                continue;
+
+            SetResidentMip(pContext, *pEntry, pEntry->ResidentMip - 1);
+            progress = true;
+        }
+    }
+
+    // the decoded data is only needed until every mip is resident
+    m_Stats.NumFullyResident = 0;
+    for (Entry& entry : m_Entries)
+    {
+        if (entry.Texture && entry.ResidentMip == 0)
+        {
+            entry.Loader.Release();
+            ++m_Stats.NumFullyResident;
+        }
+    }
+}
+
+void TextureStreamer::EvictStale(IDeviceContext* pContext, FrameArena& Arena)
+{
+    if (m_Stats.ResidentBytes <= m_Desc.MemoryBudget)
+        return;
+
+    // least recently used first, mip tails always stay
+    FrameVector<Entry*> candidates{FrameArenaAllocator<Entry*>(Arena)};
+    candidates.reserve(m_Entries.size());
+    for (Entry& entry : m_Entries)
+    {
+        if (entry.Texture && entry.ResidentMip < entry.TailMip && !IsRecentlyUsed(entry))
+            candidates.push_back(&entry);
+    }
+    std::sort(candidates.begin(), candidates.end(), [](const Entry* a, const Entry* b) { return a->LastUsedFrame < b->LastUsedFrame; });
+
+    for (Entry* pEntry : candidates)
+    {
+        if (m_Stats.ResidentBytes <= m_Desc.MemoryBudget)
+            break;
+
+        // drops levels until the budget is met, but all at once to copy the texture only once
+        uint32_t newResidentMip = pEntry->ResidentMip;
+        uint64_t freedBytes     = 0;
+        while (newResidentMip < pEntry->TailMip && m_Stats.ResidentBytes - freedBytes > m_Desc.MemoryBudget)
+        {
+            freedBytes += GetMipRangeSize(pEntry->FullDesc, newResidentMip, newResidentMip + 1);
+            ++newResidentMip;
+        }
+
+        m_Stats.NumEvictedMips += newResidentMip - pEntry->ResidentMip;
+        pEntry->Loader.Release();
+        SetResidentMip(pContext, *pEntry, newResidentMip);
+    }
+}
+
+void TextureStreamer::SetResidentMip(IDeviceContext* pContext, Entry& Tex, uint32_t NewResidentMip)
+{
+    const TextureDesc& fullDesc = Tex.FullDesc;
+
+    TextureDesc desc = fullDesc;
+    desc.Name        = Tex.Path.c_str();
+    desc.Width       = std::max(1u, fullDesc.Width >> NewResidentMip);
+    desc.Height      = std::max(1u, fullDesc.Height >> NewResidentMip);
+    desc.MipLevels   = fullDesc.MipLevels - NewResidentMip;
+    desc.Usage       = USAGE_DEFAULT;
+    desc.BindFlags   = BIND_SHADER_RESOURCE;
+
+    RefCntAutoPtr<ITexture> pTexture;
+    m_pDevice->CreateTexture(desc, nullptr, &pTexture);
+
+    // new levels come from the decoded data, through the context's upload memory
+    for (uint32_t mip = NewResidentMip; mip < std::min(Tex.ResidentMip, fullDesc.MipLevels); ++mip)
+    {
+        const Box mipBox{0, std::max(1u, fullDesc.Width >> mip), 0, std::max(1u, fullDesc.Height >> mip)};
+        pContext->UpdateTexture(pTexture, mip - NewResidentMip, 0, mipBox, Tex.Loader->GetSubresourceData(mip),
+                                RESOURCE_STATE_TRANSITION_MODE_NONE, RESOURCE_STATE_TRANSITION_MODE_TRANSITION);
+        m_Stats.UploadedBytes += GetMipRangeSize(fullDesc, mip, mip + 1);
+    }
+
+    // levels both textures hold are copied on the GPU
+    if (Tex.Texture)
+    {
+        for (uint32_t mip = std::max(NewResidentMip, Tex.ResidentMip); mip < fullDesc.MipLevels; ++mip)
+        {
+            CopyTextureAttribs copyAttribs{Tex.Texture, RESOURCE_STATE_TRANSITION_MODE_TRANSITION, pTexture, RESOURCE_STATE_TRANSITION_MODE_TRANSITION};
+            copyAttribs.SrcMipLevel = mip - Tex.ResidentMip;
+            copyAttribs.DstMipLevel = mip - NewResidentMip;
+            pContext->CopyTexture(copyAttribs);
+        }
+    }
+
+    const uint64_t newBytes = GetMipRangeSize(fullDesc, NewResidentMip, fullDesc.MipLevels);
+    m_Stats.ResidentBytes   = m_Stats.ResidentBytes - Tex.ResidentBytes + newBytes;
+    Tex.ResidentBytes       = newBytes;
+    Tex.ResidentMip         = NewResidentMip;
+    Tex.Texture             = pTexture;
+}
+
+uint64_t TextureStreamer::GetMipRangeSize(const TextureDesc& Desc, uint32_t FirstMip, uint32_t EndMip) const
+{
+    // block compressed formats store whole blocks, uncompressed ones have 1x1 blocks
+    const TextureFormatAttribs& fmtAttribs = GetTextureFormatAttribs(Desc.Format);
+
+    uint64_t size = 0;
+    for (uint32_t mip = FirstMip; mip < EndMip; ++mip)
+    {
+        const uint32_t width  = std::max(1u, Desc.Width >> mip);
+        const uint32_t height = std::max(1u, Desc.Height >> mip);
+        size += uint64_t{(width + fmtAttribs.BlockWidth - 1u) / fmtAttribs.BlockWidth} *
+            ((height + fmtAttribs.BlockHeight - 1u) / fmtAttribs.BlockHeight) * fmtAttribs.GetElementSize();
+    }
+    return size;
+}
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "RenderDevice.h"
+#include "DeviceContext.h"
+#include "RefCntAutoPtr.hpp"
+#include "TextureLoader.h"
+#include "FrameArena.h"
+
+using namespace Diligent;
+
+struct TextureStreamerDesc
+{
+    bool Enabled = false;
+
+    // threads decoding image files, never the render thread
+    uint32_t NumDecodeThreads = 2;
+
+    // bytes uploaded per Update(); at least one mip level is uploaded per frame, however large
+    uint64_t UploadBudget = 4ull << 20;
+
+    // resident bytes of all textures; above it, textures that were not used for EvictAfterFrames
+    // frames lose their most detailed mips
+    uint64_t MemoryBudget = 256ull << 20;
+    uint32_t EvictAfterFrames = 300;
+
+    // mips up to this size are uploaded together first and never evicted
+    uint32_t MipTailSize = 64;
+};
+
+// Loads textures without stalling the frame. Files are decoded on worker threads; Update() then
+// uploads their mips within a per-frame budget, least detailed first, so a texture is usable as
+// soon as its mip tail is resident. Each level that becomes resident, or is evicted, replaces the
+// texture by one with the new mip range; the mips it keeps are copied on the GPU.
+class TextureStreamer
+{
+public:
+    using Handle = uint32_t;
+
+    struct Stats
+    {
+        uint32_t NumTextures      = 0;
+        uint32_t NumFullyResident = 0;
+        uint32_t NumFailed        = 0;
+        uint64_t ResidentBytes    = 0;
+
+        // during the last Update()
+        uint64_t UploadedBytes  = 0;
+        uint32_t NumEvictedMips = 0;
+    };
+
+    TextureStreamer(IRenderDevice* pDevice, const TextureStreamerDesc& Desc);
+    ~TextureStreamer();
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    // queues the file for decoding, render thread only like everything below
+    Handle Request(const char* Path, bool IsSRGB = true);
+
+    // textures that are used stay fully resident, and lost mips are streamed in again
+    void MarkUsed(Handle Tex);
+
+    // nullptr until the mip tail is resident; the view changes whenever mips are added or
+    // evicted, so it must be fetched every frame
+    ITextureView* GetSRV(Handle Tex) const;
+
+    // picks up decoded files, evicts and uploads; once per frame on the immediate context, the
+    // scratch lists come from the frame's arena
+    void Update(IDeviceContext* pContext, FrameArena& Arena);
+
+    const Stats& GetStats() const { return m_Stats; }
+
+private:
+    struct Entry
+    {
+        std::string Path;
+        bool        IsSRGB = true;
+
+        // the full mip chain, known once the file was decoded for the first time
+        TextureDesc FullDesc;
+        uint32_t    TailMip = 0;
+
+        // decoded mips, released once all of them are resident
+        RefCntAutoPtr<ITextureLoader> Loader;
+
+        // holds the mips from ResidentMip on, FullDesc.MipLevels if there are none
+        RefCntAutoPtr<ITexture> Texture;
+        uint32_t                ResidentMip   = 0;
+        uint64_t                ResidentBytes = 0;
+
+        uint64_t LastUsedFrame = 0;
+        bool     DecodePending = false;
+        bool     Failed        = false;
+    };
+
+    struct DecodeJob
+    {
+        Handle      Tex;
+        std::string Path;
+        bool        IsSRGB;
+    };
+
+    struct DecodeResult
+    {
+        Handle                        Tex;
+        RefCntAutoPtr<ITextureLoader> Loader;
+    };
+
+    void DecodeLoop();
+    void QueueDecode(Handle Tex);
+
+    bool IsRecentlyUsed(const Entry& Tex) const { return Tex.LastUsedFrame + m_Desc.EvictAfterFrames >= m_FrameIndex; }
+
+    void EvictStale(IDeviceContext* pContext, FrameArena& Arena);
+
+    // replaces the entry's texture by one holding the mips from NewResidentMip on
+    void SetResidentMip(IDeviceContext* pContext, Entry& Tex, uint32_t NewResidentMip);
+
+    uint64_t GetMipRangeSize(const TextureDesc& Desc, uint32_t FirstMip, uint32_t EndMip) const;
+
+    IRenderDevice*            m_pDevice;
+    const TextureStreamerDesc m_Desc;
+
+    std::vector<Entry> m_Entries;
+    uint64_t           m_FrameIndex = 0;
+    Stats              m_Stats;
+
+    std::vector<std::thread>  m_DecodeThreads;
+    std::mutex                m_Mutex;
+    std::condition_variable   m_JobAvailable;
+    std::deque<DecodeJob>     m_Jobs;
+    std::vector<DecodeResult> m_Results;
+    bool                      m_Shutdown = false;
+};
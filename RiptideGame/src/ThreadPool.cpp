@@ -0,0 +1,73 @@
+#include "ThreadPool.h"
+
+ThreadPool::ThreadPool(uint32_t NumThreads)
+{
+    m_Threads.reserve(NumThreads);
+    for (uint32_t i = 0; i < NumThreads; ++i)
+        m_Threads.emplace_back(&ThreadPool::WorkerLoop, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Shutdown = true;
+    }
+    m_WorkAvailable.notify_all();
+    for (std::thread& thread : m_Threads)
+        thread.join();
+}
+
+bool ThreadPool::RunNextTask(std::unique_lock<std::mutex>& Lock)
+{
+    if (m_pTask == nullptr || m_NextTask >= m_NumTasks)
+        return false;
+
+    const uint32_t     taskIdx   = m_NextTask++;
+    const TaskFunction pFunction = m_pFunction;
+    const void*        pTask     = m_pTask;
+
+    Lock.unlock();
+    pFunction(pTask, taskIdx);
+    Lock.lock();
+
+    if (--m_PendingTasks == 0)
+        m_JobDone.notify_all();
+    return true;
+}
+
+void ThreadPool::WorkerLoop()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    while (true)
+    {
+        m_WorkAvailable.wait(lock, [this] { return m_Shutdown || (m_pTask != nullptr && m_NextTask < m_NumTasks); });
+        if (m_Shutdown)
+            return;
+
+        while (RunNextTask(lock))
+        {
+        }
+    }
+}
+
+void ThreadPool::Run(uint32_t NumTasks, TaskFunction pFunction, const void* pTask)
+{
+    if (NumTasks == 0)
+        return;
+
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_pFunction    = pFunction;
+    m_pTask        = pTask;
+    m_NumTasks     = NumTasks;
+    m_NextTask     = 0;
+    m_PendingTasks = NumTasks;
+    if (NumTasks > 1)
+        m_WorkAvailable.notify_all();
+
+    while (RunNextTask(lock))
+    {
+    }
+    m_JobDone.wait(lock, [this] { return m_PendingTasks == 0; });
+    m_pTask = nullptr;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for fork/join work inside a frame.
+// ParallelFor() blocks until every task has run; the calling thread runs tasks as well.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(uint32_t NumThreads);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    uint32_t GetNumThreads() const { return static_cast<uint32_t>(m_Threads.size()); }
+
+    // runs Task(TaskIdx) for TaskIdx in [0, NumTasks), tasks may run in any order and on any thread;
+    // only one thread may call ParallelFor() at a time. Task is called through a pointer instead of
+    // being wrapped in a std::function, so a frame's parallel loops do not allocate
+    template <typename TaskType>
+    void ParallelFor(uint32_t NumTasks, const TaskType& Task)
+    {
+        Run(NumTasks, [](const void* pTask, uint32_t TaskIdx) { (*static_cast<const TaskType*>(pTask))(TaskIdx); }, &Task);
+    }
+
+private:
+    using TaskFunction = void (*)(const void* pTask, uint32_t TaskIdx);
+
+    void Run(uint32_t NumTasks, TaskFunction pFunction, const void* pTask);
+
+    void WorkerLoop();
+
+    // runs the next task of the current job, returns false if there is none left
+    bool RunNextTask(std::unique_lock<std::mutex>& Lock);
+
+    std::vector<std::thread> m_Threads;
+
+    std::mutex              m_Mutex;
+    std::condition_variable m_WorkAvailable;
+    std::condition_variable m_JobDone;
+
+    TaskFunction m_pFunction    = nullptr;
+    const void*  m_pTask        = nullptr;
+    uint32_t     m_NumTasks     = 0;
+    uint32_t     m_NextTask     = 0;
+    uint32_t     m_PendingTasks = 0;
+    bool         m_Shutdown     = false;
+};
@@ -0,0 +1,185 @@
+#include "TrackedDeviceRegistry.h"
+#include <stdexcept>
+#include "Simd.h"
+
+TrackedDeviceRegistry::TrackedDeviceRegistry(IVRRuntime* pRuntime) :
+    m_pRuntime(pRuntime)
+{
+    if (m_pRuntime == nullptr)
+        throw std::runtime_error("Tracked device registry requires a runtime");
+
+    Rescan();
+}
+
+void TrackedDeviceRegistry::Rescan()
+{
+    for (vr::TrackedDeviceIndex_t deviceIdx = 0; deviceIdx < vr::k_unMaxTrackedDeviceCount; ++deviceIdx)
+        QueryDevice(deviceIdx);
+    RebuildActiveList();
+}
+
+void TrackedDeviceRegistry::HandleEvent(const vr::VREvent_t& Event)
+{
+    const vr::TrackedDeviceIndex_t deviceIdx = Event.trackedDeviceIndex;
+    switch (Event.eventType)
+    {
+        case vr::VREvent_TrackedDeviceActivated:
+        case vr::VREvent_TrackedDeviceUpdated:
+            if (deviceIdx < vr::k_unMaxTrackedDeviceCount)
+            {
+                QueryDevice(deviceIdx);
+                m_ActiveDirty = true;
+            }
+            break;
+
+        case vr::VREvent_TrackedDeviceDeactivated:
+            if (deviceIdx < vr::k_unMaxTrackedDeviceCount)
+            {
+                m_Devices[deviceIdx] = {};
+                m_ActiveDirty        = true;
+            }
+            break;
+
+        case vr::VREvent_TrackedDeviceRoleChanged:
+            // not reliably sent for the device whose role changed, e.g. when hands are swapped
+            QueryRoles();
+            m_ActiveDirty = true;
+            break;
+
+        case vr::VREvent_PropertyChanged:
+            if (deviceIdx < vr::k_unMaxTrackedDeviceCount && m_Devices[deviceIdx].Class != vr::TrackedDeviceClass_Invalid)
+            {
+                const vr::ETrackedDeviceProperty prop = Event.data.property.prop;
+                if (prop == vr::Prop_ModelNumber_String)
+                    m_Devices[deviceIdx].ModelNumber = GetStringProperty(deviceIdx, prop);
+                else if (prop == vr::Prop_SerialNumber_String)
+                    m_Devices[deviceIdx].SerialNumber = GetStringProperty(deviceIdx, prop);
+            }
+            break;
+
+        default:
+            break;
+    }
+}
+
+bool TrackedDeviceRegistry::CommitEvents()
+{
+    if (!m_ActiveDirty)
+        return false;
+
+    RebuildActiveList();
+    return true;
+}
+
+uint32_t TrackedDeviceRegistry::FindSlot(vr::ETrackedDeviceClass Class, vr::ETrackedControllerRole Role) const
+{
+    for (uint32_t slot = 0; slot < m_Active.size(); ++slot)
+    {
+        const Device& device = m_Devices[m_Active[slot]];
+        if (device.Class == Class && (Role == vr::TrackedControllerRole_Invalid || device.Role == Role))
+            return slot;
+    }
+    return InvalidSlot;
+}
+
+void TrackedDeviceRegistry::UpdatePoses(const vr::TrackedDevicePose_t* pPoses, uint32_t NumPoses)
+{
+    for (uint32_t slot = 0; slot < m_Active.size(); ++slot)
+    {
+        const vr::TrackedDeviceIndex_t deviceIdx = m_Active[slot];
+
+        // invalid poses are converted as well, so the batch has no branches
+        const bool valid  = deviceIdx < NumPoses && pPoses[deviceIdx].bPoseIsValid;
+        m_PoseValid[slot] = valid ? 1 : 0;
+        m_Sources[slot]   = deviceIdx < NumPoses ? &pPoses[deviceIdx].mDeviceToAbsoluteTracking : &pPoses[0].mDeviceToAbsoluteTracking;
+    }
+    ConvertPoses(m_Sources.data(), m_Poses.data(), GetNumActiveDevices());
+}
+
+void TrackedDeviceRegistry::ConvertPoses(const vr::HmdMatrix34_t* const* ppSrc, float4x4* pDst, uint32_t Count)
+{
+#if RIPTIDE_SSE
+    // the rows of the 3x4 matrix plus (0, 0, 0, 1), transposed, are the rows of the result before
+    // the flips; flipping z on both sides negates the third column and then the third row
+    const __m128 flipZ   = _mm_setr_ps(1.f, 1.f, -1.f, 1.f);
+    const __m128 flipXYW = _mm_setr_ps(-1.f, -1.f, 1.f, -1.f);
+    const __m128 lastRow = _mm_setr_ps(0.f, 0.f, 0.f, 1.f);
+    for (uint32_t i = 0; i < Count; ++i)
+    {
+        const float* pSrc = &ppSrc[i]->m[0][0];
+
+        __m128 row0 = _mm_loadu_ps(pSrc);
+        __m128 row1 = _mm_loadu_ps(pSrc + 4);
+        __m128 row2 = _mm_loadu_ps(pSrc + 8);
+        __m128 row3 = lastRow;
+        _MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+
+        float* pOut = &pDst[i].m[0][0];
+        _mm_storeu_ps(pOut, _mm_mul_ps(row0, flipZ));
+        _mm_storeu_ps(pOut + 4, _mm_mul_ps(row1, flipZ));
+        _mm_storeu_ps(pOut + 8, _mm_mul_ps(row2, flipXYW));
+        _mm_storeu_ps(pOut + 12, _mm_mul_ps(row3, flipZ));
+    }
+#else
+    for (uint32_t i = 0; i < Count; ++i)
+    {
+        const vr::HmdMatrix34_t& mat = *ppSrc[i];
+        pDst[i]                      = float4x4(
+            mat.m[0][0], mat.m[1][0], -mat.m[2][0], 0.0,
+            mat.m[0][1], mat.m[1][1], -mat.m[2][1], 0.0,
+            -mat.m[0][2], -mat.m[1][2], mat.m[2][2], 0.0,
+            mat.m[0][3], mat.m[1][3], -mat.m[2][3], 1.0f);
+    }
+#endif
+}
+
+void TrackedDeviceRegistry::QueryDevice(vr::TrackedDeviceIndex_t DeviceIdx)
+{
+    Device& device = m_Devices[DeviceIdx];
+    device         = {};
+    device.Class   = m_pRuntime->GetTrackedDeviceClass(DeviceIdx);
+    if (device.Class == vr::TrackedDeviceClass_Invalid)
+        return;
+
+    if (device.Class == vr::TrackedDeviceClass_Controller)
+        device.Role = m_pRuntime->GetControllerRoleForTrackedDeviceIndex(DeviceIdx);
+    device.ModelNumber  = GetStringProperty(DeviceIdx, vr::Prop_ModelNumber_String);
+    device.SerialNumber = GetStringProperty(DeviceIdx, vr::Prop_SerialNumber_String);
+}
+
+void TrackedDeviceRegistry::QueryRoles()
+{
+    for (vr::TrackedDeviceIndex_t deviceIdx = 0; deviceIdx < vr::k_unMaxTrackedDeviceCount; ++deviceIdx)
+    {
+        if (m_Devices[deviceIdx].Class == vr::TrackedDeviceClass_Controller)
+            m_Devices[deviceIdx].Role = m_pRuntime->GetControllerRoleForTrackedDeviceIndex(deviceIdx);
+    }
+}
+
+void TrackedDeviceRegistry::RebuildActiveList()
+{
+    // base stations and display redirects have poses, but nothing is attached to them
+    m_Active.clear();
+    for (vr::TrackedDeviceIndex_t deviceIdx = 0; deviceIdx < vr::k_unMaxTrackedDeviceCount; ++deviceIdx)
+    {
+        const vr::ETrackedDeviceClass deviceClass = m_Devices[deviceIdx].Class;
+        if (deviceClass == vr::TrackedDeviceClass_HMD ||
+            deviceClass == vr::TrackedDeviceClass_Controller ||
+            deviceClass == vr::TrackedDeviceClass_GenericTracker)
+            m_Active.push_back(deviceIdx);
+    }
+
+    m_Sources.resize(m_Active.size());
+    m_Poses.assign(m_Active.size(), float4x4::Identity());
+    m_PoseValid.assign(m_Active.size(), 0);
+    m_ActiveDirty = false;
+}
+
+std::string TrackedDeviceRegistry::GetStringProperty(vr::TrackedDeviceIndex_t DeviceIdx, vr::ETrackedDeviceProperty Prop) const
+{
+    char           buffer[256] = {};
+    const uint32_t length      = m_pRuntime->GetStringTrackedDeviceProperty(DeviceIdx, Prop, buffer, sizeof(buffer));
+    if (length == 0 || length > sizeof(buffer))
+        return {};
+    return std::string(buffer, length - 1);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "BasicMath.hpp"
+#include "VRRuntime.h"
+
+using namespace Diligent;
+
+// Class, role and properties of every tracked device, cached per device index and kept up to date
+// from runtime events, so the frame loop does not query the runtime per device. Active devices
+// (HMD, controllers, trackers) are kept in a packed list whose poses are converted in one batch.
+class TrackedDeviceRegistry
+{
+public:
+    static constexpr uint32_t InvalidSlot = ~0u;
+
+    struct Device
+    {
+        vr::ETrackedDeviceClass    Class = vr::TrackedDeviceClass_Invalid;
+        vr::ETrackedControllerRole Role  = vr::TrackedControllerRole_Invalid;
+        std::string                ModelNumber;
+        std::string                SerialNumber;
+    };
+
+    explicit TrackedDeviceRegistry(IVRRuntime* pRuntime);
+
+    // queries every device index, e.g. at startup or after the event queue overflowed
+    void Rescan();
+
+    // updates the cached devices from one runtime event, the active list is only rebuilt by CommitEvents()
+    void HandleEvent(const vr::VREvent_t& Event);
+
+    // rebuilds the active list if the handled events changed the devices or their roles;
+    // returns true if it did, which invalidates slot numbers
+    bool CommitEvents();
+
+    uint32_t                 GetNumActiveDevices() const { return static_cast<uint32_t>(m_Active.size()); }
+    vr::TrackedDeviceIndex_t GetDeviceIndex(uint32_t Slot) const { return m_Active[Slot]; }
+    const Device&            GetDevice(uint32_t Slot) const { return m_Devices[m_Active[Slot]]; }
+
+    // first active device of the class (and role, unless Invalid), InvalidSlot if there is none
+    uint32_t FindSlot(vr::ETrackedDeviceClass Class, vr::ETrackedControllerRole Role = vr::TrackedControllerRole_Invalid) const;
+
+    // converts the poses of all active devices to the renderer's convention;
+    // pPoses is indexed by device index and must cover every active device
+    void UpdatePoses(const vr::TrackedDevicePose_t* pPoses, uint32_t NumPoses);
+
+    bool            IsPoseValid(uint32_t Slot) const { return m_PoseValid[Slot] != 0; }
+    const float4x4& GetPose(uint32_t Slot) const { return m_Poses[Slot]; }
+
+    // SteamVR's right-handed 3x4 device-to-tracking matrices to left-handed row-vector float4x4,
+    // i.e. the transposed matrix with z flipped on both sides
+    static void ConvertPoses(const vr::HmdMatrix34_t* const* ppSrc, float4x4* pDst, uint32_t Count);
+
+private:
+    void QueryDevice(vr::TrackedDeviceIndex_t DeviceIdx);
+    void QueryRoles();
+    void RebuildActiveList();
+
+    std::string GetStringProperty(vr::TrackedDeviceIndex_t DeviceIdx, vr::ETrackedDeviceProperty Prop) const;
+
+    IVRRuntime* m_pRuntime;
+
+    Device m_Devices[vr::k_unMaxTrackedDeviceCount];
+
+    // packed per active device, in device index order
+    std::vector<vr::TrackedDeviceIndex_t> m_Active;
+    std::vector<const vr::HmdMatrix34_t*> m_Sources;
+    std::vector<float4x4>                 m_Poses;
+    std::vector<uint8_t>                  m_PoseValid;
+
+    bool m_ActiveDirty = false;
+};
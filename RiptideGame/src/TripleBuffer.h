@@ -0,0 +1,45 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Single-producer/single-consumer triple buffer. The writer fills its private buffer and publishes it,
+// the reader picks up the most recently published one; neither side ever blocks or waits for the other.
+// Buffers are recycled, so the writer must overwrite everything it publishes (containers keep their capacity).
+template <typename T>
+class TripleBuffer
+{
+public:
+    // writer side: the buffer to fill before the next Publish()
+    T& GetWriteBuffer() { return m_Buffers[m_WriteIdx]; }
+
+    // writer side: hands the write buffer to the reader and takes back the oldest one
+    void Publish()
+    {
+        const uint32_t previous = m_Shared.exchange(m_WriteIdx | NewDataBit, std::memory_order_acq_rel);
+        m_WriteIdx              = previous & IndexMask;
+    }
+
+    // reader side: the latest published buffer, valid until the next call;
+    // a default-constructed T until the first Publish()
+    const T& AcquireLatest()
+    {
+        if (m_Shared.load(std::memory_order_relaxed) & NewDataBit)
+        {
+            const uint32_t previous = m_Shared.exchange(m_ReadIdx, std::memory_order_acq_rel);
+            m_ReadIdx               = previous & IndexMask;
+        }
+        return m_Buffers[m_ReadIdx];
+    }
+
+private:
+    static constexpr uint32_t IndexMask  = 0x3;
+    static constexpr uint32_t NewDataBit = 0x4;
+
+    T m_Buffers[3];
+
+    // the buffer in the middle, owned by neither side; separate cache lines keep the sides from false sharing
+    alignas(64) std::atomic<uint32_t> m_Shared{1};
+    alignas(64) uint32_t m_WriteIdx = 0;
+    alignas(64) uint32_t m_ReadIdx  = 2;
+};
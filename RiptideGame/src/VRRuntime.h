@@ -0,0 +1,45 @@
+#pragma once
+
+#include "openvr.h"
+
+// The subset of the OpenVR system/compositor API used by the renderer.
+// OpenVRRuntime forwards to SteamVR, SimulatedVRRuntime runs without a headset.
+class IVRRuntime
+{
+public:
+    virtual ~IVRRuntime() = default;
+
+    virtual void GetRecommendedRenderTargetSize(uint32_t* pWidth, uint32_t* pHeight) = 0;
+
+    virtual vr::HmdMatrix44_t GetProjectionMatrix(vr::EVREye eye, float nearZ, float farZ) = 0;
+
+    virtual vr::HmdMatrix34_t GetEyeToHeadTransform(vr::EVREye eye) = 0;
+
+    virtual vr::ETrackedDeviceClass GetTrackedDeviceClass(vr::TrackedDeviceIndex_t deviceIdx) = 0;
+
+    virtual vr::ETrackedControllerRole GetControllerRoleForTrackedDeviceIndex(vr::TrackedDeviceIndex_t deviceIdx) = 0;
+
+    // returns the length including the terminating zero, 0 if the device does not have the property
+    virtual uint32_t GetStringTrackedDeviceProperty(vr::TrackedDeviceIndex_t deviceIdx, vr::ETrackedDeviceProperty prop, char* pValue, uint32_t bufferSize) = 0;
+
+    // returns false once there are no more pending events
+    virtual bool PollNextEvent(vr::VREvent_t* pEvent) = 0;
+
+    // blocks until the compositor is ready for the next frame
+    virtual vr::EVRCompositorError WaitGetPoses(vr::TrackedDevicePose_t* pRenderPoses, uint32_t numPoses) = 0;
+
+    // seconds between two vsyncs of the display
+    virtual float GetFrameDuration() = 0;
+
+    // seconds from now until the frame that WaitGetPoses() started is lit on the display
+    virtual float GetPredictedSecondsToPhotons() = 0;
+
+    // poses predicted for the given time in the compositor's tracking space, may be called any time after WaitGetPoses()
+    virtual void GetDeviceToAbsoluteTrackingPose(float predictedSecondsToPhotons, vr::TrackedDevicePose_t* pPoses, uint32_t numPoses) = 0;
+
+    // compositor timing of the frame framesAgo frames before the one WaitGetPoses() started, which
+    // is still in progress; false if the runtime does not keep that frame
+    virtual bool GetFrameTiming(vr::Compositor_FrameTiming* pTiming, uint32_t framesAgo) = 0;
+
+    virtual vr::EVRCompositorError Submit(vr::EVREye eye, const vr::Texture_t* pTexture, const vr::VRTextureBounds_t* pBounds = nullptr) = 0;
+};